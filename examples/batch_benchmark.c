@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/predictions.h"
+#include "../include/thread.h"
+
+// Count of replayed inputs
+#define BATCH_INPUTS 200000
+
+// Max count of batch threads
+#define BATCH_THREADS 16
+
+static double now() {
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+static void results_free(Predictions** results, unsigned count) {
+    for (unsigned i = 0; i < count; i++) {
+        predictions_free(results[i]);
+    }
+}
+
+int main(int argc, char** argv) {
+    // Parsing the configuration file
+    Tree* rules = tree_create(argc > 1 ? argv[1] : "../../../../example.config");
+
+    // Recorded inputs are typed commands by keystrokes
+    const char* commands[] = {
+        "git add --all", "git commit -m \"message\"", "git checkout -b feature", "git reset --hard",
+        "git comit -a", "git dif -staged", "git log --follow file", "git remote add origin url",
+    };
+    unsigned command_count = sizeof(commands) / sizeof(commands[0]);
+
+    char** inputs = (char**)malloc(sizeof(char*) * BATCH_INPUTS);
+    char* memory = (char*)malloc((size_t)BATCH_INPUTS * 32);
+    Predictions** results = (Predictions**)malloc(sizeof(Predictions*) * BATCH_INPUTS);
+    if (inputs == NULL || memory == NULL || results == NULL) {
+        fprintf(stderr, "[ERROR] Bad inputs memory allocation\n");
+        exit(1);
+    }
+
+    unsigned command = 0, length = 1;
+    for (unsigned i = 0; i < BATCH_INPUTS; i++) {
+        if (length > strlen(commands[command])) {
+            command = (command + 1) % command_count;
+            length = 1;
+        }
+
+        inputs[i] = memory + (size_t)i * 32;
+        memcpy(inputs[i], commands[command], length);
+        inputs[i][length] = '\0';
+        length += 1;
+    }
+
+    // Serial replay by one call for each input
+    double start = now();
+    for (unsigned i = 0; i < BATCH_INPUTS; i++) {
+        results[i] = predictions_create(rules, inputs[i], "[{<");
+    }
+    double seconds = now() - start;
+    results_free(results, BATCH_INPUTS);
+    printf("    serial: %10.0f queries/s\n", BATCH_INPUTS / seconds);
+
+    // Queries per thread stay the same if
+    // threads don't slow down each other
+    for (unsigned threads = 1; threads <= BATCH_THREADS; threads *= 2) {
+        start = now();
+        predictions_create_batch(rules, inputs, BATCH_INPUTS, "[{<", results, threads);
+        seconds = now() - start;
+        results_free(results, BATCH_INPUTS);
+
+        printf("%2u threads: %10.0f queries/s, %10.0f per thread\n", threads, BATCH_INPUTS / seconds,
+               BATCH_INPUTS / seconds / threads);
+    }
+
+    // Free inputs, results and rules
+    free(inputs);
+    free(memory);
+    free(results);
+    tree_free(rules);
+
+    return 0;
+}
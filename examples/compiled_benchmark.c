@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/predictions.h"
+#include "../include/thread.h"
+
+// Default count of lines of generated config
+#define STARTUP_LINES 1000000
+
+// Count of startups, the fastest one is printed
+#define STARTUP_RUNS 10
+
+static double now() {
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * Write config of commands with subcommands
+ * and options, each command takes 100 lines
+ *
+ * @param path - Path of generated config
+ * @param lines - Count of lines
+ */
+static void config_generate(const char* path, unsigned lines) {
+    FILE* config = fopen(path, "wb");
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Can't create file %s\n", path);
+        exit(1);
+    }
+
+    for (unsigned i = 0; i < lines; i++) {
+        if (i % 100 == 0) {
+            fprintf(config, "command%u\n", i / 100);
+        }
+        else if (i % 10 == 1) {
+            fprintf(config, "    subcommand%u\n", i % 100 / 10);
+        }
+        else {
+            fprintf(config, "        --option%u\n", i);
+        }
+    }
+
+    fclose(config);
+}
+
+static Tree* startup_text(const char* path) {
+    return tree_create(path);
+}
+
+static Tree* startup_binary(const char* path) {
+    return tree_load_binary(path);
+}
+
+/**
+ * Print time of the fastest startup, which
+ * loads rules and finds the first predictions
+ * like short-lived process does
+ *
+ * @param name - Name of loader
+ * @param load - Loader of rules
+ * @param path - Path to rules
+ */
+static void startup_measure(const char* name, Tree* (*load)(const char*), const char* path) {
+    PredictionView items[16];
+    PredictionList list;
+
+    double best = 0;
+    for (unsigned i = 0; i < STARTUP_RUNS; i++) {
+        double start = now();
+        Tree* tree = load(path);
+        prediction_list_init(&list, items, 16);
+        predictions_find(tree, "command1 subcommand1 --opt", "[{<", &list);
+        double seconds = now() - start;
+
+        tree_free(tree);
+        if (i == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+
+    printf("%-24s %10.3f ms\n", name, best * 1e3);
+}
+
+int main(int argc, char** argv) {
+    unsigned lines = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : STARTUP_LINES;
+    const char* text_path = "compiled_benchmark.config";
+    const char* bin_path = "compiled_benchmark.bin";
+
+    config_generate(text_path, lines);
+    if (tree_compile(text_path, bin_path) != 0) {
+        exit(1);
+    }
+    printf("config of %u lines\n", lines);
+
+    // Files stay in page cache, so startups
+    // are compared without disk reading
+    startup_measure("text config", startup_text, text_path);
+    startup_measure("compiled rules", startup_binary, bin_path);
+
+    remove(text_path);
+    remove(bin_path);
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/predictions.h"
+#include "../include/thread.h"
+
+// Count of searches by each thread
+#define SEARCH_COUNT 1000000
+
+// Max count of searching threads
+#define MAX_THREADS 16
+
+/**
+ * State of searching thread, workers
+ * don't share cache lines with each other
+ */
+struct worker {
+    Tree* rules;
+    const char** inputs;
+    unsigned count;
+    unsigned long found;
+    char padding[PREDICTIONS_CACHE_LINE];
+};
+typedef struct worker Worker;
+
+static double now() {
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+static void worker_search(void* arg) {
+    Worker* worker = (Worker*)arg;
+
+    // Each thread has its own memory
+    // of predictions and shares the tree
+    PredictionScratch* scratch = prediction_scratch_create(16);
+    if (scratch == NULL) {
+        fprintf(stderr, "[ERROR] Bad scratch memory allocation\n");
+        exit(1);
+    }
+
+    unsigned long found = 0;
+    for (unsigned i = 0; i < SEARCH_COUNT; i++) {
+        predictions_search(worker->rules, worker->inputs[i % worker->count], "[{<", scratch);
+        found += scratch->list.total;
+    }
+    worker->found = found;
+
+    prediction_scratch_free(scratch);
+}
+
+int main(int argc, char** argv) {
+    // Parsing the configuration file
+    Tree* rules = tree_create(argc > 1 ? argv[1] : "../../../../example.config");
+
+    // Classify tokens before searching,
+    // then threads only read the tree
+    tree_set_brackets(rules, "[{<");
+
+    // Inputs are typed commands by keystrokes
+    const char* commands[] = {
+        "git add --all", "git commit -m \"message\"", "git checkout -b feature", "git reset --hard",
+        "git comit -a", "git dif -staged", "git log --follow file", "git remote add origin url",
+    };
+    unsigned command_count = sizeof(commands) / sizeof(commands[0]);
+
+    unsigned input_count = 0;
+    for (unsigned i = 0; i < command_count; i++) {
+        input_count += (unsigned)strlen(commands[i]);
+    }
+
+    const char** inputs = (const char**)malloc(sizeof(char*) * input_count);
+    char* memory = (char*)malloc(input_count * 32);
+    if (inputs == NULL || memory == NULL) {
+        fprintf(stderr, "[ERROR] Bad inputs memory allocation\n");
+        exit(1);
+    }
+
+    unsigned input = 0;
+    for (unsigned i = 0; i < command_count; i++) {
+        for (unsigned length = 1; length <= strlen(commands[i]); length++) {
+            char* text = memory + input * 32;
+            memcpy(text, commands[i], length);
+            text[length] = '\0';
+            inputs[input++] = text;
+        }
+    }
+
+    Worker workers[MAX_THREADS];
+    Thread handles[MAX_THREADS];
+
+    // Searches per thread stay the same if
+    // threads don't slow down each other
+    for (unsigned threads = 1; threads <= MAX_THREADS; threads *= 2) {
+        double start = now();
+
+        for (unsigned i = 0; i < threads; i++) {
+            workers[i].rules = rules;
+            workers[i].inputs = inputs;
+            workers[i].count = input_count;
+            workers[i].found = 0;
+
+            if (thread_create(&handles[i], worker_search, &workers[i]) != 0) {
+                fprintf(stderr, "[ERROR] Can't start searching thread\n");
+                exit(1);
+            }
+        }
+        for (unsigned i = 0; i < threads; i++) {
+            thread_join(handles[i]);
+        }
+
+        double seconds = now() - start;
+        printf("%2u threads: %10.0f searches/s, %10.0f per thread\n", threads,
+               threads * SEARCH_COUNT / seconds, SEARCH_COUNT / seconds);
+    }
+
+    // Free inputs and rules
+    free(inputs);
+    free(memory);
+    tree_free(rules);
+
+    return 0;
+}
@@ -60,6 +60,9 @@ int main() {
             break;
         }
 
+        // Rank used tokens higher next time
+        tree_learn(rules, str);
+
         // Free user input string
         free(str);
 
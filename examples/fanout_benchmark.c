@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/query.h"
+#include "../include/thread.h"
+
+// Max count of children of one node
+#define FANOUT_MAX 1000000
+
+// Count of lookups for each fanout
+#define FANOUT_LOOKUPS 100000
+
+// Count of linear scans, they are slow for large nodes
+#define FANOUT_SCANS 100
+
+static double now() {
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * Create rules with one command
+ * which has fanout children
+ *
+ * @param fanout - Count of children
+ *
+ * @return Rules in the form of a tree
+ */
+static Tree* fanout_tree(unsigned fanout) {
+    char* config = (char*)malloc((size_t)fanout * 20 + 16);
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Bad config memory allocation\n");
+        exit(1);
+    }
+
+    // Children are written in shuffled
+    // order, so load has to sort them
+    size_t length = (size_t)sprintf(config, "command\n");
+    for (unsigned i = 0; i < fanout; i++) {
+        unsigned index = (unsigned)(((unsigned long long)i * 2654435761u) % fanout);
+        length += (size_t)sprintf(config + length, "    token%07u\n", index);
+    }
+
+    Tree* tree = tree_create_from_buffer(config, length);
+    free(config);
+
+    return tree;
+}
+
+int main() {
+    // Tokens are prepared before measuring
+    char (*tokens)[16] = (char (*)[16])malloc(sizeof(*tokens) * FANOUT_LOOKUPS);
+    if (tokens == NULL) {
+        fprintf(stderr, "[ERROR] Bad tokens memory allocation\n");
+        exit(1);
+    }
+
+    printf("%8s %14s %14s %14s\n", "fanout", "exact, ns", "prefix, ns", "linear, ns");
+
+    for (unsigned fanout = 10; fanout <= FANOUT_MAX; fanout *= 10) {
+        Tree* tree = fanout_tree(fanout);
+
+        Query head;
+        query_init(&head, tree);
+        query_descend(&head, "command", 7);
+
+        for (unsigned i = 0; i < FANOUT_LOOKUPS; i++) {
+            sprintf(tokens[i], "token%07u", i * 7919u % fanout);
+        }
+        unsigned length = 12;
+        unsigned long found = 0;
+
+        // Exact tokens are found by binary search or radix index
+        double start = now();
+        for (unsigned i = 0; i < FANOUT_LOOKUPS; i++) {
+            Query query = head;
+            found += query_descend(&query, tokens[i], length);
+        }
+        double exact = (now() - start) / FANOUT_LOOKUPS;
+
+        // Tokens with prefix are one range of sorted children
+        start = now();
+        for (unsigned i = 0; i < FANOUT_LOOKUPS; i++) {
+            Query query = head;
+            found += query_complete(&query, tokens[i], length - 2);
+        }
+        double prefix = (now() - start) / FANOUT_LOOKUPS;
+
+        // Comparing with each child like descent before sorting
+        start = now();
+        for (unsigned i = 0; i < FANOUT_SCANS; i++) {
+            Query query = head;
+            unsigned count = query_complete(&query, "", 0);
+            for (unsigned j = 0; j < count; j++) {
+                unsigned child_length;
+                const char* child = query_token(&query, j, &child_length);
+                if (child_length == length && strcmp(child, tokens[i]) == 0) {
+                    found += 1;
+                    break;
+                }
+            }
+        }
+        double linear = (now() - start) / FANOUT_SCANS;
+
+        printf("%8u %14.1f %14.1f %14.1f\n", fanout, exact * 1e9, prefix * 1e9, linear * 1e9);
+        if (found == 0) {
+            fprintf(stderr, "[ERROR] Tokens weren't found\n");
+        }
+
+        tree_free(tree);
+    }
+
+    free(tokens);
+
+    return 0;
+}
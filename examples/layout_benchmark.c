@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/query.h"
+#include "../include/thread.h"
+
+// Count of commands, subcommands and options,
+// tokens are different, so subtrees aren't shared
+#define LAYOUT_COMMANDS 2000
+#define LAYOUT_SUBCOMMANDS 20
+#define LAYOUT_OPTIONS 20
+
+// Count of walked paths
+#define LAYOUT_QUERIES 1000000
+
+static double now() {
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * Path of three tokens from head to leaf
+ */
+struct layout_path {
+    char tokens[3][24];
+    unsigned lengths[3];
+};
+typedef struct layout_path LayoutPath;
+
+static Tree* layout_tree() {
+    size_t capacity = (size_t)LAYOUT_COMMANDS * LAYOUT_SUBCOMMANDS * (LAYOUT_OPTIONS + 1) * 32;
+    char* config = (char*)malloc(capacity);
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Bad config memory allocation\n");
+        exit(1);
+    }
+
+    size_t length = 0;
+    unsigned id = 0;
+    for (unsigned i = 0; i < LAYOUT_COMMANDS; i++) {
+        length += (size_t)sprintf(config + length, "command%u\n", i);
+        for (unsigned j = 0; j < LAYOUT_SUBCOMMANDS; j++) {
+            length += (size_t)sprintf(config + length, "    sub%u\n", id++);
+            for (unsigned k = 0; k < LAYOUT_OPTIONS; k++) {
+                length += (size_t)sprintf(config + length, "        --option%u\n", id++);
+            }
+        }
+    }
+
+    Tree* tree = tree_create_from_buffer(config, length);
+    free(config);
+
+    return tree;
+}
+
+/**
+ * Find child of pointer node by comparing
+ * with each child like descent before image
+ */
+static Node* layout_pointer_child(Node* node, const char* token, unsigned length) {
+    Node** children = node_list_data(&node->children);
+    for (unsigned i = 0; i < node->children.length; i++) {
+        if (children[i]->token_length == length && strcmp(children[i]->token, token) == 0) {
+            return children[i];
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    // Single layout may be chosen for counting
+    // cache misses by perf stat -e cache-misses
+    const char* mode = argc > 1 ? argv[1] : "all";
+
+    Tree* tree = layout_tree();
+
+    // Random paths are chosen by walking pointer tree
+    LayoutPath* paths = (LayoutPath*)malloc(sizeof(LayoutPath) * LAYOUT_QUERIES);
+    if (paths == NULL) {
+        fprintf(stderr, "[ERROR] Bad paths memory allocation\n");
+        exit(1);
+    }
+
+    unsigned seed = 7;
+    for (unsigned i = 0; i < LAYOUT_QUERIES; i++) {
+        Node* node = tree->head;
+        for (unsigned j = 0; j < 3; j++) {
+            seed = seed * 1103515245u + 12345u;
+            node = node_list_data(&node->children)[(seed >> 8) % node->children.length];
+            strcpy(paths[i].tokens[j], node->token);
+            paths[i].lengths[j] = node->token_length;
+        }
+    }
+
+    unsigned long found = 0;
+
+    if (strcmp(mode, "all") == 0 || strcmp(mode, "pointer") == 0) {
+        double start = now();
+        for (unsigned i = 0; i < LAYOUT_QUERIES; i++) {
+            Node* node = tree->head;
+            for (unsigned j = 0; j < 3 && node != NULL; j++) {
+                node = layout_pointer_child(node, paths[i].tokens[j], paths[i].lengths[j]);
+            }
+            found += node != NULL;
+        }
+        printf("%-36s %8.1f ns per query\n", "pointer nodes, linear", (now() - start) / LAYOUT_QUERIES * 1e9);
+    }
+
+    if (strcmp(mode, "all") == 0 || strcmp(mode, "image") == 0) {
+        double start = now();
+        for (unsigned i = 0; i < LAYOUT_QUERIES; i++) {
+            Query query;
+            query_init(&query, tree);
+            int ok = 1;
+            for (unsigned j = 0; j < 3 && ok; j++) {
+                ok = query_descend(&query, paths[i].tokens[j], paths[i].lengths[j]);
+            }
+            found += ok;
+        }
+        printf("%-36s %8.1f ns per query\n", "flat image, query_descend", (now() - start) / LAYOUT_QUERIES * 1e9);
+    }
+
+    if (found == 0) {
+        fprintf(stderr, "[ERROR] Paths weren't found\n");
+    }
+
+    // Free paths and rules
+    free(paths);
+    tree_free(tree);
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/tree.h"
+#include "../include/thread.h"
+
+// Default count of lines of generated config
+#define LOAD_LINES 1000000
+
+// Count of loads, the fastest one is printed
+#define LOAD_RUNS 5
+
+// Count of read characters, so reading isn't optimized out
+static volatile unsigned long load_sink;
+
+static double now() {
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * Write config of commands with subcommands
+ * and options, each command takes 100 lines
+ *
+ * @param path - Path of generated config
+ * @param lines - Count of lines
+ */
+static void config_generate(const char* path, unsigned lines) {
+    FILE* config = fopen(path, "wb");
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Can't create file %s\n", path);
+        exit(1);
+    }
+
+    for (unsigned i = 0; i < lines; i++) {
+        if (i % 100 == 0) {
+            fprintf(config, "command%u\n", i / 100);
+        }
+        else if (i % 10 == 1) {
+            fprintf(config, "    subcommand%u\n", i % 100 / 10);
+        }
+        else {
+            fprintf(config, "        --option%u\n", i);
+        }
+    }
+
+    fclose(config);
+}
+
+/**
+ * Read file twice by characters like the old two pass
+ * loader, it only measures reading of the old loader
+ */
+static Tree* load_two_passes(const char* path) {
+    FILE* config = fopen(path, "rb");
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", path);
+        exit(1);
+    }
+
+    unsigned long count = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        fseek(config, 0, SEEK_SET);
+        while (fgetc(config) != EOF) {
+            count += 1;
+        }
+    }
+    fclose(config);
+    load_sink = count;
+
+    return NULL;
+}
+
+static Tree* load_blocks(const char* path) {
+    return tree_create(path);
+}
+
+static Tree* load_stream(const char* path) {
+    FILE* config = fopen(path, "rb");
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", path);
+        exit(1);
+    }
+
+    // Stream is read as if it was a pipe
+    Tree* tree = tree_create_from_stream(config);
+    fclose(config);
+
+    return tree;
+}
+
+/**
+ * Print lines per second of the fastest load
+ *
+ * @param name - Name of loader
+ * @param load - Loader of config
+ * @param path - Path to config
+ * @param lines - Count of lines of config
+ */
+static void load_measure(const char* name, Tree* (*load)(const char*), const char* path, unsigned lines) {
+    double best = 0;
+    for (unsigned i = 0; i < LOAD_RUNS; i++) {
+        double start = now();
+        Tree* tree = load(path);
+        double seconds = now() - start;
+
+        if (tree != NULL) {
+            tree_free(tree);
+        }
+        if (i == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+
+    printf("%-34s %8.3f s %12.0f lines/s\n", name, best, lines / best);
+}
+
+/**
+ * Print time of compiling image of loaded tree,
+ * loaders compile it, so it is included in them
+ *
+ * @param path - Path to config
+ */
+static void load_measure_compile(const char* path) {
+    Tree* tree = tree_create(path);
+
+    double best = 0;
+    for (unsigned i = 0; i < LOAD_RUNS; i++) {
+        double start = now();
+        Image* image = image_create(tree->head);
+        double seconds = now() - start;
+
+        image_free(image);
+        if (i == 0 || seconds < best) {
+            best = seconds;
+        }
+    }
+    tree_free(tree);
+
+    printf("%-34s %8.3f s\n", "image compile (included above)", best);
+}
+
+int main(int argc, char** argv) {
+    unsigned lines = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : LOAD_LINES;
+    const char* path = argc > 2 ? argv[2] : "load_benchmark.config";
+
+    config_generate(path, lines);
+    printf("config of %u lines\n", lines);
+
+    // File stays in page cache, so loaders
+    // are compared without disk reading
+    load_measure("two fgetc passes (old reading)", load_two_passes, path, lines);
+    load_measure("tree_create by blocks", load_blocks, path, lines);
+    load_measure("tree_create_from_stream", load_stream, path, lines);
+    load_measure_compile(path);
+
+    remove(path);
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/tree.h"
+#include "../include/thread.h"
+
+// Default count of lines of generated config
+#define PARALLEL_LINES 1000000
+
+// Default max count of parsing threads
+#define PARALLEL_THREADS 32
+
+static double now() {
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * Write config of independent commands with
+ * subcommands and options, each command takes
+ * 100 lines and can be parsed by other thread
+ *
+ * @param path - Path of generated config
+ * @param lines - Count of lines
+ */
+static void config_generate(const char* path, unsigned lines) {
+    FILE* config = fopen(path, "wb");
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Can't create file %s\n", path);
+        exit(1);
+    }
+
+    for (unsigned i = 0; i < lines; i++) {
+        if (i % 100 == 0) {
+            fprintf(config, "command%u\n", i / 100);
+        }
+        else if (i % 10 == 1) {
+            fprintf(config, "    subcommand%u\n", i % 100 / 10);
+        }
+        else {
+            fprintf(config, "        --option%u\n", i);
+        }
+    }
+
+    fclose(config);
+}
+
+int main(int argc, char** argv) {
+    unsigned lines = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : PARALLEL_LINES;
+    unsigned max_threads = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 10) : PARALLEL_THREADS;
+    const char* path = "parallel_benchmark.config";
+
+    config_generate(path, lines);
+    printf("config of %u lines\n", lines);
+
+    // Parsing time includes compiling of image,
+    // which is done by one thread after stitching
+    double serial = 0;
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        double start = now();
+        Tree* tree = tree_create_parallel(path, threads);
+        double seconds = now() - start;
+        tree_free(tree);
+
+        if (threads == 1) {
+            serial = seconds;
+        }
+        printf("%2u threads: %8.3f s %12.0f lines/s, speedup %5.2f\n", threads, seconds, lines / seconds,
+               serial / seconds);
+    }
+
+    remove(path);
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/query.h"
+#include "../include/thread.h"
+
+// Count of scans of all children, the fastest one is printed
+#define PREFIX_RUNS 20
+
+static double now() {
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+#endif
+}
+
+static unsigned bit_count(uint32_t mask) {
+    unsigned count = 0;
+    while (mask != 0) {
+        mask &= mask - 1;
+        count += 1;
+    }
+
+    return count;
+}
+
+/**
+ * Create rules with one command which has
+ * children of random tokens, the first bytes
+ * are from small alphabet, so prefixes match
+ *
+ * @param fanout - Count of children
+ *
+ * @return Rules in the form of a tree
+ */
+static Tree* prefix_tree(unsigned fanout) {
+    char* config = (char*)malloc((size_t)fanout * 24 + 16);
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Bad config memory allocation\n");
+        exit(1);
+    }
+
+    srand(3);
+    size_t length = (size_t)sprintf(config, "command\n");
+    for (unsigned i = 0; i < fanout; i++) {
+        length += (size_t)sprintf(config + length, "    ");
+
+        unsigned token_length = 3 + (unsigned)rand() % 14;
+        for (unsigned j = 0; j < token_length; j++) {
+            config[length++] = (char)('a' + rand() % (j < 2 ? 3 : 26));
+        }
+        config[length++] = '\n';
+    }
+
+    Tree* tree = tree_create_from_buffer(config, length);
+    free(config);
+
+    return tree;
+}
+
+int main() {
+    const char* prefixes[] = {"a", "ab", "abc"};
+    unsigned fanouts[] = {10000, 100000};
+
+    for (unsigned f = 0; f < sizeof(fanouts) / sizeof(fanouts[0]); f++) {
+        Tree* tree = prefix_tree(fanouts[f]);
+
+        Query query;
+        query_init(&query, tree);
+        query_descend(&query, "command", 7);
+        unsigned count = query_complete(&query, "", 0);
+        const Image* image = query.image;
+
+        printf("%u children\n", count);
+        for (unsigned p = 0; p < sizeof(prefixes) / sizeof(prefixes[0]); p++) {
+            const char* prefix = prefixes[p];
+            unsigned length = (unsigned)strlen(prefix);
+
+            // Comparing tokens by bytes from tokens blob
+            double bytes = 0;
+            unsigned long bytes_found = 0;
+            for (unsigned r = 0; r < PREFIX_RUNS; r++) {
+                bytes_found = 0;
+                double start = now();
+                for (unsigned i = 0; i < count; i++) {
+                    unsigned token_length;
+                    const char* token = query_token(&query, i, &token_length);
+
+                    unsigned j = 0;
+                    while (j < length && j < token_length && token[j] == prefix[j]) {
+                        j += 1;
+                    }
+                    bytes_found += j == length;
+                }
+                double seconds = now() - start;
+                if (r == 0 || seconds < bytes) {
+                    bytes = seconds;
+                }
+            }
+
+            // Comparing inline bytes of many node records at once
+            double masks = 0;
+            unsigned long masks_found = 0;
+            for (unsigned r = 0; r < PREFIX_RUNS; r++) {
+                masks_found = 0;
+                double start = now();
+                for (unsigned i = 0; i < count; i += IMAGE_MASK_SIZE) {
+                    masks_found += bit_count(image_prefix_mask(image, query.first + i, count - i, prefix, length));
+                }
+                double seconds = now() - start;
+                if (r == 0 || seconds < masks) {
+                    masks = seconds;
+                }
+            }
+
+            printf("  prefix %-4s bytes %8.1f us, mask %8.1f us, %5.1f GB/s of records (%lu %lu)\n", prefix,
+                   bytes * 1e6, masks * 1e6, count * sizeof(ImageNode) / masks / 1e9, bytes_found, masks_found);
+        }
+
+        tree_free(tree);
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef AUTOCOMPLETE_ARENA_H
+#define AUTOCOMPLETE_ARENA_H
+
+#include <stddef.h>
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+// Alignment of arena allocations for any data
+#define ARENA_ALIGNMENT 16
+
+/**
+ * Arena allocator which places data in a
+ * list of large blocks, each new block is
+ * twice as large as the previous one
+ *
+ * Memory is never freed separately, all
+ * blocks are freed together with arena
+ */
+struct arena {
+    char* block;     // Current block, starts with pointer to previous
+    size_t used;
+    size_t size;
+};
+typedef struct arena Arena;
+
+/**
+ * Function for allocating empty arena
+ *
+ * @return Arena structure
+ */
+LIB Arena* arena_create();
+
+/**
+ * Allocate memory from arena
+ *
+ * @param arena - Arena for allocating
+ * @param size - Size of memory in bytes
+ * @param alignment - Power of two alignment, not more than ARENA_ALIGNMENT
+ *
+ * @return Pointer to uninitialized memory
+ */
+LIB void* arena_alloc(Arena* arena, size_t size, size_t alignment);
+
+/**
+ * Move all blocks of other arena to arena,
+ * other arena is deallocated
+ *
+ * @param arena - Arena for receiving blocks
+ * @param other - Arena for moving
+ */
+LIB void arena_merge(Arena* arena, Arena* other);
+
+/**
+ * Function for deallocating arena
+ * and all allocated memory
+ *
+ * @param arena - Arena for deallocating
+ */
+LIB void arena_free(Arena* arena);
+
+#endif //AUTOCOMPLETE_ARENA_H
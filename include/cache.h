@@ -0,0 +1,112 @@
+#ifndef AUTOCOMPLETE_CACHE_H
+#define AUTOCOMPLETE_CACHE_H
+
+#include "image.h"
+#include "predictions.h"
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+// Count of remembered prediction lists
+#define CACHE_SIZE 8
+
+/**
+ * Key of predictions, they depend on node of
+ * the last complete token and path to it, the
+ * last token and max edit distance, revision and
+ * learned count of tree change when nodes or
+ * ranks change
+ */
+struct cache_key {
+    const ImageNode* node;
+    uint64_t path;
+    unsigned long revision;
+    unsigned long learned;
+    unsigned distance;
+    const char* prefix;    // The last token, may be not null terminated
+    unsigned length;
+};
+typedef struct cache_key CacheKey;
+
+/**
+ * Remembered predictions of one key,
+ * tokens are borrowed from the tree
+ */
+struct cache_entry {
+    const ImageNode* node;
+    uint64_t path;
+    unsigned long revision;
+    unsigned long learned;
+    unsigned distance;
+    char prefix[TOKEN_TEXT_SIZE];
+    unsigned length;
+    PredictType type;
+    PredictionView* items;  // The best predictions in order of list
+    unsigned count;         // Count of remembered predictions
+    unsigned capacity;
+    unsigned total;         // Count of found predictions
+    int ranked;
+    unsigned long used;     // Time of the last use, zero if entry is empty
+};
+typedef struct cache_entry CacheEntry;
+
+/**
+ * Cache of the last used prediction lists,
+ * the least recently used list is replaced
+ */
+struct cache {
+    CacheEntry entries[CACHE_SIZE];
+    unsigned long clock;    // Counter of uses
+};
+typedef struct cache Cache;
+
+/**
+ * Function for initializing empty cache
+ *
+ * @param cache - Cache for initializing
+ */
+LIB void cache_init(Cache* cache);
+
+/**
+ * Function for writing remembered predictions
+ * to list, list with more capacity than count
+ * of remembered predictions is written only if
+ * all found predictions were remembered
+ *
+ * @param cache - Cache of predictions
+ * @param key - Key of predictions
+ * @param list - List for writing predictions
+ *
+ * @return True if predictions were written or False
+ */
+LIB int cache_find(Cache* cache, const CacheKey* key, PredictionList* list);
+
+/**
+ * Function for remembering predictions of
+ * filled list instead of the least recently
+ * used predictions
+ *
+ * @param cache - Cache of predictions
+ * @param key - Key of predictions
+ * @param list - Filled list of predictions
+ */
+LIB void cache_store(Cache* cache, const CacheKey* key, const PredictionList* list);
+
+/**
+ * Function for deallocating
+ * memory of cache entries
+ *
+ * @param cache - Cache for deallocating
+ */
+LIB void cache_free(Cache* cache);
+
+#endif //AUTOCOMPLETE_CACHE_H
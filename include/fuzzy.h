@@ -0,0 +1,89 @@
+#ifndef AUTOCOMPLETE_FUZZY_H
+#define AUTOCOMPLETE_FUZZY_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+#include <stdint.h>
+
+// Only the first bytes of longer patterns are
+// compared, pattern fits one machine word
+#define FUZZY_MAX_LENGTH 64
+
+// Greater distances are reduced to this
+#define FUZZY_MAX_DISTANCE 8
+
+/**
+ * Columns of edit distance matrix by
+ * bit vectors of vertical differences
+ */
+struct fuzzy_state {
+    uint64_t vp;       // Positive vertical differences
+    uint64_t vn;       // Negative vertical differences
+    uint64_t d0;       // Zero diagonal differences
+    uint64_t pm;       // Matches of pattern with previous character
+    unsigned score;    // Distance of pattern and text
+    unsigned best;     // The least distance of pattern and text prefixes
+    unsigned band;     // Cell at the top of band of cells near diagonal
+    int alive;         // False if longer text prefixes never match
+};
+typedef struct fuzzy_state FuzzyState;
+
+/**
+ * Bounded Damerau-Levenshtein matcher of pattern
+ * with prefixes of texts by Myers' bit-parallel
+ * algorithm with transpositions by Hyyro
+ *
+ * Columns of the last text are kept, so
+ * sorted texts sharing prefixes are matched
+ * from the end of common prefix
+ */
+struct fuzzy {
+    uint64_t peq[256];     // Bit masks of pattern positions by characters
+    unsigned length;       // Length of pattern
+    unsigned distance;     // Max edit distance
+    const char* text;      // The last matched text
+    unsigned depth;        // Count of computed columns of the last text
+    unsigned dead;         // Length of prefix of the last text which
+                           // no text can extend to match, or zero
+    FuzzyState states[FUZZY_MAX_LENGTH + FUZZY_MAX_DISTANCE + 1];
+};
+typedef struct fuzzy Fuzzy;
+
+/**
+ * Function for initializing matcher by pattern
+ *
+ * @param fuzzy - Matcher for initializing
+ * @param pattern - Pattern, may be not null terminated
+ * @param length - Length of pattern
+ * @param distance - Max count of insertions, deletions,
+ *                   substitutions and transpositions
+ */
+LIB void fuzzy_init(Fuzzy* fuzzy, const char* pattern, unsigned length, unsigned distance);
+
+/**
+ * Function for matching pattern with text, it takes
+ * time of text length after prefix which is common
+ * with the previous text, but not more than length
+ * of pattern plus distance, text must outlive the
+ * next call
+ *
+ * @param fuzzy - Matcher of pattern
+ * @param text - Text, may be not null terminated
+ * @param length - Length of text
+ *
+ * @return True if some prefix of text is not more than distance away from pattern,
+ *         otherwise dead field of matcher is set
+ */
+LIB int fuzzy_match(Fuzzy* fuzzy, const char* text, unsigned length);
+
+#endif //AUTOCOMPLETE_FUZZY_H
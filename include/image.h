@@ -0,0 +1,238 @@
+#ifndef AUTOCOMPLETE_IMAGE_H
+#define AUTOCOMPLETE_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "node.h"
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+#define IMAGE_MAGIC "CLAC"
+#define IMAGE_VERSION 7
+#define IMAGE_BYTE_ORDER 0x01020304u
+
+// Children of nodes with at most this count of
+// children are narrowed by comparing all keys at
+// once, children of others by their radix index
+#define IMAGE_SMALL_NODE 16
+
+// Tokens not longer than this are compared
+// by node record without reading tokens blob
+#define IMAGE_INLINE_SIZE 16
+
+// Count of nodes compared by image_prefix_mask at once
+#define IMAGE_MASK_SIZE 32
+
+// Keys section is padded for reading
+// of small node keys by one load
+#define IMAGE_KEY_PADDING 16
+
+/**
+ * Header of compiled rules image
+ *
+ * Image is position independent, it consists
+ * of header, array of nodes, radix indexes of
+ * large nodes, array of weights of nodes, array
+ * of keys with the first byte of each token,
+ * array of symbol classes of tokens and blob
+ * of null terminated tokens, all links are
+ * offsets
+ */
+struct image_header {
+    char     magic[4];
+    uint32_t version;
+    uint32_t byte_order;   // Detects images from other platforms
+    uint32_t checksum;     // Checksum of everything after header
+    uint32_t node_count;
+    uint32_t token_size;   // Size of tokens blob aligned to 4 bytes
+    uint32_t radix_count;
+    uint32_t root_count;   // Count of nodes with radix index
+    uint32_t weighted;     // True if some node has not zero weight
+    uint32_t reserved[7];  // Keeps nodes aligned to 32 bytes
+};
+typedef struct image_header ImageHeader;
+
+/**
+ * Node of compiled rules image, children
+ * of node are stored one after another and
+ * sorted by tokens, the first node is head,
+ * nodes with equal subtrees share children
+ *
+ * Record takes 32 bytes, so two records
+ * are placed in one cache line
+ */
+struct image_node {
+    uint32_t token;        // Offset of token in tokens blob
+    uint32_t token_length;
+    uint32_t children;     // Index of the first child
+    uint32_t child_count;
+    char     inline_token[IMAGE_INLINE_SIZE];  // First bytes of token padded by zeros
+};
+typedef struct image_node ImageNode;
+
+/**
+ * Node of compressed radix index over children
+ * of large image node, each radix node covers
+ * children which tokens start with labels
+ * on the path from root, they are stored one
+ * after another since children are sorted
+ */
+struct image_radix {
+    uint32_t label;        // Offset of label in tokens blob
+    uint32_t label_length;
+    uint32_t children;     // Index of the first radix child
+    uint32_t child_count;  // Radix children are sorted by first bytes
+    uint32_t first;        // Index of the first covered image node
+    uint32_t count;
+};
+typedef struct image_radix ImageRadix;
+
+/**
+ * Link from image node to root of its radix
+ * index, links are sorted by image nodes
+ */
+struct image_radix_root {
+    uint32_t node;
+    uint32_t radix;
+};
+typedef struct image_radix_root ImageRadixRoot;
+
+/**
+ * Compiled rules image in memory,
+ * built from tree or mapped from file
+ */
+struct image {
+    const ImageHeader* header;
+    const ImageNode* nodes;
+    const ImageRadix* radix;
+    const ImageRadixRoot* roots;
+    const uint32_t* weights;  // Weights of nodes by node index
+    const uint8_t* keys;   // First bytes of tokens by node index
+    const uint8_t* symbols;  // Symbol classes of tokens by node index
+    const char* tokens;
+    void* data;            // Owned memory of image
+    size_t size;
+    int mapped;            // True if data is mapped file
+};
+typedef struct image Image;
+
+/**
+ * Compile tree of nodes into image, children
+ * are placed in breadth-first order, equal
+ * subtrees are placed once and shared
+ *
+ * @param head - Head node of the tree
+ *
+ * @return Created image
+ */
+LIB Image* image_create(Node* head);
+
+/**
+ * Map compiled image from file and check
+ * its version and checksum
+ *
+ * @param filepath - Path to compiled image
+ *
+ * @return Image or NULL with printed error
+ */
+LIB Image* image_load(const char* filepath);
+
+/**
+ * Write image to file
+ *
+ * @param image - Image for writing
+ * @param filepath - Path to output file
+ *
+ * @return Zero on success or not zero with printed error
+ */
+LIB int image_save(const Image* image, const char* filepath);
+
+/**
+ * Get token of image node
+ *
+ * @param image - Image containing node
+ * @param node - Node of image
+ *
+ * @return Null terminated token
+ */
+LIB const char* image_token(const Image* image, const ImageNode* node);
+
+/**
+ * Get bit set of classes of bytes which are
+ * not letters or digits, tokens which classes
+ * don't intersect don't have common symbols
+ *
+ * @param bytes - Bytes for classifying, may be not null terminated
+ * @param length - Count of bytes
+ *
+ * @return Bit set of symbol classes
+ */
+LIB uint8_t image_symbols(const char* bytes, unsigned length);
+
+/**
+ * Find child of node by token, children of
+ * small nodes are narrowed by the first byte
+ * of token, then binary search is used, large
+ * nodes are searched by their radix index
+ *
+ * @param image - Image containing node
+ * @param node - Parent node
+ * @param token - Token of child, may be not null terminated
+ * @param length - Length of token
+ *
+ * @return Child node or NULL
+ */
+LIB const ImageNode* image_find_child(const Image* image, const ImageNode* node, const char* token, unsigned length);
+
+/**
+ * Find children of node which tokens start
+ * with prefix, they are stored one after another,
+ * for large nodes it takes time of prefix length
+ *
+ * @param image - Image containing node
+ * @param node - Parent node
+ * @param prefix - Prefix of tokens, may be not null terminated
+ * @param length - Length of prefix
+ * @param first - Index of the first found child
+ *
+ * @return Count of found children
+ */
+LIB unsigned image_prefix_range(const Image* image, const ImageNode* node, const char* prefix,
+                                unsigned length, uint32_t* first);
+
+/**
+ * Compare prefix with tokens of consecutive nodes,
+ * leading bytes of tokens are stored inline in node
+ * records, so they are compared by SSE2 or by AVX2
+ * if processor supports it
+ *
+ * @param image - Image containing nodes
+ * @param first - Index of the first node
+ * @param count - Count of nodes, not more than IMAGE_MASK_SIZE
+ * @param prefix - Prefix without zero bytes, may be not null terminated
+ * @param length - Length of prefix
+ *
+ * @return Mask where bit i is set if token of node first + i starts with prefix
+ */
+LIB uint32_t image_prefix_mask(const Image* image, uint32_t first, unsigned count, const char* prefix,
+                               unsigned length);
+
+/**
+ * Function for image deallocating
+ *
+ * @param image - Image for deallocating
+ */
+LIB void image_free(Image* image);
+
+#endif //AUTOCOMPLETE_IMAGE_H
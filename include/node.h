@@ -1,7 +1,8 @@
 #ifndef AUTOCOMPLETE_NODE_H
 #define AUTOCOMPLETE_NODE_H
 
-#include "vector.h"
+#include "arena.h"
+#include "small_vector.h"
 
 #if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
     #if defined(BUILD_SHARED)
@@ -15,15 +16,29 @@
     #error unsupported platform
 #endif
 
+// Count of children placed inside of node,
+// most of nodes have not more children
+#define NODE_INLINE_CHILDREN 2
+
+struct node;
+SMALL_VECTOR_DECLARE(NodeList, node_list, struct node*, NODE_INLINE_CHILDREN)
+
 /**
  * Node of rules tree
  *
  * Contains self token and
  * vector of children nodes
+ *
+ * Token is not owned by node, usually
+ * it is interned in the pool of tree,
+ * node takes 40 bytes on 64-bit platforms
  */
 struct node {
-    char* token;
-    struct vector* children;
+    const char* token;
+    unsigned token_length : 31;
+    unsigned heap : 1;     // True if node isn't placed in arena
+    unsigned weight;       // Rank of token among siblings, set by config
+    NodeList children;
 };
 typedef struct node Node;
 
@@ -31,17 +46,19 @@ typedef struct node Node;
 /**
  * Create node by token and token_length
  *
- * @param token - Node containing string
- * @param token_length - Length of string
+ * @param arena - Arena for node and children or NULL for heap
+ * @param token - Null terminated string, which must outlive node
+ * @param token_length - Length of string without null terminator
  *
  * @return Created Node
  */
-LIB Node* node_create(char* token, unsigned token_length);
+LIB Node* node_create(Arena* arena, const char* token, unsigned token_length);
 
 
 /**
- * Function for free Node
- * and all his children
+ * Function for free Node and all his
+ * children, nodes placed in arena are
+ * freed together with arena
  *
  * @param node - Node for deallocating
  */
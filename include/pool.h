@@ -0,0 +1,83 @@
+#ifndef AUTOCOMPLETE_POOL_H
+#define AUTOCOMPLETE_POOL_H
+
+#include "arena.h"
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Interned string of pool
+ */
+struct pool_entry {
+    const char* str;
+    unsigned length;
+    unsigned hash;
+};
+typedef struct pool_entry PoolEntry;
+
+/**
+ * String pool which stores each
+ * distinct string only once
+ *
+ * Strings are null terminated and placed
+ * in arena, entries are kept in open
+ * addressing hash table
+ */
+struct pool {
+    Arena* arena;         // Arena for string data, not owned
+    PoolEntry* entries;
+    unsigned capacity;    // Always power of two
+    unsigned length;
+};
+typedef struct pool Pool;
+
+/**
+ * Function for allocating empty pool
+ *
+ * @param arena - Arena for string data, must outlive pool
+ *
+ * @return Pool structure
+ */
+LIB Pool* pool_create(Arena* arena);
+
+/**
+ * Get interned copy of string, the copy
+ * is created on the first request only
+ *
+ * @param pool - Pool for interning
+ * @param str - Input string, may be not null terminated
+ * @param length - Length of input string
+ *
+ * @return Null terminated string owned by pool arena
+ */
+LIB const char* pool_intern(Pool* pool, const char* str, unsigned length);
+
+/**
+ * Hash function used for strings of pool
+ *
+ * @param str - Input string, may be not null terminated
+ * @param length - Length of input string
+ *
+ * @return Hash of string
+ */
+LIB unsigned pool_hash(const char* str, unsigned length);
+
+/**
+ * Function for deallocating pool, strings
+ * are freed together with arena
+ *
+ * @param pool - Pool for deallocating
+ */
+LIB void pool_free(Pool* pool);
+
+#endif //AUTOCOMPLETE_POOL_H
@@ -13,11 +13,21 @@
     #error unsupported platform
 #endif
 
+#include "fuzzy.h"
+#include "query.h"
+#include "tokenizer.h"
 #include "tree.h"
 #include "vector.h"
 
 typedef Vector Tokens;
 
+// Max edit distance of probably predictions by default
+#define PREDICTIONS_DISTANCE 1
+
+// Size of cache line, memory of
+// threads is separated by it
+#define PREDICTIONS_CACHE_LINE 64
+
 enum predict_type {
     FAILURE  = 0,
     EXACTLY  = 1,
@@ -35,6 +45,46 @@ struct predictions {
 };
 typedef struct predictions Predictions;
 
+/**
+ * Predicted token borrowed from compiled tree,
+ * it is valid while the tree isn't changed
+ */
+struct prediction_view {
+    const char* token;     // Null terminated token
+    unsigned length;
+    unsigned weight;       // Weight from config plus usage count
+};
+typedef struct prediction_view PredictionView;
+
+/**
+ * Predictions written to memory of caller,
+ * predictions are never allocated, if there
+ * are more predictions than capacity then
+ * the best of them are written
+ */
+struct prediction_list {
+    PredictType type;
+    PredictionView* items; // Memory of caller, sorted by weights
+    unsigned capacity;
+    unsigned length;       // Count of written predictions
+    unsigned total;        // Count of found predictions, may be more than capacity
+    int ranked;            // True if weights are compared while filling
+    unsigned distance;     // Max edit distance of probably predictions
+};
+typedef struct prediction_list PredictionList;
+
+/**
+ * Memory of predictions owned by one thread,
+ * it takes whole cache lines, so scratches of
+ * threads don't share them
+ */
+struct prediction_scratch {
+    PredictionList list;           // Predictions follow scratch in memory
+    char buffer[TOKEN_TEXT_SIZE];  // Text of the last quoted token
+    void* memory;                  // Allocated memory of scratch
+};
+typedef struct prediction_scratch PredictionScratch;
+
 /**
  * Function for creating predictions
  * by rules and input string
@@ -47,6 +97,121 @@ typedef struct predictions Predictions;
  */
 LIB Predictions *predictions_create(Tree *rules, char *input, char *optional_brackets);
 
+/**
+ * Function for creating predictions of many
+ * inputs like predictions_create, threads take
+ * inputs by chunks and share the tree, which is
+ * compiled before them and must not be changed
+ *
+ * @param rules - Rules from config file
+ * @param inputs - The entered strings
+ * @param count - Count of inputs
+ * @param optional_brackets - Characters which optional values begin
+ * @param results - Memory for count predictions in order of inputs
+ * @param threads - Count of threads including current one
+ */
+LIB void predictions_create_batch(Tree* rules, char** inputs, unsigned count, char* optional_brackets,
+                                  Predictions** results, unsigned threads);
+
+/**
+ * Function for filling predictions by children
+ * of query node which start with last token or
+ * by probably children if there are no such,
+ * predictions are sorted by weights, probably
+ * children start with tokens which differ
+ * from last token by PREDICTIONS_DISTANCE
+ * insertions, deletions, substitutions or
+ * transpositions
+ *
+ * @param pred - Empty predictions for filling
+ * @param query - Query on node of the last complete token
+ * @param last_token - The last entered token, may be not null terminated
+ * @param length - Length of the last token
+ * @param optional_brackets - Characters which optional values begin
+ */
+LIB void predictions_fill(Predictions* pred, Query* query, const char* last_token, unsigned length,
+                          const char* optional_brackets);
+
+/**
+ * Function for initializing list of
+ * predictions by memory of caller, max
+ * edit distance may be changed after it
+ *
+ * @param list - List for initializing
+ * @param items - Memory for predictions
+ * @param capacity - Count of predictions in memory
+ */
+LIB void prediction_list_init(PredictionList* list, PredictionView* items, unsigned capacity);
+
+/**
+ * Function for finding predictions like
+ * predictions_create without memory allocations,
+ * tokens are borrowed from the tree
+ *
+ * @param rules - Rules from config file
+ * @param input - The entered string
+ * @param optional_brackets - Characters which optional values begin
+ * @param list - List for writing predictions
+ *
+ * @return Type of predictions
+ */
+LIB PredictType predictions_find(Tree* rules, const char* input, const char* optional_brackets,
+                                 PredictionList* list);
+
+/**
+ * Function for creating memory of predictions
+ * for one thread, max edit distance may be
+ * changed in its list after it
+ *
+ * @param capacity - Count of predictions in memory
+ *
+ * @return Created scratch or NULL if memory wasn't allocated
+ */
+LIB PredictionScratch* prediction_scratch_create(unsigned capacity);
+
+/**
+ * Function for finding predictions like
+ * predictions_find, but tree is only read, so
+ * threads may search one tree at once, each
+ * thread with its own scratch
+ *
+ * It doesn't allocate memory and doesn't exit,
+ * tree must be compiled before, it must not be
+ * changed or learned while it is searched,
+ * tree_set_brackets before searching makes it faster
+ *
+ * @param rules - Compiled rules from config file
+ * @param input - The entered string
+ * @param optional_brackets - Characters which optional values begin
+ * @param scratch - Memory of current thread, predictions are written to its list
+ *
+ * @return Zero on success or not zero if tree isn't compiled
+ */
+LIB int predictions_search(const Tree* rules, const char* input, const char* optional_brackets,
+                           PredictionScratch* scratch);
+
+/**
+ * Function for deallocating scratch
+ *
+ * @param scratch - Scratch for deallocating
+ */
+LIB void prediction_scratch_free(PredictionScratch* scratch);
+
+/**
+ * Function for filling list like predictions_fill,
+ * the best predictions are selected by heap, so
+ * it takes O(n log k) time for n predictions
+ * and list capacity k
+ *
+ * @param list - List for writing predictions
+ * @param query - Query on node of the last complete token
+ * @param last_token - The last entered token, may be not null terminated
+ * @param length - Length of the last token
+ * @param optional_brackets - Characters which optional values begin
+ */
+LIB void prediction_list_fill(PredictionList* list, Query* query, const char* last_token, unsigned length,
+                              const char* optional_brackets);
+
 /**
  * Deallocating prediction struct
  * @param predict - Struct for deallocating
@@ -54,7 +219,9 @@ LIB Predictions *predictions_create(Tree *rules, char *input, char *optional_bra
 LIB void predictions_free(Predictions* predict);
 
 /**
- * Split string to tokens by delimiter
+ * Split string to tokens by delimiter,
+ * tokens are copied and quotes are ignored,
+ * Tokenizer finds tokens without copying
  *
  * @param str - Input string
  * @param delimiter - Input delimiter character
@@ -71,7 +238,7 @@ LIB Tokens* split(char *str, char delimiter);
  *
  * @return Allocated token
  */
-LIB char* token_create(char* str, unsigned str_len);
+LIB char* token_create(const char* str, unsigned str_len);
 
 /**
  * Function for deallocating
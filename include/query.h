@@ -0,0 +1,169 @@
+#ifndef AUTOCOMPLETE_QUERY_H
+#define AUTOCOMPLETE_QUERY_H
+
+#include <stdint.h>
+
+#include "image.h"
+#include "tokenizer.h"
+#include "tree.h"
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Cursor over compiled image of rules,
+ * query doesn't allocate memory and
+ * returns tokens from the image as is
+ */
+struct query {
+    const Image* image;
+    const ImageNode* node;  // Node of the last found token
+    uint64_t path;          // Hash of path to node
+    const TreeUsage* usage; // Usage counts of tree or NULL
+    unsigned usage_capacity;
+    const uint8_t* flags;   // Flags of nodes by brackets of tree or NULL
+    const uint32_t* brackets;  // Bit set of brackets for flags
+    uint32_t first;         // Index of the first completion
+    uint32_t count;         // Count of completions
+};
+typedef struct query Query;
+
+/**
+ * Start query from head of the tree,
+ * tree is compiled if it was changed
+ *
+ * @param query - Query for initialization
+ * @param tree - Rules in the form of a tree
+ */
+LIB void query_init(Query* query, Tree* tree);
+
+/**
+ * Start query from head of the tree like
+ * query_init, but tree isn't compiled, so
+ * it is only read and may be shared by threads
+ *
+ * @param query - Query for initialization
+ * @param tree - Compiled rules in the form of a tree
+ *
+ * @return Zero on success or not zero if tree isn't compiled
+ */
+LIB int query_start(Query* query, const Tree* tree);
+
+/**
+ * Move query to child of current node
+ *
+ * @param query - Query for moving
+ * @param token - Token of child, may be not null terminated
+ * @param length - Length of token
+ *
+ * @return True if child was found or False
+ */
+LIB int query_descend(Query* query, const char* token, unsigned length);
+
+/**
+ * Move query to child by token of input,
+ * config tokens may contain quotes, so quoted
+ * token is found as it is typed at first and
+ * then by its text without quotes
+ *
+ * @param query - Query for moving
+ * @param input - The entered string
+ * @param span - Span of token in input
+ * @param buffer - Memory for text of quoted token, TOKEN_TEXT_SIZE bytes
+ *
+ * @return True if child was found or False
+ */
+LIB int query_descend_span(Query* query, const char* input, const TokenSpan* span, char* buffer);
+
+/**
+ * Find children of current node which
+ * tokens start with prefix, empty prefix
+ * finds all children
+ *
+ * @param query - Query for completion
+ * @param prefix - Prefix of tokens, may be not null terminated
+ * @param length - Length of prefix
+ *
+ * @return Count of completions
+ */
+LIB unsigned query_complete(Query* query, const char* prefix, unsigned length);
+
+/**
+ * Get completion found by query_complete
+ *
+ * @param query - Query with completions
+ * @param index - Index of completion
+ * @param length - Length of token, may be NULL
+ *
+ * @return Null terminated token from the image
+ */
+LIB const char* query_token(const Query* query, unsigned index, unsigned* length);
+
+/**
+ * Get rank of completion found by query_complete,
+ * it is weight from config plus usage count
+ *
+ * @param query - Query with completions
+ * @param index - Index of completion
+ *
+ * @return Rank of completion
+ */
+LIB uint32_t query_weight(const Query* query, unsigned index);
+
+/**
+ * Check if completions may have different ranks,
+ * otherwise they are ranked by order of tokens
+ *
+ * @param query - Query of tree
+ *
+ * @return True if tree has weights or usage counts
+ */
+LIB int query_ranked(const Query* query);
+
+/**
+ * Check if token of completion contains
+ * optional brackets, flags of tokens are
+ * set by tree_set_brackets before query_init
+ *
+ * @param query - Query with completions
+ * @param index - Index of completion
+ *
+ * @return True if token contains brackets
+ */
+LIB int query_optional(const Query* query, unsigned index);
+
+/**
+ * Check if token of completion has symbols
+ * of given classes, only such tokens may
+ * contain brackets of the same classes
+ *
+ * @param query - Query with completions
+ * @param index - Index of completion
+ * @param symbols - Bit set of symbol classes by image_symbols
+ *
+ * @return True if token has symbols of classes
+ */
+LIB int query_symbolic(const Query* query, unsigned index, uint8_t symbols);
+
+/**
+ * Check if token contains optional brackets
+ * which flags of completions are set by
+ *
+ * @param query - Query of tree
+ * @param token - Token for checking, may be not null terminated
+ * @param length - Length of token
+ *
+ * @return True if token contains brackets
+ */
+LIB int query_bracketed(const Query* query, const char* token, unsigned length);
+
+#endif //AUTOCOMPLETE_QUERY_H
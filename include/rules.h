@@ -0,0 +1,100 @@
+#ifndef AUTOCOMPLETE_RULES_H
+#define AUTOCOMPLETE_RULES_H
+
+#include "thread.h"
+#include "tree.h"
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Reloadable rules which watch configuration
+ * file and rebuild tree in background
+ *
+ * The current tree is published atomically,
+ * readers never wait for reloading, old tree
+ * is freed after all its readers are released,
+ * so reloading thread must not hold a snapshot
+ */
+struct rules {
+    char* filepath;
+    Tree* volatile current;
+    volatile long epoch;       // Parity selects counter of readers
+    volatile long readers[2];  // Count of readers in each epoch
+    volatile long stop;        // Flag for stopping watcher
+    Mutex reload_lock;         // Serializes reloads
+    Thread watcher;
+    int watching;
+};
+typedef struct rules Rules;
+
+/**
+ * Snapshot of rules acquired by reader
+ */
+struct rules_snapshot {
+    Tree* tree;
+    long epoch;
+};
+typedef struct rules_snapshot RulesSnapshot;
+
+/**
+ * Parse configuration file and start watching it,
+ * changes are applied in background thread
+ *
+ * @param filepath - Path to configuration file
+ *
+ * @return Reloadable rules
+ */
+LIB Rules* rules_create(const char* filepath);
+
+/**
+ * Get current tree for reading without locks,
+ * the tree stays valid until it is released
+ *
+ * @param rules - Reloadable rules
+ *
+ * @return Snapshot of rules
+ */
+LIB RulesSnapshot rules_acquire(Rules* rules);
+
+/**
+ * Release snapshot acquired by rules_acquire
+ *
+ * @param rules - Reloadable rules
+ * @param snapshot - Snapshot for releasing
+ */
+LIB void rules_release(Rules* rules, RulesSnapshot snapshot);
+
+/**
+ * Parse configuration file again and publish new
+ * tree, called by watcher when the file is changed
+ *
+ * It waits until all snapshots of old tree are
+ * released, so thread which holds a snapshot
+ * must release it before calling this function,
+ * otherwise the call never returns
+ *
+ * @param rules - Reloadable rules
+ *
+ * @return Zero on success or not zero if old tree is kept
+ */
+LIB int rules_reload(Rules* rules);
+
+/**
+ * Stop watching and deallocate rules,
+ * all snapshots must be released
+ *
+ * @param rules - Rules for deallocating
+ */
+LIB void rules_free(Rules* rules);
+
+#endif //AUTOCOMPLETE_RULES_H
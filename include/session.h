@@ -0,0 +1,99 @@
+#ifndef AUTOCOMPLETE_SESSION_H
+#define AUTOCOMPLETE_SESSION_H
+
+#include "cache.h"
+#include "image.h"
+#include "predictions.h"
+#include "tree.h"
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Node found by complete token of input,
+ * node is NULL if token wasn't found
+ */
+struct session_step {
+    const ImageNode* node;
+    uint64_t path;         // Hash of path to node
+    unsigned end;          // Offset of delimiter after token
+};
+typedef struct session_step SessionStep;
+
+/**
+ * Completion session for one input line,
+ * it remembers nodes of complete tokens, so
+ * only changed end of input is processed
+ */
+struct session {
+    Tree* tree;
+    const char* optional_brackets;
+    unsigned long revision;    // Revision of tree for steps
+    char* input;               // The previous input
+    unsigned length;
+    unsigned capacity;
+    SessionStep* steps;        // Stack of nodes by complete tokens
+    unsigned step_count;
+    unsigned step_capacity;
+    char buffer[TOKEN_TEXT_SIZE];  // Text of the last quoted token
+    Cache cache;               // The last found prediction lists
+    uint32_t brackets[TREE_BRACKET_WORDS];  // Bit set of brackets of session
+};
+typedef struct session Session;
+
+/**
+ * Function for creating completion session,
+ * tree and brackets must outlive session
+ *
+ * @param rules - Rules from config file
+ * @param optional_brackets - Characters which optional values begin
+ *
+ * @return Created session
+ */
+LIB Session* session_create(Tree* rules, const char* optional_brackets);
+
+/**
+ * Function for creating predictions like
+ * predictions_create, appending to input only
+ * refines the last token, erasing pops nodes
+ * of removed tokens
+ *
+ * @param session - Session of input line
+ * @param input - The entered string
+ *
+ * @return Predictions for current input
+ */
+LIB Predictions* session_predict(Session* session, const char* input);
+
+/**
+ * Function for finding predictions like
+ * session_predict without allocation of result,
+ * tokens are borrowed from the tree, predictions
+ * for the same node and last token are taken
+ * from cache of session
+ *
+ * @param session - Session of input line
+ * @param input - The entered string
+ * @param list - List for writing predictions
+ *
+ * @return Type of predictions
+ */
+LIB PredictType session_find(Session* session, const char* input, PredictionList* list);
+
+/**
+ * Function for deallocating session
+ *
+ * @param session - Session for deallocating
+ */
+LIB void session_free(Session* session);
+
+#endif //AUTOCOMPLETE_SESSION_H
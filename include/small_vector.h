@@ -0,0 +1,100 @@
+#ifndef AUTOCOMPLETE_SMALL_VECTOR_H
+#define AUTOCOMPLETE_SMALL_VECTOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/**
+ * Declare typed vector which keeps the first
+ * items inline, so small vectors need no memory
+ * allocations, others place items in arena
+ * or in heap if arena is NULL
+ *
+ * Vector of arena must always be used with
+ * the same arena, and vector of heap with NULL
+ *
+ * @param Name - Name of vector type
+ * @param prefix - Prefix of vector functions
+ * @param type - Type of items
+ * @param count - Count of inline items
+ */
+#define SMALL_VECTOR_DECLARE(Name, prefix, type, count)                                             \
+    struct prefix {                                                                                  \
+        unsigned length;                                                                             \
+        unsigned capacity;     /* Items are inline while capacity is count */                        \
+        union {                                                                                      \
+            type* data;                                                                              \
+            type items[count];                                                                       \
+        } storage;                                                                                   \
+    };                                                                                               \
+    typedef struct prefix Name;                                                                      \
+                                                                                                     \
+    static inline void prefix##_init(Name* vec) {                                                    \
+        vec->length = 0;                                                                             \
+        vec->capacity = (count);                                                                     \
+    }                                                                                                \
+                                                                                                     \
+    static inline type* prefix##_data(Name* vec) {                                                   \
+        return vec->capacity > (count) ? vec->storage.data : vec->storage.items;                     \
+    }                                                                                                \
+                                                                                                     \
+    /* Set capacity not less than length, items are moved inline if they fit */                    \
+    static inline void prefix##_reserve(Name* vec, Arena* arena, unsigned capacity) {                \
+        if (capacity < vec->length) {                                                                \
+            capacity = vec->length;                                                                  \
+        }                                                                                            \
+        if (capacity < (count)) {                                                                    \
+            capacity = (count);                                                                      \
+        }                                                                                            \
+        if (capacity == vec->capacity) {                                                             \
+            return;                                                                                  \
+        }                                                                                            \
+                                                                                                     \
+        type* data = NULL;                                                                           \
+        if (capacity > (count)) {                                                                    \
+            if (arena != NULL) {                                                                     \
+                data = (type*)arena_alloc(arena, sizeof(type) * capacity, sizeof(void*));           \
+            }                                                                                        \
+            else {                                                                                   \
+                data = (type*)malloc(sizeof(type) * capacity);                                       \
+            }                                                                                        \
+            if (data == NULL) {                                                                      \
+                fprintf(stderr, "[ERROR] Bad vector memory allocation\n");                           \
+                exit(1);                                                                             \
+            }                                                                                        \
+            memcpy(data, prefix##_data(vec), sizeof(type) * vec->length);                           \
+        }                                                                                            \
+                                                                                                     \
+        /* Old items of arena are abandoned */                                                       \
+        type* old = vec->capacity > (count) ? vec->storage.data : NULL;                              \
+        if (data != NULL) {                                                                          \
+            vec->storage.data = data;                                                                \
+        }                                                                                            \
+        else {                                                                                       \
+            memmove(vec->storage.items, old, sizeof(type) * vec->length);                            \
+        }                                                                                            \
+        if (arena == NULL) {                                                                         \
+            free(old);                                                                               \
+        }                                                                                            \
+        vec->capacity = capacity;                                                                    \
+    }                                                                                                \
+                                                                                                     \
+    static inline void prefix##_push(Name* vec, Arena* arena, type item) {                           \
+        if (vec->length == vec->capacity) {                                                          \
+            prefix##_reserve(vec, arena, vec->capacity * 2 + 4);                                     \
+        }                                                                                            \
+        prefix##_data(vec)[vec->length++] = item;                                                    \
+    }                                                                                                \
+                                                                                                     \
+    /* Free items placed in heap */                                                                  \
+    static inline void prefix##_free(Name* vec) {                                                    \
+        if (vec->capacity > (count)) {                                                               \
+            free(vec->storage.data);                                                                 \
+        }                                                                                            \
+        prefix##_init(vec);                                                                          \
+    }
+
+#endif //AUTOCOMPLETE_SMALL_VECTOR_H
@@ -0,0 +1,81 @@
+#ifndef AUTOCOMPLETE_THREAD_H
+#define AUTOCOMPLETE_THREAD_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+
+    #include <windows.h>
+
+    typedef HANDLE Thread;
+    typedef CRITICAL_SECTION Mutex;
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+
+    #include <pthread.h>
+
+    typedef pthread_t Thread;
+    typedef pthread_mutex_t Mutex;
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Function which is executed by thread
+ */
+typedef void (*ThreadFunction)(void* arg);
+
+/**
+ * Start new thread
+ *
+ * @param thread - Handle of started thread
+ * @param function - Function for executing
+ * @param arg - Argument of function
+ *
+ * @return Zero on success or not zero on error
+ */
+LIB int thread_create(Thread* thread, ThreadFunction function, void* arg);
+
+/**
+ * Wait for thread finishing
+ *
+ * @param thread - Handle of thread
+ */
+LIB void thread_join(Thread thread);
+
+/**
+ * Sleep current thread
+ *
+ * @param milliseconds - Time of sleeping
+ */
+LIB void thread_sleep(unsigned milliseconds);
+
+/**
+ * Functions for mutex initializing,
+ * locking, unlocking and destroying
+ *
+ * @param mutex - Mutex for using
+ */
+LIB void mutex_init(Mutex* mutex);
+LIB void mutex_lock(Mutex* mutex);
+LIB void mutex_unlock(Mutex* mutex);
+LIB void mutex_free(Mutex* mutex);
+
+/**
+ * Sequentially consistent atomic operations
+ *
+ * @param ptr - Address of value
+ * @param value - New value or addend
+ *
+ * @return Loaded value or value before change
+ */
+LIB void* atomic_load_ptr(void* volatile* ptr);
+LIB void* atomic_exchange_ptr(void* volatile* ptr, void* value);
+LIB long atomic_load_long(volatile long* ptr);
+LIB void atomic_store_long(volatile long* ptr, long value);
+LIB long atomic_add_long(volatile long* ptr, long value);
+
+#endif //AUTOCOMPLETE_THREAD_H
@@ -0,0 +1,84 @@
+#ifndef AUTOCOMPLETE_TOKENIZER_H
+#define AUTOCOMPLETE_TOKENIZER_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+// Max length of quoted token after removing of quotes
+#define TOKEN_TEXT_SIZE 256
+
+enum token_flags {
+    TOKEN_PLAIN  = 0,
+    TOKEN_QUOTED = 1,  // Token contains quotes or backslash escapes
+    TOKEN_OPEN   = 2,  // Quote of token isn't closed
+};
+
+/**
+ * Token found in input, span refers to
+ * the input and doesn't copy it
+ */
+struct token_span {
+    unsigned offset;   // Offset of token in input
+    unsigned length;   // Length of token with quotes
+    unsigned flags;
+};
+typedef struct token_span TokenSpan;
+
+/**
+ * Tokenizer splitting input by spaces,
+ * spaces inside of quotes or escaped by
+ * backslash don't split tokens
+ */
+struct tokenizer {
+    const char* input;
+    unsigned length;
+    unsigned position;  // Offset of the next token
+};
+typedef struct tokenizer Tokenizer;
+
+/**
+ * Function for initializing tokenizer
+ *
+ * @param tokenizer - Tokenizer for initializing
+ * @param input - The entered string
+ * @param length - Length of input
+ * @param position - Offset of input for starting, it must be
+ *                   the beginning of input or follow delimiter
+ */
+LIB void tokenizer_init(Tokenizer* tokenizer, const char* input, unsigned length, unsigned position);
+
+/**
+ * Function for getting the next token of input,
+ * the last token isn't followed by delimiter
+ * and it is empty if input ends with delimiter
+ *
+ * @param tokenizer - Tokenizer of input
+ * @param span - Span for the found token
+ *
+ * @return True if token is complete or False if it is the last token
+ */
+LIB int tokenizer_next(Tokenizer* tokenizer, TokenSpan* span);
+
+/**
+ * Function for getting text of token without
+ * quotes, text of plain token isn't copied
+ *
+ * @param input - The entered string
+ * @param span - Span of token in input
+ * @param buffer - Memory for text of quoted token, TOKEN_TEXT_SIZE bytes
+ * @param length - Pointer for length of text
+ *
+ * @return Text of token or NULL if it is longer than buffer
+ */
+LIB const char* token_text(const char* input, const TokenSpan* span, char* buffer, unsigned* length);
+
+#endif //AUTOCOMPLETE_TOKENIZER_H
@@ -1,7 +1,12 @@
 #ifndef AUTOCOMPLETE_TREE_H
 #define AUTOCOMPLETE_TREE_H
 
+#include <stdio.h>
+
+#include "arena.h"
+#include "image.h"
 #include "node.h"
+#include "pool.h"
 
 #if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
     #if defined(BUILD_SHARED)
@@ -15,12 +20,70 @@
     #error unsupported platform
 #endif
 
+// Usage counts stop growing at this value,
+// so weight and usage together fit 32 bits
+#define TREE_MAX_USAGE 1000000000u
+
+// Hash of path of head node, paths
+// of other nodes are never zero too
+#define TREE_PATH_HEAD 1u
+
+// Flag of image nodes which tokens
+// contain optional brackets
+#define TREE_NODE_OPTIONAL 1u
+
+// Count of words in set of bracket bytes
+#define TREE_BRACKET_WORDS 8
+
+/**
+ * Edge from parent to child node,
+ * used for fast search of children
+ * when paths are added to the tree
+ */
+struct tree_edge {
+    Node* parent;
+    Node* child;
+    unsigned hash;
+};
+typedef struct tree_edge TreeEdge;
+
+/**
+ * Usage count of node found by path of tokens,
+ * equal subtrees share nodes of image, so
+ * counts are kept by paths from head
+ */
+struct tree_usage {
+    uint64_t path;     // Hash of path, zero if entry is empty
+    uint32_t count;
+};
+typedef struct tree_usage TreeUsage;
+
 /**
- * Tree structure which contains
- * self head node
+ * Tree structure which contains self head
+ * node and pool of all node tokens
+ *
+ * Nodes, children and tokens are placed
+ * in arena, so tree is freed at once
+ *
+ * Predictions are made by compiled image of
+ * the tree, trees loaded from compiled file
+ * or frozen have only image and no nodes
  */
 struct tree {
     Node* head;
+    Arena* arena;
+    Pool* pool;
+    Image* image;
+    unsigned long revision;   // Count of compiled images
+    unsigned long learned;    // Count of learned lines
+    TreeUsage* usage;         // Hash table of usage counts, created on demand
+    unsigned usage_capacity;
+    unsigned usage_count;
+    uint8_t* flags;           // Flags by image node, created on demand
+    uint32_t brackets[TREE_BRACKET_WORDS];  // Bit set of optional brackets for flags
+    TreeEdge* edges;          // Index of edges, created on demand
+    unsigned edge_capacity;
+    unsigned edge_count;
 };
 typedef struct tree Tree;
 
@@ -34,6 +97,188 @@ typedef struct tree Tree;
  */
 LIB Tree* tree_create(const char* filepath);
 
+/**
+ * Parsing configuration file like tree_create,
+ * but without exit on errors
+ *
+ * @param filepath - Path to configuration file
+ *
+ * @return Rules in the form of a tree or NULL with printed error
+ */
+LIB Tree* tree_try_create(const char* filepath);
+
+/**
+ * Parsing configuration from stream incrementally,
+ * stream may be a pipe and is not closed
+ *
+ * @param stream - Input stream with configuration
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_create_from_stream(FILE* stream);
+
+/**
+ * Parsing configuration from file descriptor
+ * incrementally, descriptor may be a pipe or
+ * socket and is not closed
+ *
+ * @param fd - Input file descriptor
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_create_from_fd(int fd);
+
+/**
+ * Parsing configuration from memory buffer
+ * for autocomplete rules in the form of a tree
+ *
+ * @param data - Configuration in the same format as file
+ * @param length - Length of data, empty data gives empty tree
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_create_from_buffer(const char* data, size_t length);
+
+/**
+ * Parsing configuration file for autocomplete rules
+ * in several threads, the file is split by tokens
+ * without indentation into independent parts
+ *
+ * @param filepath - Path to configuration file
+ * @param threads - Count of parsing threads
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_create_parallel(const char* filepath, unsigned threads);
+
+/**
+ * Add path of tokens separated by spaces to
+ * the tree, existing tokens are reused
+ *
+ * Example: tree_add_path(rules, "git remote add [name]")
+ *
+ * @param tree - Tree for adding, not loaded from compiled file
+ * @param path - Tokens separated by spaces
+ *
+ * @return Zero on success or not zero on error
+ */
+LIB int tree_add_path(Tree* tree, const char* path);
+
+/**
+ * Compile changed tree for predictions,
+ * predictions_create calls it automatically
+ *
+ * @param tree - Tree for compiling
+ */
+LIB void tree_finalize(Tree* tree);
+
+/**
+ * Count usage of tokens of entered line,
+ * predictions of often used tokens are
+ * ranked higher after the same tokens, counts
+ * are reset when tree is compiled again
+ *
+ * Input functions never call it, application
+ * calls it for lines which should be learned
+ *
+ * @param tree - Rules in the form of a tree
+ * @param input - The entered string
+ */
+LIB void tree_learn(Tree* tree, const char* input);
+
+/**
+ * Get hash of path to child node
+ *
+ * @param path - Hash of path to parent node
+ * @param node - Index of child in image
+ *
+ * @return Hash of path, it is never zero
+ */
+LIB uint64_t tree_path(uint64_t path, uint32_t node);
+
+/**
+ * Get usage count of node by path
+ *
+ * @param usage - Hash table of usage counts or NULL
+ * @param capacity - Capacity of table
+ * @param path - Hash of path to node
+ *
+ * @return Count of uses
+ */
+LIB uint32_t tree_usage_count(const TreeUsage* usage, unsigned capacity, uint64_t path);
+
+/**
+ * Classify tokens of compiled tree by optional
+ * brackets, flags of nodes are kept and tree is
+ * classified again when it is compiled
+ *
+ * Predictions only read flags, so it is called
+ * once before tree is shared by readers, with
+ * other brackets predictions search brackets
+ * only in tokens with symbols of their classes
+ *
+ * @param tree - Rules in the form of a tree
+ * @param brackets - Characters which optional values begin
+ */
+LIB void tree_set_brackets(Tree* tree, const char* brackets);
+
+/**
+ * Get bit set of bracket bytes
+ *
+ * @param brackets - Characters which optional values begin
+ * @param mask - Memory for TREE_BRACKET_WORDS words of set
+ */
+LIB void tree_brackets_mask(const char* brackets, uint32_t* mask);
+
+/**
+ * Set flags of image nodes which
+ * tokens contain bracket bytes
+ *
+ * @param image - Image of nodes
+ * @param mask - Bit set of bracket bytes
+ * @param flags - Memory for flags of all nodes
+ */
+LIB void tree_classify(const Image* image, const uint32_t* mask, uint8_t* flags);
+
+/**
+ * Copy nodes and tokens of tree to new
+ * memory of exact size and free old memory,
+ * children added after load leave unused
+ * memory in the arena of tree
+ *
+ * @param tree - Tree for shrinking
+ */
+LIB void tree_shrink(Tree* tree);
+
+/**
+ * Compile tree and free its nodes, only
+ * flat image is kept and tree can't be changed
+ *
+ * @param tree - Tree for freezing
+ */
+LIB void tree_freeze(Tree* tree);
+
+/**
+ * Compile configuration file to binary
+ * file which is loaded without parsing
+ *
+ * @param text_path - Path to configuration file
+ * @param bin_path - Path to output compiled file
+ *
+ * @return Zero on success or not zero on error
+ */
+LIB int tree_compile(const char* text_path, const char* bin_path);
+
+/**
+ * Load rules from compiled file, the file
+ * is mapped to memory and ready for use
+ *
+ * @param filepath - Path to compiled file
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_load_binary(const char* filepath);
+
 /**
  * Function for tree deallocating
  *
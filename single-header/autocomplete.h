@@ -2,1185 +2,6852 @@
 #define AUTOCOMPLETE_H
 
 #ifdef _MSC_VER
-#ifndef _CRT_SECURE_NO_WARNINGS
+    #ifndef _CRT_SECURE_NO_WARNINGS
         #define _CRT_SECURE_NO_WARNINGS
     #endif
 #endif
 
-#include <string.h>
-#include <stdio.h>
-#include <stdlib.h>
+#ifndef AUTOCOMPLETE_ARENA_H
+#define AUTOCOMPLETE_ARENA_H
 
-#define MAX_OF(x, y) (((x) > (y)) ? (x) : (y))
+#include <stddef.h>
 
 #if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
-    #ifndef OS_WINDOWS
-        #define OS_WINDOWS
-
-        #include <windows.h>
-        #include <conio.h>
-        #include <stdint.h>
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
     #endif
 #elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
-    #ifndef OS_UNIX
-        #define OS_UNIX
-
-        #include <termios.h>
-        #include <unistd.h>
-        #include <sys/ioctl.h>
-    #endif
+    #define LIB extern __attribute__((visibility("default")))
 #else
-    #error Unknown environment!
+    #error unsupported platform
 #endif
 
-#if defined(OS_WINDOWS)
-    #define ENTER 13
-    #define BACKSPACE 8
-    #define LEFT 75
-    #define RIGHT 77
-    #define UP 72
-    #define DOWN 80
-    #define DEL 83
-    #define CTRL_C 3
-    #define SPECIAL_SEQ_1 0
-    #define SPECIAL_SEQ_2 224
-    #define COLOR_TYPE uint16_t
-    #define DEFAULT_TITLE_COLOR 160
-    #define DEFAULT_PREDICT_COLOR 8
-    #define DEFAULT_MAIN_COLOR 7
-#elif defined(OS_UNIX)
-    #define ENTER 10
-    #define BACKSPACE 127
-    #define LEFT 68
-    #define RIGHT 67
-    #define UP 65
-    #define DOWN 66
-    #define DEL 51
-    #define DEL_AFTER 126
-    #define SPECIAL_SEQ_1 27
-    #define SPECIAL_SEQ_2 91
-    #define COLOR_TYPE char*
-    #define DEFAULT_TITLE_COLOR "0;30;102"
-    #define DEFAULT_PREDICT_COLOR "90"
-    #define DEFAULT_MAIN_COLOR "0"
-#endif
-    #define SPACE 32
-    #define TAB 9
+// Alignment of arena allocations for any data
+#define ARENA_ALIGNMENT 16
 
 /**
- * Vector implementation for contain
- * pointers of allocated data
+ * Arena allocator which places data in a
+ * list of large blocks, each new block is
+ * twice as large as the previous one
+ *
+ * Memory is never freed separately, all
+ * blocks are freed together with arena
  */
-struct vector {
-    void**   data;
-    unsigned capacity;
-    unsigned length;
+struct arena {
+    char* block;     // Current block, starts with pointer to previous
+    size_t used;
+    size_t size;
 };
-typedef struct vector Vector;
-typedef Vector Tokens;
+typedef struct arena Arena;
 
 /**
- * Node of rules tree
+ * Function for allocating empty arena
  *
- * Contains self token and
- * vector of children nodes
+ * @return Arena structure
  */
-struct node {
-    char* token;
-    struct vector* children;
-};
-typedef struct node Node;
-
-enum predict_type {
-    FAILURE  = 0,
-    EXACTLY  = 1,
-    PROBABLY = 2,
-};
-typedef enum predict_type PredictType;
+LIB Arena* arena_create();
 
 /**
- * Structure containing vector of predictions
- * and prediction type
+ * Allocate memory from arena
+ *
+ * @param arena - Arena for allocating
+ * @param size - Size of memory in bytes
+ * @param alignment - Power of two alignment, not more than ARENA_ALIGNMENT
+ *
+ * @return Pointer to uninitialized memory
  */
-struct predictions {
-    PredictType type;
-    Tokens* tokens;
-};
-typedef struct predictions Predictions;
+LIB void* arena_alloc(Arena* arena, size_t size, size_t alignment);
 
 /**
- * Tree structure which contains
- * self head node
+ * Move all blocks of other arena to arena,
+ * other arena is deallocated
+ *
+ * @param arena - Arena for receiving blocks
+ * @param other - Arena for moving
  */
-struct tree {
-    Node* head;
-};
-typedef struct tree Tree;
+LIB void arena_merge(Arena* arena, Arena* other);
 
 /**
- * Gives the user a customizable convenient input
- * interface with autocomplete
- *
- * @param rules - Parsed rules from config file
- * @param title - The line printed before the input cursor
- * @param title_color - Color type for title printing
- * @param predict_color - Color type for prediction printing
- * @param main_color - Color type for user input printing
- * @param optional_brackets - Characters which optional values begin
+ * Function for deallocating arena
+ * and all allocated memory
  *
- * @return User input string
+ * @param arena - Arena for deallocating
  */
-char* custom_input(Tree* rules, char* title, COLOR_TYPE title_color, COLOR_TYPE predict_color,
-                       COLOR_TYPE main_color, char* optional_brackets);
+LIB void arena_free(Arena* arena);
+
+#endif //AUTOCOMPLETE_ARENA_H
+
+#ifndef AUTOCOMPLETE_SMALL_VECTOR_H
+#define AUTOCOMPLETE_SMALL_VECTOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /**
- * Gives the user a simple convenient input
- * interface with autocomplete
+ * Declare typed vector which keeps the first
+ * items inline, so small vectors need no memory
+ * allocations, others place items in arena
+ * or in heap if arena is NULL
  *
- * @param rules - Parsed rules from config file
+ * Vector of arena must always be used with
+ * the same arena, and vector of heap with NULL
  *
- * @return User input string
+ * @param Name - Name of vector type
+ * @param prefix - Prefix of vector functions
+ * @param type - Type of items
+ * @param count - Count of inline items
  */
-char* input(Tree* rules);
+#define SMALL_VECTOR_DECLARE(Name, prefix, type, count)                                             \
+    struct prefix {                                                                                  \
+        unsigned length;                                                                             \
+        unsigned capacity;     /* Items are inline while capacity is count */                        \
+        union {                                                                                      \
+            type* data;                                                                              \
+            type items[count];                                                                       \
+        } storage;                                                                                   \
+    };                                                                                               \
+    typedef struct prefix Name;                                                                      \
+                                                                                                     \
+    static inline void prefix##_init(Name* vec) {                                                    \
+        vec->length = 0;                                                                             \
+        vec->capacity = (count);                                                                     \
+    }                                                                                                \
+                                                                                                     \
+    static inline type* prefix##_data(Name* vec) {                                                   \
+        return vec->capacity > (count) ? vec->storage.data : vec->storage.items;                     \
+    }                                                                                                \
+                                                                                                     \
+    /* Set capacity not less than length, items are moved inline if they fit */                    \
+    static inline void prefix##_reserve(Name* vec, Arena* arena, unsigned capacity) {                \
+        if (capacity < vec->length) {                                                                \
+            capacity = vec->length;                                                                  \
+        }                                                                                            \
+        if (capacity < (count)) {                                                                    \
+            capacity = (count);                                                                      \
+        }                                                                                            \
+        if (capacity == vec->capacity) {                                                             \
+            return;                                                                                  \
+        }                                                                                            \
+                                                                                                     \
+        type* data = NULL;                                                                           \
+        if (capacity > (count)) {                                                                    \
+            if (arena != NULL) {                                                                     \
+                data = (type*)arena_alloc(arena, sizeof(type) * capacity, sizeof(void*));           \
+            }                                                                                        \
+            else {                                                                                   \
+                data = (type*)malloc(sizeof(type) * capacity);                                       \
+            }                                                                                        \
+            if (data == NULL) {                                                                      \
+                fprintf(stderr, "[ERROR] Bad vector memory allocation\n");                           \
+                exit(1);                                                                             \
+            }                                                                                        \
+            memcpy(data, prefix##_data(vec), sizeof(type) * vec->length);                           \
+        }                                                                                            \
+                                                                                                     \
+        /* Old items of arena are abandoned */                                                       \
+        type* old = vec->capacity > (count) ? vec->storage.data : NULL;                              \
+        if (data != NULL) {                                                                          \
+            vec->storage.data = data;                                                                \
+        }                                                                                            \
+        else {                                                                                       \
+            memmove(vec->storage.items, old, sizeof(type) * vec->length);                            \
+        }                                                                                            \
+        if (arena == NULL) {                                                                         \
+            free(old);                                                                               \
+        }                                                                                            \
+        vec->capacity = capacity;                                                                    \
+    }                                                                                                \
+                                                                                                     \
+    static inline void prefix##_push(Name* vec, Arena* arena, type item) {                           \
+        if (vec->length == vec->capacity) {                                                          \
+            prefix##_reserve(vec, arena, vec->capacity * 2 + 4);                                     \
+        }                                                                                            \
+        prefix##_data(vec)[vec->length++] = item;                                                    \
+    }                                                                                                \
+                                                                                                     \
+    /* Free items placed in heap */                                                                  \
+    static inline void prefix##_free(Name* vec) {                                                    \
+        if (vec->capacity > (count)) {                                                               \
+            free(vec->storage.data);                                                                 \
+        }                                                                                            \
+        prefix##_init(vec);                                                                          \
+    }
+
+#endif //AUTOCOMPLETE_SMALL_VECTOR_H
+
+#ifndef AUTOCOMPLETE_NODE_H
+#define AUTOCOMPLETE_NODE_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+// Count of children placed inside of node,
+// most of nodes have not more children
+#define NODE_INLINE_CHILDREN 2
+
+struct node;
+SMALL_VECTOR_DECLARE(NodeList, node_list, struct node*, NODE_INLINE_CHILDREN)
 
 /**
- * Function for checking if input
- * character in ignore list
+ * Node of rules tree
  *
- * @param ch - Input character
+ * Contains self token and
+ * vector of children nodes
  *
- * @return True if character in ignore list or False
+ * Token is not owned by node, usually
+ * it is interned in the pool of tree,
+ * node takes 40 bytes on 64-bit platforms
  */
-int is_ignore_key(int ch);
+struct node {
+    const char* token;
+    unsigned token_length : 31;
+    unsigned heap : 1;     // True if node isn't placed in arena
+    unsigned weight;       // Rank of token among siblings, set by config
+    NodeList children;
+};
+typedef struct node Node;
 
 /**
  * Create node by token and token_length
  *
- * @param token - Node containing string
- * @param token_length - Length of string
+ * @param arena - Arena for node and children or NULL for heap
+ * @param token - Null terminated string, which must outlive node
+ * @param token_length - Length of string without null terminator
  *
  * @return Created Node
  */
-Node* node_create(char* token, unsigned token_length);
+LIB Node* node_create(Arena* arena, const char* token, unsigned token_length);
 
 /**
- * Function for free Node
- * and all his children
+ * Function for free Node and all his
+ * children, nodes placed in arena are
+ * freed together with arena
  *
  * @param node - Node for deallocating
  */
-void node_free(Node* node);
+LIB void node_free(Node* node);
+
+#endif // AUTOCOMPLETE_NODE_H
+
+#ifndef AUTOCOMPLETE_IMAGE_H
+#define AUTOCOMPLETE_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+#define IMAGE_MAGIC "CLAC"
+#define IMAGE_VERSION 7
+#define IMAGE_BYTE_ORDER 0x01020304u
+
+// Children of nodes with at most this count of
+// children are narrowed by comparing all keys at
+// once, children of others by their radix index
+#define IMAGE_SMALL_NODE 16
+
+// Tokens not longer than this are compared
+// by node record without reading tokens blob
+#define IMAGE_INLINE_SIZE 16
+
+// Count of nodes compared by image_prefix_mask at once
+#define IMAGE_MASK_SIZE 32
+
+// Keys section is padded for reading
+// of small node keys by one load
+#define IMAGE_KEY_PADDING 16
 
 /**
- * Function for creating predictions
- * by rules and input string
- *
- * @param rules - Rules from config file
- * @param input - The entered string
- * @param optional_brackets - Characters which optional values begin
+ * Header of compiled rules image
  *
- * @return Predictions for current input
+ * Image is position independent, it consists
+ * of header, array of nodes, radix indexes of
+ * large nodes, array of weights of nodes, array
+ * of keys with the first byte of each token,
+ * array of symbol classes of tokens and blob
+ * of null terminated tokens, all links are
+ * offsets
  */
-Predictions *predictions_create(Tree *rules, char *input, char *optional_brackets);
+struct image_header {
+    char     magic[4];
+    uint32_t version;
+    uint32_t byte_order;   // Detects images from other platforms
+    uint32_t checksum;     // Checksum of everything after header
+    uint32_t node_count;
+    uint32_t token_size;   // Size of tokens blob aligned to 4 bytes
+    uint32_t radix_count;
+    uint32_t root_count;   // Count of nodes with radix index
+    uint32_t weighted;     // True if some node has not zero weight
+    uint32_t reserved[7];  // Keeps nodes aligned to 32 bytes
+};
+typedef struct image_header ImageHeader;
 
 /**
- * Deallocating prediction struct
- * @param predict - Struct for deallocating
+ * Node of compiled rules image, children
+ * of node are stored one after another and
+ * sorted by tokens, the first node is head,
+ * nodes with equal subtrees share children
+ *
+ * Record takes 32 bytes, so two records
+ * are placed in one cache line
  */
-void predictions_free(Predictions* predict);
+struct image_node {
+    uint32_t token;        // Offset of token in tokens blob
+    uint32_t token_length;
+    uint32_t children;     // Index of the first child
+    uint32_t child_count;
+    char     inline_token[IMAGE_INLINE_SIZE];  // First bytes of token padded by zeros
+};
+typedef struct image_node ImageNode;
 
 /**
- * Split string to tokens by delimiter
- *
- * @param str - Input string
- * @param delimiter - Input delimiter character
- *
- * @return Vector of tokens
+ * Node of compressed radix index over children
+ * of large image node, each radix node covers
+ * children which tokens start with labels
+ * on the path from root, they are stored one
+ * after another since children are sorted
  */
-Tokens* split(char *str, char delimiter);
+struct image_radix {
+    uint32_t label;        // Offset of label in tokens blob
+    uint32_t label_length;
+    uint32_t children;     // Index of the first radix child
+    uint32_t child_count;  // Radix children are sorted by first bytes
+    uint32_t first;        // Index of the first covered image node
+    uint32_t count;
+};
+typedef struct image_radix ImageRadix;
 
 /**
- * Function for token creation
- *
- * @param str - Input string
- * @param str_len - Length of input string
- *
- * @return Allocated token
+ * Link from image node to root of its radix
+ * index, links are sorted by image nodes
  */
-char* token_create(char* str, unsigned str_len);
+struct image_radix_root {
+    uint32_t node;
+    uint32_t radix;
+};
+typedef struct image_radix_root ImageRadixRoot;
 
 /**
- * Function for deallocating
- * vector of tokens
- *
- * @param tokens - Vector for deallocating
+ * Compiled rules image in memory,
+ * built from tree or mapped from file
  */
-void tokens_free(Tokens* tokens);
+struct image {
+    const ImageHeader* header;
+    const ImageNode* nodes;
+    const ImageRadix* radix;
+    const ImageRadixRoot* roots;
+    const uint32_t* weights;  // Weights of nodes by node index
+    const uint8_t* keys;   // First bytes of tokens by node index
+    const uint8_t* symbols;  // Symbol classes of tokens by node index
+    const char* tokens;
+    void* data;            // Owned memory of image
+    size_t size;
+    int mapped;            // True if data is mapped file
+};
+typedef struct image Image;
 
 /**
- * Function for checking if string
- * contains special characters
+ * Compile tree of nodes into image, children
+ * are placed in breadth-first order, equal
+ * subtrees are placed once and shared
  *
- * @param str - Input string
- * @param chars - Special characters
+ * @param head - Head node of the tree
  *
- * @return True if contains or False
+ * @return Created image
  */
-int contain_chars(const char* str, const char* chars);
+LIB Image* image_create(Node* head);
 
 /**
- * Function for getting current
- * terminal width (cols count)
+ * Map compiled image from file and check
+ * its version and checksum
  *
- * @return Count of terminal cols
+ * @param filepath - Path to compiled image
+ *
+ * @return Image or NULL with printed error
  */
-short terminal_width();
+LIB Image* image_load(const char* filepath);
 
 /**
- * Printing text with color in terminal
+ * Write image to file
  *
- * @param text - Printable text
- * @param color - Color for printing
+ * @param image - Image for writing
+ * @param filepath - Path to output file
+ *
+ * @return Zero on success or not zero with printed error
  */
-void color_print(char* text, COLOR_TYPE color);
+LIB int image_save(const Image* image, const char* filepath);
 
 /**
- * Function for clear all content
- * in current line
+ * Get token of image node
+ *
+ * @param image - Image containing node
+ * @param node - Node of image
+ *
+ * @return Null terminated token
  */
-void clear_line();
+LIB const char* image_token(const Image* image, const ImageNode* node);
 
 /**
- * Set cursor X position in current row
+ * Get bit set of classes of bytes which are
+ * not letters or digits, tokens which classes
+ * don't intersect don't have common symbols
  *
- * @param x - Position for moving
+ * @param bytes - Bytes for classifying, may be not null terminated
+ * @param length - Count of bytes
+ *
+ * @return Bit set of symbol classes
  */
-void set_cursor_x(short x);
+LIB uint8_t image_symbols(const char* bytes, unsigned length);
 
 /**
- * Function for getting current
- * cursor Y position
+ * Find child of node by token, children of
+ * small nodes are narrowed by the first byte
+ * of token, then binary search is used, large
+ * nodes are searched by their radix index
  *
- * @return Current cursor Y position
+ * @param image - Image containing node
+ * @param node - Parent node
+ * @param token - Token of child, may be not null terminated
+ * @param length - Length of token
+ *
+ * @return Child node or NULL
  */
-short get_cursor_y();
+LIB const ImageNode* image_find_child(const Image* image, const ImageNode* node, const char* token, unsigned length);
 
-#if defined(OS_UNIX)
 /**
- * Implementation of getch() function
- * for UNIX systems
+ * Find children of node which tokens start
+ * with prefix, they are stored one after another,
+ * for large nodes it takes time of prefix length
  *
- * @return Pressed keyboard character
+ * @param image - Image containing node
+ * @param node - Parent node
+ * @param prefix - Prefix of tokens, may be not null terminated
+ * @param length - Length of prefix
+ * @param first - Index of the first found child
+ *
+ * @return Count of found children
  */
-int _getch();
-#endif
+LIB unsigned image_prefix_range(const Image* image, const ImageNode* node, const char* prefix,
+                                unsigned length, uint32_t* first);
 
 /**
- * Parsing configuration file for autocomplete
- * rules in the form of a tree
+ * Compare prefix with tokens of consecutive nodes,
+ * leading bytes of tokens are stored inline in node
+ * records, so they are compared by SSE2 or by AVX2
+ * if processor supports it
  *
- * @param filepath - Path to configuration file
+ * @param image - Image containing nodes
+ * @param first - Index of the first node
+ * @param count - Count of nodes, not more than IMAGE_MASK_SIZE
+ * @param prefix - Prefix without zero bytes, may be not null terminated
+ * @param length - Length of prefix
  *
- * @return Rules in the form of a tree
+ * @return Mask where bit i is set if token of node first + i starts with prefix
  */
-Tree* tree_create(const char* filepath);
+LIB uint32_t image_prefix_mask(const Image* image, uint32_t first, unsigned count, const char* prefix,
+                               unsigned length);
 
 /**
- * Function for tree deallocating
+ * Function for image deallocating
  *
- * @param tree - Tree structure for deallocating
+ * @param image - Image for deallocating
+ */
+LIB void image_free(Image* image);
+
+#endif //AUTOCOMPLETE_IMAGE_H
+
+#ifndef AUTOCOMPLETE_POOL_H
+#define AUTOCOMPLETE_POOL_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Interned string of pool
  */
-void tree_free(Tree* tree);
+struct pool_entry {
+    const char* str;
+    unsigned length;
+    unsigned hash;
+};
+typedef struct pool_entry PoolEntry;
 
 /**
- * Function for allocating vector
+ * String pool which stores each
+ * distinct string only once
  *
- * @param length - Initial length of vector
- * @return Vector structure
+ * Strings are null terminated and placed
+ * in arena, entries are kept in open
+ * addressing hash table
  */
-Vector* vector_create(unsigned length);
+struct pool {
+    Arena* arena;         // Arena for string data, not owned
+    PoolEntry* entries;
+    unsigned capacity;    // Always power of two
+    unsigned length;
+};
+typedef struct pool Pool;
 
 /**
- * Function for peak value from
- * vector by index
+ * Function for allocating empty pool
  *
- * @param vec - Vector for getting info
- * @param index - Position of element
+ * @param arena - Arena for string data, must outlive pool
  *
- * @return Pointer of data by index
+ * @return Pool structure
  */
-void* vector_get(Vector* vec, unsigned index);
+LIB Pool* pool_create(Arena* arena);
 
 /**
- * Function for setting value in
- * vector by index
+ * Get interned copy of string, the copy
+ * is created on the first request only
  *
- * @param vec - Vector for setting info
- * @param index - Position of element
- * @param item - Pointer of data for setting
+ * @param pool - Pool for interning
+ * @param str - Input string, may be not null terminated
+ * @param length - Length of input string
+ *
+ * @return Null terminated string owned by pool arena
  */
-void vector_set(Vector* vec, unsigned index, void* item);
+LIB const char* pool_intern(Pool* pool, const char* str, unsigned length);
 
 /**
- * Function for append data to vector
+ * Hash function used for strings of pool
  *
- * @param vec - Vector for pushing
- * @param item - Item for pushing
+ * @param str - Input string, may be not null terminated
+ * @param length - Length of input string
+ *
+ * @return Hash of string
  */
-void vector_push(Vector* vec, void* item);
+LIB unsigned pool_hash(const char* str, unsigned length);
 
 /**
- * Function for deallocating vector
- * @param vec - Vector for deallocating
+ * Function for deallocating pool, strings
+ * are freed together with arena
+ *
+ * @param pool - Pool for deallocating
  */
-void vector_free(Vector* vec);
+LIB void pool_free(Pool* pool);
 
-char* custom_input(Tree* rules, char* title, COLOR_TYPE title_color, COLOR_TYPE predict_color,
-                   COLOR_TYPE main_color, char* optional_brackets) {
-    // Initialize buffer for reading
-    short buff_len = 0;
-    short buff_cap = terminal_width();
-    char* buff = (char*)calloc((size_t)buff_cap, sizeof(char));
-    if (buff == NULL) {
-        fprintf(stderr, "[ERROR] Couldn't allocate memory for buffer\n");
-        exit(1);
-    }
+#endif //AUTOCOMPLETE_POOL_H
 
-    // Cursor offset in buffer for moving
-    int offset = 0;
+#ifndef AUTOCOMPLETE_TREE_H
+#define AUTOCOMPLETE_TREE_H
 
-    // Current hint number
-    int hint_num = 0;
+#include <stdio.h>
 
-    // Calculate title length
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+// Usage counts stop growing at this value,
+// so weight and usage together fit 32 bits
+#define TREE_MAX_USAGE 1000000000u
+
+// Hash of path of head node, paths
+// of other nodes are never zero too
+#define TREE_PATH_HEAD 1u
+
+// Flag of image nodes which tokens
+// contain optional brackets
+#define TREE_NODE_OPTIONAL 1u
+
+// Count of words in set of bracket bytes
+#define TREE_BRACKET_WORDS 8
+
+/**
+ * Edge from parent to child node,
+ * used for fast search of children
+ * when paths are added to the tree
+ */
+struct tree_edge {
+    Node* parent;
+    Node* child;
+    unsigned hash;
+};
+typedef struct tree_edge TreeEdge;
+
+/**
+ * Usage count of node found by path of tokens,
+ * equal subtrees share nodes of image, so
+ * counts are kept by paths from head
+ */
+struct tree_usage {
+    uint64_t path;     // Hash of path, zero if entry is empty
+    uint32_t count;
+};
+typedef struct tree_usage TreeUsage;
+
+/**
+ * Tree structure which contains self head
+ * node and pool of all node tokens
+ *
+ * Nodes, children and tokens are placed
+ * in arena, so tree is freed at once
+ *
+ * Predictions are made by compiled image of
+ * the tree, trees loaded from compiled file
+ * or frozen have only image and no nodes
+ */
+struct tree {
+    Node* head;
+    Arena* arena;
+    Pool* pool;
+    Image* image;
+    unsigned long revision;   // Count of compiled images
+    unsigned long learned;    // Count of learned lines
+    TreeUsage* usage;         // Hash table of usage counts, created on demand
+    unsigned usage_capacity;
+    unsigned usage_count;
+    uint8_t* flags;           // Flags by image node, created on demand
+    uint32_t brackets[TREE_BRACKET_WORDS];  // Bit set of optional brackets for flags
+    TreeEdge* edges;          // Index of edges, created on demand
+    unsigned edge_capacity;
+    unsigned edge_count;
+};
+typedef struct tree Tree;
+
+/**
+ * Parsing configuration file for autocomplete
+ * rules in the form of a tree
+ *
+ * @param filepath - Path to configuration file
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_create(const char* filepath);
+
+/**
+ * Parsing configuration file like tree_create,
+ * but without exit on errors
+ *
+ * @param filepath - Path to configuration file
+ *
+ * @return Rules in the form of a tree or NULL with printed error
+ */
+LIB Tree* tree_try_create(const char* filepath);
+
+/**
+ * Parsing configuration from stream incrementally,
+ * stream may be a pipe and is not closed
+ *
+ * @param stream - Input stream with configuration
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_create_from_stream(FILE* stream);
+
+/**
+ * Parsing configuration from file descriptor
+ * incrementally, descriptor may be a pipe or
+ * socket and is not closed
+ *
+ * @param fd - Input file descriptor
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_create_from_fd(int fd);
+
+/**
+ * Parsing configuration from memory buffer
+ * for autocomplete rules in the form of a tree
+ *
+ * @param data - Configuration in the same format as file
+ * @param length - Length of data, empty data gives empty tree
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_create_from_buffer(const char* data, size_t length);
+
+/**
+ * Parsing configuration file for autocomplete rules
+ * in several threads, the file is split by tokens
+ * without indentation into independent parts
+ *
+ * @param filepath - Path to configuration file
+ * @param threads - Count of parsing threads
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_create_parallel(const char* filepath, unsigned threads);
+
+/**
+ * Add path of tokens separated by spaces to
+ * the tree, existing tokens are reused
+ *
+ * Example: tree_add_path(rules, "git remote add [name]")
+ *
+ * @param tree - Tree for adding, not loaded from compiled file
+ * @param path - Tokens separated by spaces
+ *
+ * @return Zero on success or not zero on error
+ */
+LIB int tree_add_path(Tree* tree, const char* path);
+
+/**
+ * Compile changed tree for predictions,
+ * predictions_create calls it automatically
+ *
+ * @param tree - Tree for compiling
+ */
+LIB void tree_finalize(Tree* tree);
+
+/**
+ * Count usage of tokens of entered line,
+ * predictions of often used tokens are
+ * ranked higher after the same tokens, counts
+ * are reset when tree is compiled again
+ *
+ * Input functions never call it, application
+ * calls it for lines which should be learned
+ *
+ * @param tree - Rules in the form of a tree
+ * @param input - The entered string
+ */
+LIB void tree_learn(Tree* tree, const char* input);
+
+/**
+ * Get hash of path to child node
+ *
+ * @param path - Hash of path to parent node
+ * @param node - Index of child in image
+ *
+ * @return Hash of path, it is never zero
+ */
+LIB uint64_t tree_path(uint64_t path, uint32_t node);
+
+/**
+ * Get usage count of node by path
+ *
+ * @param usage - Hash table of usage counts or NULL
+ * @param capacity - Capacity of table
+ * @param path - Hash of path to node
+ *
+ * @return Count of uses
+ */
+LIB uint32_t tree_usage_count(const TreeUsage* usage, unsigned capacity, uint64_t path);
+
+/**
+ * Classify tokens of compiled tree by optional
+ * brackets, flags of nodes are kept and tree is
+ * classified again when it is compiled
+ *
+ * Predictions only read flags, so it is called
+ * once before tree is shared by readers, with
+ * other brackets predictions search brackets
+ * only in tokens with symbols of their classes
+ *
+ * @param tree - Rules in the form of a tree
+ * @param brackets - Characters which optional values begin
+ */
+LIB void tree_set_brackets(Tree* tree, const char* brackets);
+
+/**
+ * Get bit set of bracket bytes
+ *
+ * @param brackets - Characters which optional values begin
+ * @param mask - Memory for TREE_BRACKET_WORDS words of set
+ */
+LIB void tree_brackets_mask(const char* brackets, uint32_t* mask);
+
+/**
+ * Set flags of image nodes which
+ * tokens contain bracket bytes
+ *
+ * @param image - Image of nodes
+ * @param mask - Bit set of bracket bytes
+ * @param flags - Memory for flags of all nodes
+ */
+LIB void tree_classify(const Image* image, const uint32_t* mask, uint8_t* flags);
+
+/**
+ * Copy nodes and tokens of tree to new
+ * memory of exact size and free old memory,
+ * children added after load leave unused
+ * memory in the arena of tree
+ *
+ * @param tree - Tree for shrinking
+ */
+LIB void tree_shrink(Tree* tree);
+
+/**
+ * Compile tree and free its nodes, only
+ * flat image is kept and tree can't be changed
+ *
+ * @param tree - Tree for freezing
+ */
+LIB void tree_freeze(Tree* tree);
+
+/**
+ * Compile configuration file to binary
+ * file which is loaded without parsing
+ *
+ * @param text_path - Path to configuration file
+ * @param bin_path - Path to output compiled file
+ *
+ * @return Zero on success or not zero on error
+ */
+LIB int tree_compile(const char* text_path, const char* bin_path);
+
+/**
+ * Load rules from compiled file, the file
+ * is mapped to memory and ready for use
+ *
+ * @param filepath - Path to compiled file
+ *
+ * @return Rules in the form of a tree
+ */
+LIB Tree* tree_load_binary(const char* filepath);
+
+/**
+ * Function for tree deallocating
+ *
+ * @param tree - Tree structure for deallocating
+ */
+LIB void tree_free(Tree* tree);
+
+#endif // AUTOCOMPLETE_TREE_H
+
+#ifndef AUTOCOMPLETE_TERMINAL_H
+#define AUTOCOMPLETE_TERMINAL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #ifndef OS_WINDOWS
+        #define OS_WINDOWS
+        #define COLOR_TYPE uint16_t
+        #if defined(BUILD_SHARED)
+            #define LIB extern __declspec(dllexport)
+        #else
+            #define LIB
+        #endif
+
+        #include <windows.h>
+        #include <conio.h>
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #ifndef OS_UNIX
+        #define OS_UNIX
+        #define COLOR_TYPE char*
+        #define LIB extern __attribute__((visibility("default")))
+
+        #include <termios.h>
+        #include <unistd.h>
+        #include <sys/ioctl.h>
+    #endif
+#else
+    #error Unknown environment!
+#endif
+
+#if defined(OS_WINDOWS)
+    // https://stackoverflow.com/questions/4053837/colorizing-text-in-the-console-with-c#answer-4053879
+    #define DEFAULT_TITLE_COLOR 160
+    #define DEFAULT_PREDICT_COLOR 8
+    #define DEFAULT_MAIN_COLOR 7
+#elif defined(OS_UNIX)
+    // https://stackoverflow.com/questions/2616906/how-do-i-output-coloured-text-to-a-linux-terminal#answer-45300654
+    #define DEFAULT_TITLE_COLOR "0;30;102"
+    #define DEFAULT_PREDICT_COLOR "90"
+    #define DEFAULT_MAIN_COLOR "0"
+#endif
+
+/**
+ * Function for getting current
+ * terminal width (cols count)
+ *
+ * @return Count of terminal cols
+ */
+LIB short terminal_width();
+
+/**
+ * Printing text with color in terminal
+ *
+ * @param text - Printable text
+ * @param color - Color for printing
+ */
+LIB void color_print(char* text, COLOR_TYPE color);
+
+/**
+ * Function for clear all content
+ * in current line
+ */
+LIB void clear_line();
+
+/**
+ * Set cursor X position in current row
+ *
+ * @param x - Position for moving
+ */
+LIB void set_cursor_x(short x);
+
+/**
+ * Function for getting current
+ * cursor Y position
+ *
+ * @return Current cursor Y position
+ */
+LIB short get_cursor_y();
+
+#if defined(OS_UNIX)
+/**
+ * Implementation of getch() function
+ * for UNIX systems
+ *
+ * @return Pressed keyboard character
+ */
+LIB int _getch();
+#endif
+
+#endif //AUTOCOMPLETE_TERMINAL_H
+
+#ifndef AUTOCOMPLETE_AUTOCOMPLETE_H
+#define AUTOCOMPLETE_AUTOCOMPLETE_H
+
+#include <string.h>
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #ifndef OS_WINDOWS
+        #define OS_WINDOWS
+        #if defined(BUILD_SHARED)
+            #define LIB extern __declspec(dllexport)
+        #else
+            #define LIB
+        #endif
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #ifndef OS_UNIX
+        #define OS_UNIX
+        #define LIB extern __attribute__((visibility("default")))
+    #endif
+#else
+    #error Unknown environment!
+#endif
+
+#if defined(OS_WINDOWS)
+    #define ENTER 13
+    #define BACKSPACE 8
+    #define LEFT 75
+    #define RIGHT 77
+    #define UP 72
+    #define DOWN 80
+    #define DEL 83
+    #define CTRL_C 3
+    #define SPECIAL_SEQ_1 0
+    #define SPECIAL_SEQ_2 224
+#elif defined(OS_UNIX)
+    #define ENTER 10
+    #define BACKSPACE 127
+    #define LEFT 68
+    #define RIGHT 67
+    #define UP 65
+    #define DOWN 66
+    #define DEL 51
+    #define DEL_AFTER 126
+    #define SPECIAL_SEQ_1 27
+    #define SPECIAL_SEQ_2 91
+#endif
+#define SPACE 32
+#define TAB 9
+
+/**
+ * Gives the user a customizable convenient input
+ * interface with autocomplete
+ *
+ * @param rules - Parsed rules from config file
+ * @param title - The line printed before the input cursor
+ * @param title_color - Color type for title printing
+ * @param predict_color - Color type for prediction printing
+ * @param main_color - Color type for user input printing
+ * @param optional_brackets - Characters which optional values begin
+ *
+ * @return User input string
+ */
+LIB char* custom_input(Tree* rules, char* title, COLOR_TYPE title_color, COLOR_TYPE predict_color,
+            COLOR_TYPE main_color, char* optional_brackets);
+
+/**
+ * Gives the user a simple convenient input
+ * interface with autocomplete
+ *
+ * @param rules - Parsed rules from config file
+ *
+ * @return User input string
+ */
+LIB char* input(Tree* rules);
+
+/**
+ * Function for checking if input
+ * character in ignore list
+ *
+ * @param ch - Input character
+ *
+ * @return True if character in ignore list or False
+ */
+LIB int is_ignore_key(int ch);
+
+#endif //AUTOCOMPLETE_AUTOCOMPLETE_H
+
+#ifndef AUTOCOMPLETE_FUZZY_H
+#define AUTOCOMPLETE_FUZZY_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+#include <stdint.h>
+
+// Only the first bytes of longer patterns are
+// compared, pattern fits one machine word
+#define FUZZY_MAX_LENGTH 64
+
+// Greater distances are reduced to this
+#define FUZZY_MAX_DISTANCE 8
+
+/**
+ * Columns of edit distance matrix by
+ * bit vectors of vertical differences
+ */
+struct fuzzy_state {
+    uint64_t vp;       // Positive vertical differences
+    uint64_t vn;       // Negative vertical differences
+    uint64_t d0;       // Zero diagonal differences
+    uint64_t pm;       // Matches of pattern with previous character
+    unsigned score;    // Distance of pattern and text
+    unsigned best;     // The least distance of pattern and text prefixes
+    unsigned band;     // Cell at the top of band of cells near diagonal
+    int alive;         // False if longer text prefixes never match
+};
+typedef struct fuzzy_state FuzzyState;
+
+/**
+ * Bounded Damerau-Levenshtein matcher of pattern
+ * with prefixes of texts by Myers' bit-parallel
+ * algorithm with transpositions by Hyyro
+ *
+ * Columns of the last text are kept, so
+ * sorted texts sharing prefixes are matched
+ * from the end of common prefix
+ */
+struct fuzzy {
+    uint64_t peq[256];     // Bit masks of pattern positions by characters
+    unsigned length;       // Length of pattern
+    unsigned distance;     // Max edit distance
+    const char* text;      // The last matched text
+    unsigned depth;        // Count of computed columns of the last text
+    unsigned dead;         // Length of prefix of the last text which
+                           // no text can extend to match, or zero
+    FuzzyState states[FUZZY_MAX_LENGTH + FUZZY_MAX_DISTANCE + 1];
+};
+typedef struct fuzzy Fuzzy;
+
+/**
+ * Function for initializing matcher by pattern
+ *
+ * @param fuzzy - Matcher for initializing
+ * @param pattern - Pattern, may be not null terminated
+ * @param length - Length of pattern
+ * @param distance - Max count of insertions, deletions,
+ *                   substitutions and transpositions
+ */
+LIB void fuzzy_init(Fuzzy* fuzzy, const char* pattern, unsigned length, unsigned distance);
+
+/**
+ * Function for matching pattern with text, it takes
+ * time of text length after prefix which is common
+ * with the previous text, but not more than length
+ * of pattern plus distance, text must outlive the
+ * next call
+ *
+ * @param fuzzy - Matcher of pattern
+ * @param text - Text, may be not null terminated
+ * @param length - Length of text
+ *
+ * @return True if some prefix of text is not more than distance away from pattern,
+ *         otherwise dead field of matcher is set
+ */
+LIB int fuzzy_match(Fuzzy* fuzzy, const char* text, unsigned length);
+
+#endif //AUTOCOMPLETE_FUZZY_H
+
+#ifndef AUTOCOMPLETE_TOKENIZER_H
+#define AUTOCOMPLETE_TOKENIZER_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+// Max length of quoted token after removing of quotes
+#define TOKEN_TEXT_SIZE 256
+
+enum token_flags {
+    TOKEN_PLAIN  = 0,
+    TOKEN_QUOTED = 1,  // Token contains quotes or backslash escapes
+    TOKEN_OPEN   = 2,  // Quote of token isn't closed
+};
+
+/**
+ * Token found in input, span refers to
+ * the input and doesn't copy it
+ */
+struct token_span {
+    unsigned offset;   // Offset of token in input
+    unsigned length;   // Length of token with quotes
+    unsigned flags;
+};
+typedef struct token_span TokenSpan;
+
+/**
+ * Tokenizer splitting input by spaces,
+ * spaces inside of quotes or escaped by
+ * backslash don't split tokens
+ */
+struct tokenizer {
+    const char* input;
+    unsigned length;
+    unsigned position;  // Offset of the next token
+};
+typedef struct tokenizer Tokenizer;
+
+/**
+ * Function for initializing tokenizer
+ *
+ * @param tokenizer - Tokenizer for initializing
+ * @param input - The entered string
+ * @param length - Length of input
+ * @param position - Offset of input for starting, it must be
+ *                   the beginning of input or follow delimiter
+ */
+LIB void tokenizer_init(Tokenizer* tokenizer, const char* input, unsigned length, unsigned position);
+
+/**
+ * Function for getting the next token of input,
+ * the last token isn't followed by delimiter
+ * and it is empty if input ends with delimiter
+ *
+ * @param tokenizer - Tokenizer of input
+ * @param span - Span for the found token
+ *
+ * @return True if token is complete or False if it is the last token
+ */
+LIB int tokenizer_next(Tokenizer* tokenizer, TokenSpan* span);
+
+/**
+ * Function for getting text of token without
+ * quotes, text of plain token isn't copied
+ *
+ * @param input - The entered string
+ * @param span - Span of token in input
+ * @param buffer - Memory for text of quoted token, TOKEN_TEXT_SIZE bytes
+ * @param length - Pointer for length of text
+ *
+ * @return Text of token or NULL if it is longer than buffer
+ */
+LIB const char* token_text(const char* input, const TokenSpan* span, char* buffer, unsigned* length);
+
+#endif //AUTOCOMPLETE_TOKENIZER_H
+
+#ifndef AUTOCOMPLETE_QUERY_H
+#define AUTOCOMPLETE_QUERY_H
+
+#include <stdint.h>
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Cursor over compiled image of rules,
+ * query doesn't allocate memory and
+ * returns tokens from the image as is
+ */
+struct query {
+    const Image* image;
+    const ImageNode* node;  // Node of the last found token
+    uint64_t path;          // Hash of path to node
+    const TreeUsage* usage; // Usage counts of tree or NULL
+    unsigned usage_capacity;
+    const uint8_t* flags;   // Flags of nodes by brackets of tree or NULL
+    const uint32_t* brackets;  // Bit set of brackets for flags
+    uint32_t first;         // Index of the first completion
+    uint32_t count;         // Count of completions
+};
+typedef struct query Query;
+
+/**
+ * Start query from head of the tree,
+ * tree is compiled if it was changed
+ *
+ * @param query - Query for initialization
+ * @param tree - Rules in the form of a tree
+ */
+LIB void query_init(Query* query, Tree* tree);
+
+/**
+ * Start query from head of the tree like
+ * query_init, but tree isn't compiled, so
+ * it is only read and may be shared by threads
+ *
+ * @param query - Query for initialization
+ * @param tree - Compiled rules in the form of a tree
+ *
+ * @return Zero on success or not zero if tree isn't compiled
+ */
+LIB int query_start(Query* query, const Tree* tree);
+
+/**
+ * Move query to child of current node
+ *
+ * @param query - Query for moving
+ * @param token - Token of child, may be not null terminated
+ * @param length - Length of token
+ *
+ * @return True if child was found or False
+ */
+LIB int query_descend(Query* query, const char* token, unsigned length);
+
+/**
+ * Move query to child by token of input,
+ * config tokens may contain quotes, so quoted
+ * token is found as it is typed at first and
+ * then by its text without quotes
+ *
+ * @param query - Query for moving
+ * @param input - The entered string
+ * @param span - Span of token in input
+ * @param buffer - Memory for text of quoted token, TOKEN_TEXT_SIZE bytes
+ *
+ * @return True if child was found or False
+ */
+LIB int query_descend_span(Query* query, const char* input, const TokenSpan* span, char* buffer);
+
+/**
+ * Find children of current node which
+ * tokens start with prefix, empty prefix
+ * finds all children
+ *
+ * @param query - Query for completion
+ * @param prefix - Prefix of tokens, may be not null terminated
+ * @param length - Length of prefix
+ *
+ * @return Count of completions
+ */
+LIB unsigned query_complete(Query* query, const char* prefix, unsigned length);
+
+/**
+ * Get completion found by query_complete
+ *
+ * @param query - Query with completions
+ * @param index - Index of completion
+ * @param length - Length of token, may be NULL
+ *
+ * @return Null terminated token from the image
+ */
+LIB const char* query_token(const Query* query, unsigned index, unsigned* length);
+
+/**
+ * Get rank of completion found by query_complete,
+ * it is weight from config plus usage count
+ *
+ * @param query - Query with completions
+ * @param index - Index of completion
+ *
+ * @return Rank of completion
+ */
+LIB uint32_t query_weight(const Query* query, unsigned index);
+
+/**
+ * Check if completions may have different ranks,
+ * otherwise they are ranked by order of tokens
+ *
+ * @param query - Query of tree
+ *
+ * @return True if tree has weights or usage counts
+ */
+LIB int query_ranked(const Query* query);
+
+/**
+ * Check if token of completion contains
+ * optional brackets, flags of tokens are
+ * set by tree_set_brackets before query_init
+ *
+ * @param query - Query with completions
+ * @param index - Index of completion
+ *
+ * @return True if token contains brackets
+ */
+LIB int query_optional(const Query* query, unsigned index);
+
+/**
+ * Check if token of completion has symbols
+ * of given classes, only such tokens may
+ * contain brackets of the same classes
+ *
+ * @param query - Query with completions
+ * @param index - Index of completion
+ * @param symbols - Bit set of symbol classes by image_symbols
+ *
+ * @return True if token has symbols of classes
+ */
+LIB int query_symbolic(const Query* query, unsigned index, uint8_t symbols);
+
+/**
+ * Check if token contains optional brackets
+ * which flags of completions are set by
+ *
+ * @param query - Query of tree
+ * @param token - Token for checking, may be not null terminated
+ * @param length - Length of token
+ *
+ * @return True if token contains brackets
+ */
+LIB int query_bracketed(const Query* query, const char* token, unsigned length);
+
+#endif //AUTOCOMPLETE_QUERY_H
+
+#ifndef AUTOCOMPLETE_VECTOR_H
+#define AUTOCOMPLETE_VECTOR_H
+
+#define MAX_OF(x, y) (((x) > (y)) ? (x) : (y))
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Vector implementation for contain
+ * pointers of allocated data
+ */
+struct vector {
+    void**   data;
+    unsigned capacity;
+    unsigned length;
+};
+typedef struct vector Vector;
+
+/**
+ * Function for allocating vector
+ *
+ * @param length - Initial length of vector
+ * @return Vector structure
+ */
+LIB Vector* vector_create(unsigned length);
+
+/**
+ * Function for peak value from
+ * vector by index
+ *
+ * @param vec - Vector for getting info
+ * @param index - Position of element
+ *
+ * @return Pointer of data by index
+ */
+LIB void* vector_get(Vector* vec, unsigned index);
+
+/**
+ * Function for setting value in
+ * vector by index
+ *
+ * @param vec - Vector for setting info
+ * @param index - Position of element
+ * @param item - Pointer of data for setting
+ */
+LIB void vector_set(Vector* vec, unsigned index, void* item);
+
+/**
+ * Function for append data to vector
+ *
+ * @param vec - Vector for pushing
+ * @param item - Item for pushing
+ */
+LIB void vector_push(Vector* vec, void* item);
+
+/**
+ * Function for deallocating vector
+ * @param vec - Vector for deallocating
+ */
+LIB void vector_free(Vector* vec);
+
+#endif //AUTOCOMPLETE_VECTOR_H
+
+#ifndef AUTOCOMPLETE_PREDICTIONS_H
+#define AUTOCOMPLETE_PREDICTIONS_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+typedef Vector Tokens;
+
+// Max edit distance of probably predictions by default
+#define PREDICTIONS_DISTANCE 1
+
+// Size of cache line, memory of
+// threads is separated by it
+#define PREDICTIONS_CACHE_LINE 64
+
+enum predict_type {
+    FAILURE  = 0,
+    EXACTLY  = 1,
+    PROBABLY = 2,
+};
+typedef enum predict_type PredictType;
+
+/**
+ * Structure containing vector of predictions
+ * and prediction type
+ */
+struct predictions {
+    PredictType type;
+    Tokens* tokens;
+};
+typedef struct predictions Predictions;
+
+/**
+ * Predicted token borrowed from compiled tree,
+ * it is valid while the tree isn't changed
+ */
+struct prediction_view {
+    const char* token;     // Null terminated token
+    unsigned length;
+    unsigned weight;       // Weight from config plus usage count
+};
+typedef struct prediction_view PredictionView;
+
+/**
+ * Predictions written to memory of caller,
+ * predictions are never allocated, if there
+ * are more predictions than capacity then
+ * the best of them are written
+ */
+struct prediction_list {
+    PredictType type;
+    PredictionView* items; // Memory of caller, sorted by weights
+    unsigned capacity;
+    unsigned length;       // Count of written predictions
+    unsigned total;        // Count of found predictions, may be more than capacity
+    int ranked;            // True if weights are compared while filling
+    unsigned distance;     // Max edit distance of probably predictions
+};
+typedef struct prediction_list PredictionList;
+
+/**
+ * Memory of predictions owned by one thread,
+ * it takes whole cache lines, so scratches of
+ * threads don't share them
+ */
+struct prediction_scratch {
+    PredictionList list;           // Predictions follow scratch in memory
+    char buffer[TOKEN_TEXT_SIZE];  // Text of the last quoted token
+    void* memory;                  // Allocated memory of scratch
+};
+typedef struct prediction_scratch PredictionScratch;
+
+/**
+ * Function for creating predictions
+ * by rules and input string
+ *
+ * @param rules - Rules from config file
+ * @param input - The entered string
+ * @param optional_brackets - Characters which optional values begin
+ *
+ * @return Predictions for current input
+ */
+LIB Predictions *predictions_create(Tree *rules, char *input, char *optional_brackets);
+
+/**
+ * Function for creating predictions of many
+ * inputs like predictions_create, threads take
+ * inputs by chunks and share the tree, which is
+ * compiled before them and must not be changed
+ *
+ * @param rules - Rules from config file
+ * @param inputs - The entered strings
+ * @param count - Count of inputs
+ * @param optional_brackets - Characters which optional values begin
+ * @param results - Memory for count predictions in order of inputs
+ * @param threads - Count of threads including current one
+ */
+LIB void predictions_create_batch(Tree* rules, char** inputs, unsigned count, char* optional_brackets,
+                                  Predictions** results, unsigned threads);
+
+/**
+ * Function for filling predictions by children
+ * of query node which start with last token or
+ * by probably children if there are no such,
+ * predictions are sorted by weights, probably
+ * children start with tokens which differ
+ * from last token by PREDICTIONS_DISTANCE
+ * insertions, deletions, substitutions or
+ * transpositions
+ *
+ * @param pred - Empty predictions for filling
+ * @param query - Query on node of the last complete token
+ * @param last_token - The last entered token, may be not null terminated
+ * @param length - Length of the last token
+ * @param optional_brackets - Characters which optional values begin
+ */
+LIB void predictions_fill(Predictions* pred, Query* query, const char* last_token, unsigned length,
+                          const char* optional_brackets);
+
+/**
+ * Function for initializing list of
+ * predictions by memory of caller, max
+ * edit distance may be changed after it
+ *
+ * @param list - List for initializing
+ * @param items - Memory for predictions
+ * @param capacity - Count of predictions in memory
+ */
+LIB void prediction_list_init(PredictionList* list, PredictionView* items, unsigned capacity);
+
+/**
+ * Function for finding predictions like
+ * predictions_create without memory allocations,
+ * tokens are borrowed from the tree
+ *
+ * @param rules - Rules from config file
+ * @param input - The entered string
+ * @param optional_brackets - Characters which optional values begin
+ * @param list - List for writing predictions
+ *
+ * @return Type of predictions
+ */
+LIB PredictType predictions_find(Tree* rules, const char* input, const char* optional_brackets,
+                                 PredictionList* list);
+
+/**
+ * Function for creating memory of predictions
+ * for one thread, max edit distance may be
+ * changed in its list after it
+ *
+ * @param capacity - Count of predictions in memory
+ *
+ * @return Created scratch or NULL if memory wasn't allocated
+ */
+LIB PredictionScratch* prediction_scratch_create(unsigned capacity);
+
+/**
+ * Function for finding predictions like
+ * predictions_find, but tree is only read, so
+ * threads may search one tree at once, each
+ * thread with its own scratch
+ *
+ * It doesn't allocate memory and doesn't exit,
+ * tree must be compiled before, it must not be
+ * changed or learned while it is searched,
+ * tree_set_brackets before searching makes it faster
+ *
+ * @param rules - Compiled rules from config file
+ * @param input - The entered string
+ * @param optional_brackets - Characters which optional values begin
+ * @param scratch - Memory of current thread, predictions are written to its list
+ *
+ * @return Zero on success or not zero if tree isn't compiled
+ */
+LIB int predictions_search(const Tree* rules, const char* input, const char* optional_brackets,
+                           PredictionScratch* scratch);
+
+/**
+ * Function for deallocating scratch
+ *
+ * @param scratch - Scratch for deallocating
+ */
+LIB void prediction_scratch_free(PredictionScratch* scratch);
+
+/**
+ * Function for filling list like predictions_fill,
+ * the best predictions are selected by heap, so
+ * it takes O(n log k) time for n predictions
+ * and list capacity k
+ *
+ * @param list - List for writing predictions
+ * @param query - Query on node of the last complete token
+ * @param last_token - The last entered token, may be not null terminated
+ * @param length - Length of the last token
+ * @param optional_brackets - Characters which optional values begin
+ */
+LIB void prediction_list_fill(PredictionList* list, Query* query, const char* last_token, unsigned length,
+                              const char* optional_brackets);
+
+/**
+ * Deallocating prediction struct
+ * @param predict - Struct for deallocating
+ */
+LIB void predictions_free(Predictions* predict);
+
+/**
+ * Split string to tokens by delimiter,
+ * tokens are copied and quotes are ignored,
+ * Tokenizer finds tokens without copying
+ *
+ * @param str - Input string
+ * @param delimiter - Input delimiter character
+ *
+ * @return Vector of tokens
+ */
+LIB Tokens* split(char *str, char delimiter);
+
+/**
+ * Function for token creation
+ *
+ * @param str - Input string
+ * @param str_len - Length of input string
+ *
+ * @return Allocated token
+ */
+LIB char* token_create(const char* str, unsigned str_len);
+
+/**
+ * Function for deallocating
+ * vector of tokens
+ *
+ * @param tokens - Vector for deallocating
+ */
+LIB void tokens_free(Tokens* tokens);
+
+/**
+ * Function for checking if string
+ * contains special characters
+ *
+ * @param str - Input string
+ * @param chars - Special characters
+ *
+ * @return True if contains or False
+ */
+LIB int contain_chars(const char* str, const char* chars);
+
+#endif // AUTOCOMPLETE_PREDICTIONS_H
+
+#ifndef AUTOCOMPLETE_CACHE_H
+#define AUTOCOMPLETE_CACHE_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+// Count of remembered prediction lists
+#define CACHE_SIZE 8
+
+/**
+ * Key of predictions, they depend on node of
+ * the last complete token and path to it, the
+ * last token and max edit distance, revision and
+ * learned count of tree change when nodes or
+ * ranks change
+ */
+struct cache_key {
+    const ImageNode* node;
+    uint64_t path;
+    unsigned long revision;
+    unsigned long learned;
+    unsigned distance;
+    const char* prefix;    // The last token, may be not null terminated
+    unsigned length;
+};
+typedef struct cache_key CacheKey;
+
+/**
+ * Remembered predictions of one key,
+ * tokens are borrowed from the tree
+ */
+struct cache_entry {
+    const ImageNode* node;
+    uint64_t path;
+    unsigned long revision;
+    unsigned long learned;
+    unsigned distance;
+    char prefix[TOKEN_TEXT_SIZE];
+    unsigned length;
+    PredictType type;
+    PredictionView* items;  // The best predictions in order of list
+    unsigned count;         // Count of remembered predictions
+    unsigned capacity;
+    unsigned total;         // Count of found predictions
+    int ranked;
+    unsigned long used;     // Time of the last use, zero if entry is empty
+};
+typedef struct cache_entry CacheEntry;
+
+/**
+ * Cache of the last used prediction lists,
+ * the least recently used list is replaced
+ */
+struct cache {
+    CacheEntry entries[CACHE_SIZE];
+    unsigned long clock;    // Counter of uses
+};
+typedef struct cache Cache;
+
+/**
+ * Function for initializing empty cache
+ *
+ * @param cache - Cache for initializing
+ */
+LIB void cache_init(Cache* cache);
+
+/**
+ * Function for writing remembered predictions
+ * to list, list with more capacity than count
+ * of remembered predictions is written only if
+ * all found predictions were remembered
+ *
+ * @param cache - Cache of predictions
+ * @param key - Key of predictions
+ * @param list - List for writing predictions
+ *
+ * @return True if predictions were written or False
+ */
+LIB int cache_find(Cache* cache, const CacheKey* key, PredictionList* list);
+
+/**
+ * Function for remembering predictions of
+ * filled list instead of the least recently
+ * used predictions
+ *
+ * @param cache - Cache of predictions
+ * @param key - Key of predictions
+ * @param list - Filled list of predictions
+ */
+LIB void cache_store(Cache* cache, const CacheKey* key, const PredictionList* list);
+
+/**
+ * Function for deallocating
+ * memory of cache entries
+ *
+ * @param cache - Cache for deallocating
+ */
+LIB void cache_free(Cache* cache);
+
+#endif //AUTOCOMPLETE_CACHE_H
+
+#ifndef AUTOCOMPLETE_THREAD_H
+#define AUTOCOMPLETE_THREAD_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+
+    #include <windows.h>
+
+    typedef HANDLE Thread;
+    typedef CRITICAL_SECTION Mutex;
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+
+    #include <pthread.h>
+
+    typedef pthread_t Thread;
+    typedef pthread_mutex_t Mutex;
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Function which is executed by thread
+ */
+typedef void (*ThreadFunction)(void* arg);
+
+/**
+ * Start new thread
+ *
+ * @param thread - Handle of started thread
+ * @param function - Function for executing
+ * @param arg - Argument of function
+ *
+ * @return Zero on success or not zero on error
+ */
+LIB int thread_create(Thread* thread, ThreadFunction function, void* arg);
+
+/**
+ * Wait for thread finishing
+ *
+ * @param thread - Handle of thread
+ */
+LIB void thread_join(Thread thread);
+
+/**
+ * Sleep current thread
+ *
+ * @param milliseconds - Time of sleeping
+ */
+LIB void thread_sleep(unsigned milliseconds);
+
+/**
+ * Functions for mutex initializing,
+ * locking, unlocking and destroying
+ *
+ * @param mutex - Mutex for using
+ */
+LIB void mutex_init(Mutex* mutex);
+LIB void mutex_lock(Mutex* mutex);
+LIB void mutex_unlock(Mutex* mutex);
+LIB void mutex_free(Mutex* mutex);
+
+/**
+ * Sequentially consistent atomic operations
+ *
+ * @param ptr - Address of value
+ * @param value - New value or addend
+ *
+ * @return Loaded value or value before change
+ */
+LIB void* atomic_load_ptr(void* volatile* ptr);
+LIB void* atomic_exchange_ptr(void* volatile* ptr, void* value);
+LIB long atomic_load_long(volatile long* ptr);
+LIB void atomic_store_long(volatile long* ptr, long value);
+LIB long atomic_add_long(volatile long* ptr, long value);
+
+#endif //AUTOCOMPLETE_THREAD_H
+
+#ifndef AUTOCOMPLETE_RULES_H
+#define AUTOCOMPLETE_RULES_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Reloadable rules which watch configuration
+ * file and rebuild tree in background
+ *
+ * The current tree is published atomically,
+ * readers never wait for reloading, old tree
+ * is freed after all its readers are released,
+ * so reloading thread must not hold a snapshot
+ */
+struct rules {
+    char* filepath;
+    Tree* volatile current;
+    volatile long epoch;       // Parity selects counter of readers
+    volatile long readers[2];  // Count of readers in each epoch
+    volatile long stop;        // Flag for stopping watcher
+    Mutex reload_lock;         // Serializes reloads
+    Thread watcher;
+    int watching;
+};
+typedef struct rules Rules;
+
+/**
+ * Snapshot of rules acquired by reader
+ */
+struct rules_snapshot {
+    Tree* tree;
+    long epoch;
+};
+typedef struct rules_snapshot RulesSnapshot;
+
+/**
+ * Parse configuration file and start watching it,
+ * changes are applied in background thread
+ *
+ * @param filepath - Path to configuration file
+ *
+ * @return Reloadable rules
+ */
+LIB Rules* rules_create(const char* filepath);
+
+/**
+ * Get current tree for reading without locks,
+ * the tree stays valid until it is released
+ *
+ * @param rules - Reloadable rules
+ *
+ * @return Snapshot of rules
+ */
+LIB RulesSnapshot rules_acquire(Rules* rules);
+
+/**
+ * Release snapshot acquired by rules_acquire
+ *
+ * @param rules - Reloadable rules
+ * @param snapshot - Snapshot for releasing
+ */
+LIB void rules_release(Rules* rules, RulesSnapshot snapshot);
+
+/**
+ * Parse configuration file again and publish new
+ * tree, called by watcher when the file is changed
+ *
+ * It waits until all snapshots of old tree are
+ * released, so thread which holds a snapshot
+ * must release it before calling this function,
+ * otherwise the call never returns
+ *
+ * @param rules - Reloadable rules
+ *
+ * @return Zero on success or not zero if old tree is kept
+ */
+LIB int rules_reload(Rules* rules);
+
+/**
+ * Stop watching and deallocate rules,
+ * all snapshots must be released
+ *
+ * @param rules - Rules for deallocating
+ */
+LIB void rules_free(Rules* rules);
+
+#endif //AUTOCOMPLETE_RULES_H
+
+#ifndef AUTOCOMPLETE_SESSION_H
+#define AUTOCOMPLETE_SESSION_H
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #if defined(BUILD_SHARED)
+        #define LIB extern __declspec(dllexport)
+    #else
+        #define LIB
+    #endif
+#elif defined(__APPLE__) || defined(__unix__) || defined(__unix) || defined(unix) || defined(__linux__)
+    #define LIB extern __attribute__((visibility("default")))
+#else
+    #error unsupported platform
+#endif
+
+/**
+ * Node found by complete token of input,
+ * node is NULL if token wasn't found
+ */
+struct session_step {
+    const ImageNode* node;
+    uint64_t path;         // Hash of path to node
+    unsigned end;          // Offset of delimiter after token
+};
+typedef struct session_step SessionStep;
+
+/**
+ * Completion session for one input line,
+ * it remembers nodes of complete tokens, so
+ * only changed end of input is processed
+ */
+struct session {
+    Tree* tree;
+    const char* optional_brackets;
+    unsigned long revision;    // Revision of tree for steps
+    char* input;               // The previous input
+    unsigned length;
+    unsigned capacity;
+    SessionStep* steps;        // Stack of nodes by complete tokens
+    unsigned step_count;
+    unsigned step_capacity;
+    char buffer[TOKEN_TEXT_SIZE];  // Text of the last quoted token
+    Cache cache;               // The last found prediction lists
+    uint32_t brackets[TREE_BRACKET_WORDS];  // Bit set of brackets of session
+};
+typedef struct session Session;
+
+/**
+ * Function for creating completion session,
+ * tree and brackets must outlive session
+ *
+ * @param rules - Rules from config file
+ * @param optional_brackets - Characters which optional values begin
+ *
+ * @return Created session
+ */
+LIB Session* session_create(Tree* rules, const char* optional_brackets);
+
+/**
+ * Function for creating predictions like
+ * predictions_create, appending to input only
+ * refines the last token, erasing pops nodes
+ * of removed tokens
+ *
+ * @param session - Session of input line
+ * @param input - The entered string
+ *
+ * @return Predictions for current input
+ */
+LIB Predictions* session_predict(Session* session, const char* input);
+
+/**
+ * Function for finding predictions like
+ * session_predict without allocation of result,
+ * tokens are borrowed from the tree, predictions
+ * for the same node and last token are taken
+ * from cache of session
+ *
+ * @param session - Session of input line
+ * @param input - The entered string
+ * @param list - List for writing predictions
+ *
+ * @return Type of predictions
+ */
+LIB PredictType session_find(Session* session, const char* input, PredictionList* list);
+
+/**
+ * Function for deallocating session
+ *
+ * @param session - Session for deallocating
+ */
+LIB void session_free(Session* session);
+
+#endif //AUTOCOMPLETE_SESSION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Size of the first block of arena
+#define ARENA_FIRST_BLOCK_SIZE (64 * 1024)
+
+// Size after which blocks stop growing
+#define ARENA_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+// Space for pointer to previous block
+#define ARENA_BLOCK_HEADER ARENA_ALIGNMENT
+
+Arena* arena_create() {
+    // Allocate memory for self
+    Arena* arena = (Arena*)malloc(sizeof(Arena));
+    if (arena == NULL) {
+        fprintf(stderr, "[ERROR] Bad arena memory allocation\n");
+        exit(1);
+    }
+
+    // First block is allocated on demand
+    arena->block = NULL;
+    arena->used = 0;
+    arena->size = 0;
+
+    return arena;
+}
+
+void* arena_alloc(Arena* arena, size_t size, size_t alignment) {
+    size_t offset = (arena->used + alignment - 1) & ~(alignment - 1);
+
+    // Use new block if current block runs out
+    if (arena->block == NULL || offset + size > arena->size) {
+        size_t block_size = ARENA_FIRST_BLOCK_SIZE;
+        if (arena->size != 0) {
+            block_size = arena->size < ARENA_MAX_BLOCK_SIZE ? arena->size * 2 : arena->size;
+        }
+        if (size + ARENA_BLOCK_HEADER > block_size) {
+            block_size = size + ARENA_BLOCK_HEADER;
+        }
+
+        char* block = (char*)malloc(block_size);
+        if (block == NULL) {
+            fprintf(stderr, "[ERROR] Bad arena block memory allocation\n");
+            exit(1);
+        }
+
+        memcpy(block, &arena->block, sizeof(char*));
+        arena->block = block;
+        arena->size = block_size;
+        offset = ARENA_BLOCK_HEADER;
+    }
+
+    arena->used = offset + size;
+
+    return arena->block + offset;
+}
+
+void arena_merge(Arena* arena, Arena* other) {
+    if (other->block != NULL) {
+        // Find the first block of other arena
+        char* first = other->block;
+        char* prev;
+        memcpy(&prev, first, sizeof(char*));
+        while (prev != NULL) {
+            first = prev;
+            memcpy(&prev, first, sizeof(char*));
+        }
+
+        // Insert blocks of other arena before
+        // current block, which is still used
+        if (arena->block != NULL) {
+            memcpy(&prev, arena->block, sizeof(char*));
+            memcpy(first, &prev, sizeof(char*));
+            memcpy(arena->block, &other->block, sizeof(char*));
+        }
+        else {
+            arena->block = other->block;
+            arena->used = other->used;
+            arena->size = other->size;
+        }
+    }
+
+    // Free self of other arena
+    free(other);
+}
+
+void arena_free(Arena* arena) {
+    // Free all blocks from the last
+    while (arena->block != NULL) {
+        char* prev;
+        memcpy(&prev, arena->block, sizeof(char*));
+        free(arena->block);
+        arena->block = prev;
+    }
+
+    // Free self
+    free(arena);
+}
+
+char* custom_input(Tree* rules, char* title, COLOR_TYPE title_color, COLOR_TYPE predict_color,
+                   COLOR_TYPE main_color, char* optional_brackets) {
+    // Initialize buffer for reading
+    short buff_len = 0;
+    short buff_cap = terminal_width();
+    char* buff = (char*)calloc((size_t)buff_cap, sizeof(char));
+    if (buff == NULL) {
+        fprintf(stderr, "[ERROR] Couldn't allocate memory for buffer\n");
+        exit(1);
+    }
+
+    // Cursor offset in buffer for moving
+    int offset = 0;
+
+    // Current hint number
+    int hint_num = 0;
+
+    // Calculate title length
     int title_len = (short)strlen(title);
 
-    while (1) {
-        // Print title with title color
-        clear_line();
-        color_print(title, title_color);
-        printf(title_len != 0 ? " " : "");
+    // Session remembers nodes of entered tokens
+    Session* session = session_create(rules, optional_brackets);
+
+    // Predictions are borrowed from the tree, memory
+    // for them grows only if there are more predictions
+    unsigned views_cap = 16;
+    PredictionView* views = (PredictionView*)malloc(views_cap * sizeof(PredictionView));
+    if (views == NULL) {
+        fprintf(stderr, "[ERROR] Couldn't allocate memory for predictions\n");
+        exit(1);
+    }
+    PredictionList pred;
+    prediction_list_init(&pred, views, views_cap);
+
+    while (1) {
+        // Print title with title color
+        clear_line();
+        color_print(title, title_color);
+        printf(title_len != 0 ? " " : "");
+
+        // Get last word in input as it is typed,
+        // predictions are completed from it
+        Tokenizer tokenizer;
+        TokenSpan last;
+        tokenizer_init(&tokenizer, buff, (unsigned)buff_len, 0);
+        while (tokenizer_next(&tokenizer, &last)) {}
+
+        unsigned last_length = last.length;
+        short space_offset = (short)last.length;
+
+        // Print current buffer
+        color_print(buff, main_color);
+
+        // Get predictions, session caches them, so switching
+        // hints or redrawing doesn't find them again
+        session_find(session, buff, &pred);
+
+        // Grow memory and find again if not all predictions were written
+        if (pred.total > pred.capacity) {
+            views_cap = pred.total;
+            views = (PredictionView*)realloc(views, views_cap * sizeof(PredictionView));
+            if (views == NULL) {
+                fprintf(stderr, "[ERROR] Couldn't allocate memory for predictions\n");
+                exit(1);
+            }
+            prediction_list_init(&pred, views, views_cap);
+            session_find(session, buff, &pred);
+        }
+
+        // Print prediction by hint_num with color
+        if (pred.type != FAILURE) {
+            const char* prediction = pred.items[hint_num % pred.length].token;
+
+            // Print info message before prediction
+            // if prediction is probably
+            if (pred.type == PROBABLY) {
+                color_print("  maybe you mean: ", predict_color);
+            }
+
+            // Print trimmed or not trimmed prediction depending on the type
+            color_print((char*)prediction + (pred.type == EXACTLY) * last_length, predict_color);
+        }
+
+        // Move cursor to buffer end
+        short x = (short)(buff_len + title_len + (title_len != 0) + 1 - offset);
+        set_cursor_x(x);
+
+        // Read character from console
+        int ch = _getch();
+
+        // Wait next symbol if character in ignore keys
+        if (is_ignore_key(ch)) {
+            continue;
+        }
+
+        // Return buffer if ENTER was pressed
+        else if (ch == ENTER) {
+            break;
+        }
+
+        // Keyboard interrupt handler for Windows
+        #if defined(OS_WINDOWS)
+        else if (ch == CTRL_C) {
+            free(views);
+            session_free(session);
+            tree_free(rules);
+            free(buff);
+            exit(0);
+        }
+        #endif
+
+        // Edit buffer like backspace if BACKSPACE was pressed
+        else if (ch == BACKSPACE) {
+            if (buff_len != 0 && buff_len - offset >= 1) {
+                // Delete character from buffer
+                for (unsigned i = (unsigned int)(buff_len - offset - 1); i < buff_cap - 1; i++) {
+                    buff[i] = buff[i + 1];
+                }
+                buff_len -= 1;
+            }
+        }
+
+        // Apply prediction if TAB was pressed
+        else if (ch == TAB) {
+            if (pred.type != FAILURE) {
+                const char* prediction = pred.items[hint_num % pred.length].token;
+                unsigned predict_len = pred.items[hint_num % pred.length].length;
+
+                // Make sure the candidate has no optional brackets
+                if (!contain_chars(prediction, optional_brackets)) {
+
+                    // Handle buffer overflow
+                    if (buff_len + predict_len - space_offset >= buff_cap) {
+                        fprintf(stderr, "\n[ERROR] Input string more then terminal width\n");
+                        exit(1);
+                    }
+
+                    // Append prediction to buffer
+                    for (unsigned i = 0; i < predict_len; i++) {
+                        buff[buff_len - space_offset] = prediction[i];
+                        buff_len++;
+                    }
+
+                    // Fix buffer length
+                    buff_len = buff_len - space_offset;
+
+                    // Append end characters to buffer
+                    buff[buff_len++] = ' ';
+                    buff[buff_len] = '\0';
+                }
+            }
+        }
+
+        // Arrows and Delete keys handler
+        else if (
+            ch == SPECIAL_SEQ_1
+        #if defined(OS_WINDOWS)
+            || ch
+        #elif defined(OS_UNIX)
+            && _getch()
+        #endif
+           == SPECIAL_SEQ_2
+        ) {
+            switch (_getch()) {
+                case LEFT:
+                    // Increase offset from the end of the buffer if left key pressed
+                    offset = (offset < buff_len) ? (offset + 1) : buff_len;
+                    break;
+                case RIGHT:
+                    // Decrease offset from the end of the buffer if left key pressed
+                    offset = (offset > 0) ? offset - 1 : 0;
+                    break;
+                case UP:
+                    // Increase hint number
+                    hint_num = hint_num + 1;
+                    clear_line();
+                    break;
+                case DOWN:
+                    // Decrease hint number
+                    hint_num = hint_num - 1;
+                    clear_line();
+                    break;
+                case DEL:
+                    // Edit buffer like DELETE key
+                    #if defined(OS_UNIX)
+                    if (_getch() == DEL_AFTER)
+                    #endif
+                    {
+                        if (buff_len != 0 && offset != 0) {
+                            // Delete character from buffer
+                            for (unsigned i = (unsigned int)(buff_len - offset); i < buff_cap - 1; i++) {
+                                buff[i] = buff[i + 1];
+                            }
+                            buff_len -= 1;
+                            offset -= 1;
+                        }
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // Add character to buffer considering
+        // offset if any key was pressed
+        else {
+            hint_num = ch == SPACE ? 0 : hint_num;
+            buff[buff_len++] = (char)ch;
+        }
+    }
+
+    free(views);
+    session_free(session);
+
+    return buff;
+}
+
+char* input(Tree* rules) {
+    return custom_input(rules, "", DEFAULT_TITLE_COLOR, DEFAULT_PREDICT_COLOR,
+                        DEFAULT_MAIN_COLOR, "");
+}
+
+int is_ignore_key(int ch) {
+    int ignore_keys[] =
+    #if defined(OS_WINDOWS)
+        {1, 2, 19, 24, 26};
+    #elif defined(OS_UNIX)
+        {1, 2, 4, 24};
+    #endif
+
+    // Calculate length of ignore keys array
+    unsigned len = sizeof(ignore_keys) / sizeof(int);
+
+    // Check if character is ignore key
+    for (unsigned i = 0; i < len; i++) {
+        if (ch == ignore_keys[i]) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void cache_init(Cache* cache) {
+    for (unsigned i = 0; i < CACHE_SIZE; i++) {
+        cache->entries[i].items = NULL;
+        cache->entries[i].capacity = 0;
+        cache->entries[i].used = 0;
+    }
+    cache->clock = 0;
+}
+
+static int cache_match(const CacheEntry* entry, const CacheKey* key) {
+    return entry->used != 0 && entry->node == key->node && entry->path == key->path &&
+           entry->length == key->length && entry->revision == key->revision && entry->learned == key->learned &&
+           entry->distance == key->distance && memcmp(entry->prefix, key->prefix, key->length) == 0;
+}
+
+int cache_find(Cache* cache, const CacheKey* key, PredictionList* list) {
+    for (unsigned i = 0; i < CACHE_SIZE; i++) {
+        CacheEntry* entry = &cache->entries[i];
+        if (!cache_match(entry, key)) {
+            continue;
+        }
+
+        // The best predictions are the first of all
+        // predictions, so fewer of them are known
+        if (entry->count < entry->total && entry->count < list->capacity) {
+            return 0;
+        }
+
+        list->length = list->capacity < entry->count ? list->capacity : entry->count;
+        if (list->length > 0) {
+            memcpy(list->items, entry->items, sizeof(PredictionView) * list->length);
+        }
+        list->total = entry->total;
+        list->ranked = entry->ranked;
+        list->type = entry->type;
+
+        cache->clock += 1;
+        entry->used = cache->clock;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+void cache_store(Cache* cache, const CacheKey* key, const PredictionList* list) {
+    // Text of longer tokens isn't found
+    if (key->length >= TOKEN_TEXT_SIZE) {
+        return;
+    }
+
+    // Replace entry of the same key or
+    // the least recently used entry
+    CacheEntry* entry = &cache->entries[0];
+    for (unsigned i = 0; i < CACHE_SIZE; i++) {
+        if (cache_match(&cache->entries[i], key)) {
+            entry = &cache->entries[i];
+            break;
+        }
+        if (cache->entries[i].used < entry->used) {
+            entry = &cache->entries[i];
+        }
+    }
+
+    // Reallocate longer memory if capacity runs out
+    if (list->length > entry->capacity) {
+        entry->capacity = list->length;
+        entry->items = (PredictionView*)realloc(entry->items, sizeof(PredictionView) * entry->capacity);
+        if (entry->items == NULL) {
+            fprintf(stderr, "[ERROR] Bad cache memory reallocation\n");
+            exit(1);
+        }
+    }
+
+    entry->node = key->node;
+    entry->path = key->path;
+    entry->revision = key->revision;
+    entry->learned = key->learned;
+    entry->distance = key->distance;
+    memcpy(entry->prefix, key->prefix, key->length);
+    entry->length = key->length;
+
+    if (list->length > 0) {
+        memcpy(entry->items, list->items, sizeof(PredictionView) * list->length);
+    }
+    entry->count = list->length;
+    entry->total = list->total;
+    entry->ranked = list->ranked;
+    entry->type = list->type;
+
+    cache->clock += 1;
+    entry->used = cache->clock;
+}
+
+void cache_free(Cache* cache) {
+    // Free predictions of all entries
+    for (unsigned i = 0; i < CACHE_SIZE; i++) {
+        free(cache->entries[i].items);
+        cache->entries[i].items = NULL;
+        cache->entries[i].capacity = 0;
+        cache->entries[i].used = 0;
+    }
+}
+
+#include <string.h>
+
+/**
+ * Check if column of distance matrix after j characters
+ * of text has cell not greater than distance, otherwise
+ * longer prefixes of text never match, only cells near
+ * diagonal may be small enough, so cells are checked
+ * from the top of diagonal band
+ */
+static int fuzzy_alive(const Fuzzy* fuzzy, const FuzzyState* state, unsigned j) {
+    unsigned k = fuzzy->distance;
+    unsigned row = j > k ? j - k : 0;
+    unsigned last = j + k < fuzzy->length ? j + k : fuzzy->length;
+    unsigned cell = state->band;
+
+    if (row > fuzzy->length) {
+        return 0;
+    }
+
+    // Go down by vertical differences
+    while (cell > k && row < last) {
+        cell = cell + ((state->vp >> row) & 1) - ((state->vn >> row) & 1);
+        row += 1;
+    }
+
+    return cell <= k;
+}
+
+void fuzzy_init(Fuzzy* fuzzy, const char* pattern, unsigned length, unsigned distance) {
+    if (length > FUZZY_MAX_LENGTH) {
+        length = FUZZY_MAX_LENGTH;
+    }
+
+    // Set bits of pattern positions for each character
+    memset(fuzzy->peq, 0, sizeof(fuzzy->peq));
+    for (unsigned i = 0; i < length; i++) {
+        fuzzy->peq[(unsigned char)pattern[i]] |= (uint64_t)1 << i;
+    }
+
+    fuzzy->length = length;
+    fuzzy->distance = distance < FUZZY_MAX_DISTANCE ? distance : FUZZY_MAX_DISTANCE;
+    fuzzy->text = NULL;
+    fuzzy->depth = 0;
+    fuzzy->dead = 0;
+
+    // The first column is distance of pattern
+    // prefixes and empty text, it grows by one
+    FuzzyState* state = &fuzzy->states[0];
+    state->vp = ~(uint64_t)0;
+    state->vn = 0;
+    state->d0 = 0;
+    state->pm = 0;
+    state->score = length;
+    state->best = length;
+    state->band = 0;
+    state->alive = 1;
+}
+
+int fuzzy_match(Fuzzy* fuzzy, const char* text, unsigned length) {
+    // Longer prefixes of text are farther from pattern
+    unsigned limit = fuzzy->length + fuzzy->distance;
+    if (length < limit) {
+        limit = length;
+    }
+
+    // Reuse columns of prefix which is common with the previous text
+    unsigned j = 0;
+    while (j < fuzzy->depth && j < limit && fuzzy->text[j] == text[j]) {
+        j += 1;
+    }
+
+    uint64_t high = fuzzy->length > 0 ? (uint64_t)1 << (fuzzy->length - 1) : 0;
+    FuzzyState* state = &fuzzy->states[j];
+
+    while (state->best > fuzzy->distance && state->alive && j < limit) {
+        FuzzyState* next = state + 1;
+        uint64_t pm = fuzzy->peq[(unsigned char)text[j]];
+
+        // Diagonal is zero on match, by vertical difference
+        // or by transposition of this and previous characters
+        uint64_t tr = (((~state->d0) & pm) << 1) & state->pm;
+        uint64_t d0 = (((pm & state->vp) + state->vp) ^ state->vp) | pm | state->vn | tr;
+        uint64_t hp = state->vn | ~(d0 | state->vp);
+        uint64_t hn = state->vp & d0;
+
+        // Distance of the whole pattern is in the last row
+        next->score = state->score + ((hp & high) != 0) - ((hn & high) != 0);
+        next->best = next->score < state->best ? next->score : state->best;
+
+        // Row of empty pattern grows by one
+        hp = (hp << 1) | 1;
+        hn = hn << 1;
+        next->vp = hn | ~(d0 | hp);
+        next->vn = hp & d0;
+        next->d0 = d0;
+        next->pm = pm;
+
+        // Top of band moves by diagonal
+        // difference or stays in empty pattern row
+        if (j < fuzzy->distance) {
+            next->band = j + 1;
+        }
+        else {
+            unsigned row = j - fuzzy->distance;
+            next->band = state->band + (row >= fuzzy->length || !((d0 >> row) & 1));
+        }
+        next->alive = fuzzy_alive(fuzzy, next, j + 1);
+
+        state = next;
+        j += 1;
+    }
+
+    fuzzy->text = text;
+    fuzzy->depth = j;
+
+    if (state->best <= fuzzy->distance) {
+        fuzzy->dead = 0;
+        return 1;
+    }
+
+    // Prefixes longer than limit are not
+    // compared, so they never match too
+    fuzzy->dead = !state->alive || j == fuzzy->length + fuzzy->distance ? j : 0;
+    return 0;
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define IMAGE_SSE2
+    #include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+// AVX2 code is compiled for x86-64 and
+// used only if processor supports it
+#if defined(IMAGE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define IMAGE_AVX2
+    #define IMAGE_TARGET_AVX2 __attribute__((target("avx2")))
+    #include <immintrin.h>
+#elif defined(IMAGE_SSE2) && defined(_MSC_VER) && defined(_M_X64)
+    #define IMAGE_AVX2
+    #define IMAGE_TARGET_AVX2
+    #include <immintrin.h>
+#endif
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #define IMAGE_READ
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+/**
+ * Entry of map from token
+ * to offset in tokens blob
+ */
+struct image_token_entry {
+    const char* token;
+    unsigned length;
+    uint32_t offset;
+};
+typedef struct image_token_entry ImageTokenEntry;
+
+/**
+ * Offsets of image sections from the start of image
+ */
+struct image_layout {
+    size_t nodes;
+    size_t radix;
+    size_t roots;
+    size_t weights;
+    size_t keys;
+    size_t symbols;
+    size_t tokens;
+    size_t size;
+};
+typedef struct image_layout ImageLayout;
+
+/**
+ * Get offsets of sections by counts from header
+ */
+static ImageLayout image_layout(const ImageHeader* header) {
+    ImageLayout layout;
+
+    layout.nodes = sizeof(ImageHeader);
+    layout.radix = layout.nodes + sizeof(ImageNode) * (size_t)header->node_count;
+    layout.roots = layout.radix + sizeof(ImageRadix) * (size_t)header->radix_count;
+    layout.weights = layout.roots + sizeof(ImageRadixRoot) * (size_t)header->root_count;
+    layout.keys = layout.weights + sizeof(uint32_t) * (size_t)header->node_count;
+
+    // Keys are padded for reading by 16 bytes
+    layout.symbols = layout.keys + (((size_t)header->node_count + IMAGE_KEY_PADDING + 3) & ~(size_t)3);
+    layout.tokens = layout.symbols + (((size_t)header->node_count + 3) & ~(size_t)3);
+    layout.size = layout.tokens + header->token_size;
+
+    return layout;
+}
+
+/**
+ * Setup pointers to sections of image data
+ */
+static void image_setup(Image* image) {
+    ImageLayout layout = image_layout((const ImageHeader*)image->data);
+
+    image->header = (const ImageHeader*)image->data;
+    image->nodes = (const ImageNode*)((char*)image->data + layout.nodes);
+    image->radix = (const ImageRadix*)((char*)image->data + layout.radix);
+    image->roots = (const ImageRadixRoot*)((char*)image->data + layout.roots);
+    image->weights = (const uint32_t*)((char*)image->data + layout.weights);
+    image->keys = (const uint8_t*)image->data + layout.keys;
+    image->symbols = (const uint8_t*)image->data + layout.symbols;
+    image->tokens = (const char*)image->data + layout.tokens;
+}
+
+static uint32_t image_checksum(const void* data, size_t size) {
+    // FNV-1a hash function by 32-bit words,
+    // size of data is always aligned to 4 bytes
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < size; i += 4) {
+        uint32_t word;
+        memcpy(&word, bytes + i, 4);
+        hash = (hash ^ word) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32_t image_token_offset(ImageTokenEntry* entries, unsigned capacity, const char* token,
+                                   unsigned token_length, uint32_t* token_size, unsigned* length) {
+    // Tokens may come from several pools,
+    // so they are compared by content
+    unsigned i = pool_hash(token, token_length) & (capacity - 1);
+    while (entries[i].token != NULL) {
+        if (entries[i].token == token || (entries[i].length == token_length &&
+                                          memcmp(entries[i].token, token, token_length) == 0)) {
+            return entries[i].offset;
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+
+    // Reserve place in tokens blob
+    entries[i].token = token;
+    entries[i].length = token_length;
+    entries[i].offset = *token_size;
+    *token_size += token_length + 1;
+    *length += 1;
+
+    return entries[i].offset;
+}
+
+static int image_node_compare(const Node* a, const Node* b) {
+    unsigned length = a->token_length < b->token_length ? a->token_length : b->token_length;
+
+    int result = memcmp(a->token, b->token, length);
+    if (result != 0) {
+        return result;
+    }
+
+    return (int)a->token_length - (int)b->token_length;
+}
+
+/**
+ * Stable merge sort of nodes by tokens, equal
+ * tokens keep the order of config file
+ */
+static void image_sort_nodes(void** nodes, unsigned count, void** temp) {
+    if (count < 2) {
+        return;
+    }
+
+    unsigned middle = count / 2;
+    image_sort_nodes(nodes, middle, temp);
+    image_sort_nodes(nodes + middle, count - middle, temp);
+
+    // Merge sorted halves through temporary array
+    unsigned i = 0, j = middle, k = 0;
+    while (i < middle && j < count) {
+        if (image_node_compare((Node*)nodes[j], (Node*)nodes[i]) < 0) {
+            temp[k++] = nodes[j++];
+        }
+        else {
+            temp[k++] = nodes[i++];
+        }
+    }
+    while (i < middle) {
+        temp[k++] = nodes[i++];
+    }
+
+    memcpy(nodes, temp, sizeof(void*) * j);
+}
+
+/**
+ * Growable array of radix nodes and
+ * links to radix roots while building
+ */
+struct image_radix_list {
+    ImageRadix* radix;
+    uint32_t radix_count;
+    uint32_t radix_capacity;
+    ImageRadixRoot* roots;
+    uint32_t root_count;
+    uint32_t root_capacity;
+};
+typedef struct image_radix_list ImageRadixList;
+
+/**
+ * Reserve radix nodes at the end of list
+ *
+ * @return Index of the first reserved node
+ */
+static uint32_t image_radix_reserve(ImageRadixList* list, uint32_t count) {
+    if (list->radix_count + count > list->radix_capacity) {
+        while (list->radix_count + count > list->radix_capacity) {
+            list->radix_capacity = list->radix_capacity ? list->radix_capacity * 2 : 64;
+        }
+
+        list->radix = (ImageRadix*)realloc(list->radix, sizeof(ImageRadix) * list->radix_capacity);
+        if (list->radix == NULL) {
+            fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+            exit(1);
+        }
+    }
+
+    list->radix_count += count;
+    return list->radix_count - count;
+}
+
+/**
+ * Fill radix node covering sorted children
+ * which tokens have the same prefix of depth
+ *
+ * @param list - List of radix nodes
+ * @param index - Index of reserved radix node
+ * @param children - Sorted children of image node
+ * @param offsets - Offsets of tokens by image index
+ * @param base - Image index of the first child
+ * @param low - The first covered child
+ * @param high - Child after the last covered
+ * @param depth - Length of common prefix
+ */
+static void image_radix_fill(ImageRadixList* list, uint32_t index, void** children, const uint32_t* offsets,
+                             uint32_t base, uint32_t low, uint32_t high, unsigned depth) {
+    // Common prefix of sorted tokens is
+    // the prefix of the first and the last
+    Node* a = (Node*)children[low];
+    Node* b = (Node*)children[high - 1];
+    unsigned min_length = a->token_length < b->token_length ? a->token_length : b->token_length;
+
+    unsigned end = depth;
+    while (end < min_length && a->token[end] == b->token[end]) {
+        end++;
+    }
+
+    // Tokens equal to prefix go first and
+    // others are grouped by next byte
+    uint32_t i = low;
+    while (i < high && ((Node*)children[i])->token_length == end) {
+        i++;
+    }
+
+    uint32_t groups = 0;
+    for (uint32_t j = i; j < high; groups++) {
+        char key = ((Node*)children[j])->token[end];
+        while (j < high && ((Node*)children[j])->token[end] == key) {
+            j++;
+        }
+    }
+
+    uint32_t first = image_radix_reserve(list, groups);
+
+    ImageRadix* radix = &list->radix[index];
+    radix->label = offsets[base + low] + depth;
+    radix->label_length = end - depth;
+    radix->children = first;
+    radix->child_count = groups;
+    radix->first = base + low;
+    radix->count = high - low;
+
+    // Fill groups after reserving them
+    // all, so they are placed together
+    for (uint32_t g = 0; g < groups; g++) {
+        uint32_t j = i;
+        char key = ((Node*)children[j])->token[end];
+        while (j < high && ((Node*)children[j])->token[end] == key) {
+            j++;
+        }
+
+        image_radix_fill(list, first + g, children, offsets, base, i, j, end);
+        i = j;
+    }
+}
+
+/**
+ * Build radix indexes over children of nodes
+ * which are not small, nodes sharing children
+ * share radix index too
+ */
+static void image_radix_build(ImageRadixList* list, Vector* order, const uint32_t* children,
+                              const uint32_t* offsets) {
+    // Radix roots by index of the first child
+    uint32_t* built = (uint32_t*)malloc(sizeof(uint32_t) * order->length);
+    if (built == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+    memset(built, 0xff, sizeof(uint32_t) * order->length);
+
+    for (unsigned i = 0; i < order->length; i++) {
+        Node* n = (Node*)vector_get(order, i);
+
+        if (n->children.length > IMAGE_SMALL_NODE) {
+            if (list->root_count == list->root_capacity) {
+                list->root_capacity = list->root_capacity ? list->root_capacity * 2 : 16;
+                list->roots = (ImageRadixRoot*)realloc(list->roots, sizeof(ImageRadixRoot) * list->root_capacity);
+                if (list->roots == NULL) {
+                    fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+                    exit(1);
+                }
+            }
+
+            uint32_t root = built[children[i]];
+            if (root == UINT32_MAX) {
+                root = image_radix_reserve(list, 1);
+                built[children[i]] = root;
+                image_radix_fill(list, root, order->data + children[i], offsets, children[i],
+                                 0, n->children.length, 0);
+            }
+
+            list->roots[list->root_count].node = i;
+            list->roots[list->root_count].radix = root;
+            list->root_count++;
+        }
+    }
+
+    free(built);
+}
+
+/**
+ * Table for hash consing, entries are
+ * indexes of nodes in queue plus one
+ */
+struct image_cons {
+    uint32_t* entries;
+    uint32_t* hashes;
+    unsigned capacity;
+};
+typedef struct image_cons ImageCons;
+
+/**
+ * Identifiers of subtrees while
+ * deduplicating tree in queue
+ */
+struct image_subtrees {
+    Vector* queue;
+    const uint32_t* starts;  // Index of the first child in queue
+    uint32_t* ids;           // Identifier of subtree by node
+    uint32_t* lists;         // Identifier of children by node, zero if none
+};
+typedef struct image_subtrees ImageSubtrees;
+
+static uint32_t image_list_hash(const ImageSubtrees* subtrees, uint32_t i) {
+    Node* n = (Node*)vector_get(subtrees->queue, i);
+    uint32_t hash = 2166136261u;
+
+    for (unsigned j = 0; j < n->children.length; j++) {
+        hash = (hash ^ subtrees->ids[subtrees->starts[i] + j]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static int image_list_equal(const ImageSubtrees* subtrees, uint32_t a, uint32_t b) {
+    Node* x = (Node*)vector_get(subtrees->queue, a);
+    Node* y = (Node*)vector_get(subtrees->queue, b);
+    if (x->children.length != y->children.length) {
+        return 0;
+    }
+
+    return memcmp(subtrees->ids + subtrees->starts[a], subtrees->ids + subtrees->starts[b],
+                  sizeof(uint32_t) * x->children.length) == 0;
+}
+
+static int image_subtree_equal(const ImageSubtrees* subtrees, uint32_t a, uint32_t b) {
+    Node* x = (Node*)vector_get(subtrees->queue, a);
+    Node* y = (Node*)vector_get(subtrees->queue, b);
+
+    return subtrees->lists[a] == subtrees->lists[b] && x->weight == y->weight && x->token_length == y->token_length &&
+           memcmp(x->token, y->token, x->token_length) == 0;
+}
+
+/**
+ * Find equal entry in table or insert node
+ *
+ * @return Index of node in queue with equal entry
+ */
+static uint32_t image_cons_find(ImageCons* cons, const ImageSubtrees* subtrees, uint32_t i, uint32_t hash,
+                                int (*equal)(const ImageSubtrees*, uint32_t, uint32_t)) {
+    unsigned k = hash & (cons->capacity - 1);
+
+    while (cons->entries[k] != 0) {
+        if (cons->hashes[k] == hash && equal(subtrees, cons->entries[k] - 1, i)) {
+            return cons->entries[k] - 1;
+        }
+        k = (k + 1) & (cons->capacity - 1);
+    }
+
+    cons->entries[k] = i + 1;
+    cons->hashes[k] = hash;
+
+    return i;
+}
+
+/**
+ * Give equal identifiers to structurally
+ * equal subtrees and to equal lists of
+ * children, nodes are processed from leaves
+ */
+static void image_subtrees_build(ImageSubtrees* subtrees) {
+    unsigned length = subtrees->queue->length;
+
+    ImageCons lists, nodes;
+    lists.capacity = nodes.capacity = 64;
+    while (lists.capacity < length * 2) {
+        lists.capacity *= 2;
+    }
+    nodes.capacity = lists.capacity;
+
+    lists.entries = (uint32_t*)calloc(lists.capacity, sizeof(uint32_t));
+    lists.hashes = (uint32_t*)malloc(sizeof(uint32_t) * lists.capacity);
+    nodes.entries = (uint32_t*)calloc(nodes.capacity, sizeof(uint32_t));
+    nodes.hashes = (uint32_t*)malloc(sizeof(uint32_t) * nodes.capacity);
+    if (lists.entries == NULL || lists.hashes == NULL || nodes.entries == NULL || nodes.hashes == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    // Children follow parents in breadth-first
+    // order, so they get identifiers before them
+    uint32_t next_list = 1;
+    for (unsigned i = length; i-- > 0;) {
+        Node* n = (Node*)vector_get(subtrees->queue, i);
+
+        if (n->children.length == 0) {
+            subtrees->lists[i] = 0;
+        }
+        else {
+            uint32_t same = image_cons_find(&lists, subtrees, i, image_list_hash(subtrees, i), image_list_equal);
+            subtrees->lists[i] = same == i ? next_list++ : subtrees->lists[same];
+        }
+
+        uint32_t hash = pool_hash(n->token, n->token_length) ^ (subtrees->lists[i] * 2654435761u) ^ n->weight;
+        subtrees->ids[i] = image_cons_find(&nodes, subtrees, i, hash, image_subtree_equal);
+    }
+
+    free(lists.entries);
+    free(lists.hashes);
+    free(nodes.entries);
+    free(nodes.hashes);
+}
+
+Image* image_create(Node* head) {
+    // Queue of all nodes in breadth-first order,
+    // children of each node follow one another
+    Vector* queue = vector_create(1);
+    vector_push(queue, head);
+
+    // Temporary array for sorting children
+    Vector* temp = vector_create(1);
+
+    for (unsigned i = 0; i < queue->length; i++) {
+        Node* n = (Node*)vector_get(queue, i);
+        unsigned first = queue->length;
+
+        Node** children = node_list_data(&n->children);
+        for (unsigned j = 0; j < n->children.length; j++) {
+            vector_push(queue, children[j]);
+        }
+        while (temp->length < n->children.length) {
+            vector_push(temp, NULL);
+        }
+
+        // Children are sorted for binary search
+        image_sort_nodes(queue->data + first, n->children.length, temp->data);
+    }
+    vector_free(temp);
+
+    // Index of the first child of each node in queue
+    uint32_t* starts = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    uint32_t* ids = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    uint32_t* lists = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    uint32_t* placed = (uint32_t*)malloc(sizeof(uint32_t) * (queue->length + 1));
+    uint32_t* sources = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    uint32_t* children = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    if (starts == NULL || ids == NULL || lists == NULL || placed == NULL || sources == NULL || children == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    uint32_t next_child = 1;
+    for (unsigned i = 0; i < queue->length; i++) {
+        starts[i] = next_child;
+        next_child += ((Node*)vector_get(queue, i))->children.length;
+    }
+
+    // Equal subtrees have equal lists of
+    // children, each list is placed once
+    ImageSubtrees subtrees;
+    subtrees.queue = queue;
+    subtrees.starts = starts;
+    subtrees.ids = ids;
+    subtrees.lists = lists;
+    image_subtrees_build(&subtrees);
+
+    memset(placed, 0xff, sizeof(uint32_t) * (queue->length + 1));
+    sources[0] = 0;
+    uint32_t count = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        Node* n = (Node*)vector_get(queue, sources[i]);
+        uint32_t list_id = lists[sources[i]];
+
+        if (n->children.length == 0) {
+            children[i] = count;
+        }
+        else {
+            if (placed[list_id] == UINT32_MAX) {
+                placed[list_id] = count;
+                for (unsigned j = 0; j < n->children.length; j++) {
+                    sources[count++] = starts[sources[i]] + j;
+                }
+            }
+            children[i] = placed[list_id];
+        }
+    }
+
+    // Nodes of image in placement order
+    Vector* order = vector_create(1);
+    for (uint32_t i = 0; i < count; i++) {
+        vector_push(order, vector_get(queue, sources[i]));
+    }
+
+    free(starts);
+    free(ids);
+    free(lists);
+    free(placed);
+    free(sources);
+    vector_free(queue);
+
+    // Table of distinct tokens, not more
+    // than count of nodes with load factor 0.5
+    unsigned capacity = 64;
+    while (capacity < order->length * 2) {
+        capacity *= 2;
+    }
+
+    ImageTokenEntry* entries = (ImageTokenEntry*)calloc(capacity, sizeof(ImageTokenEntry));
+    uint32_t* offsets = (uint32_t*)malloc(sizeof(uint32_t) * order->length);
+    if (entries == NULL || offsets == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    // Get offsets of tokens in blob
+    uint32_t token_size = 0;
+    unsigned token_count = 0;
+    for (unsigned i = 0; i < order->length; i++) {
+        Node* n = (Node*)vector_get(order, i);
+        offsets[i] = image_token_offset(entries, capacity, n->token, n->token_length, &token_size, &token_count);
+    }
+    token_size = (token_size + 3) & ~3u;
+
+    // Build radix indexes, labels are
+    // parts of tokens in tokens blob
+    ImageRadixList list;
+    memset(&list, 0, sizeof(ImageRadixList));
+    image_radix_build(&list, order, children, offsets);
+
+    // Allocate image data at once
+    ImageHeader counts;
+    counts.node_count = order->length;
+    counts.token_size = token_size;
+    counts.radix_count = list.radix_count;
+    counts.root_count = list.root_count;
+    ImageLayout layout = image_layout(&counts);
+    size_t size = layout.size;
+
+    Image* image = (Image*)malloc(sizeof(Image));
+    char* data = (char*)calloc(size, 1);
+    if (image == NULL || data == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    ImageHeader* header = (ImageHeader*)data;
+    ImageNode* nodes = (ImageNode*)(data + layout.nodes);
+    uint32_t* weights = (uint32_t*)(data + layout.weights);
+    uint8_t* keys = (uint8_t*)data + layout.keys;
+    uint8_t* symbols = (uint8_t*)data + layout.symbols;
+    char* tokens = data + layout.tokens;
+
+    if (list.radix_count > 0) {
+        memcpy(data + layout.radix, list.radix, sizeof(ImageRadix) * list.radix_count);
+        memcpy(data + layout.roots, list.roots, sizeof(ImageRadixRoot) * list.root_count);
+    }
+
+    // Fill nodes, equal lists of
+    // children are shared by parents
+    uint32_t weighted = 0;
+    for (unsigned i = 0; i < order->length; i++) {
+        Node* n = (Node*)vector_get(order, i);
+
+        nodes[i].token = offsets[i];
+        nodes[i].token_length = n->token_length;
+        nodes[i].children = children[i];
+        nodes[i].child_count = n->children.length;
+        weights[i] = n->weight;
+        weighted |= n->weight != 0;
+        keys[i] = (uint8_t)n->token[0];
+        symbols[i] = image_symbols(n->token, n->token_length);
+        memcpy(nodes[i].inline_token, n->token,
+               n->token_length < IMAGE_INLINE_SIZE ? n->token_length : IMAGE_INLINE_SIZE);
+
+        memcpy(tokens + offsets[i], n->token, n->token_length + 1);
+    }
+
+    // Fill header
+    memcpy(header->magic, IMAGE_MAGIC, 4);
+    header->version = IMAGE_VERSION;
+    header->byte_order = IMAGE_BYTE_ORDER;
+    header->node_count = order->length;
+    header->token_size = token_size;
+    header->radix_count = list.radix_count;
+    header->root_count = list.root_count;
+    header->weighted = weighted;
+    header->checksum = image_checksum(data + sizeof(ImageHeader), size - sizeof(ImageHeader));
+
+    image->data = data;
+    image->size = size;
+    image->mapped = 0;
+    image_setup(image);
+
+    // Remove temporary variables
+    vector_free(order);
+    free(children);
+    free(entries);
+    free(offsets);
+    free(list.radix);
+    free(list.roots);
+
+    return image;
+}
+
+/**
+ * Check that inline bytes of node are
+ * the first bytes of token padded by zeros
+ */
+static int image_inline_valid(const ImageNode* node, const char* token) {
+    for (unsigned i = 0; i < IMAGE_INLINE_SIZE; i++) {
+        char expected = i < node->token_length ? token[i] : '\0';
+        if (node->inline_token[i] != expected) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Check that image data is correct
+ *
+ * @return Zero on success or not zero with printed error
+ */
+static int image_check(const char* data, size_t size, const char* filepath) {
+    const ImageHeader* header = (const ImageHeader*)data;
+
+    if (size < sizeof(ImageHeader) || memcmp(header->magic, IMAGE_MAGIC, 4) != 0) {
+        fprintf(stderr, "[ERROR] %s is not a compiled rules file\n", filepath);
+        return 1;
+    }
+
+    if (header->byte_order != IMAGE_BYTE_ORDER) {
+        fprintf(stderr, "[ERROR] %s was compiled for another byte order\n", filepath);
+        return 1;
+    }
+
+    if (header->version != IMAGE_VERSION) {
+        fprintf(stderr, "[ERROR] %s has version %u, but version %u is required\n",
+                filepath, header->version, IMAGE_VERSION);
+        return 1;
+    }
+
+    ImageLayout layout = image_layout(header);
+    if (header->node_count == 0 || header->token_size % 4 != 0 || size != layout.size) {
+        fprintf(stderr, "[ERROR] %s has incorrect size\n", filepath);
+        return 1;
+    }
+
+    if (header->checksum != image_checksum(data + sizeof(ImageHeader), size - sizeof(ImageHeader))) {
+        fprintf(stderr, "[ERROR] %s has incorrect checksum\n", filepath);
+        return 1;
+    }
+
+    // Links must not point outside of image
+    const ImageNode* nodes = (const ImageNode*)(data + layout.nodes);
+    const uint8_t* keys = (const uint8_t*)data + layout.keys;
+    const char* tokens = data + layout.tokens;
+    for (uint32_t i = 0; i < header->node_count; i++) {
+        const ImageNode* n = &nodes[i];
+        if ((uint64_t)n->children + n->child_count > header->node_count ||
+            (uint64_t)n->token + n->token_length >= header->token_size ||
+            tokens[n->token + n->token_length] != '\0' || keys[i] != (uint8_t)tokens[n->token] ||
+            !image_inline_valid(n, tokens + n->token)) {
+            fprintf(stderr, "[ERROR] %s has incorrect node %u\n", filepath, i);
+            return 1;
+        }
+    }
+
+    // Radix children follow their parents,
+    // so walking of index always stops
+    const ImageRadix* radix = (const ImageRadix*)(data + layout.radix);
+    for (uint32_t i = 0; i < header->radix_count; i++) {
+        const ImageRadix* r = &radix[i];
+        if ((r->child_count > 0 && r->children <= i) ||
+            (uint64_t)r->children + r->child_count > header->radix_count ||
+            (uint64_t)r->first + r->count > header->node_count ||
+            (uint64_t)r->label + r->label_length >= header->token_size) {
+            fprintf(stderr, "[ERROR] %s has incorrect radix node %u\n", filepath, i);
+            return 1;
+        }
+    }
+
+    const ImageRadixRoot* roots = (const ImageRadixRoot*)(data + layout.roots);
+    for (uint32_t i = 0; i < header->root_count; i++) {
+        if (roots[i].node >= header->node_count || roots[i].radix >= header->radix_count ||
+            (i > 0 && roots[i].node <= roots[i - 1].node)) {
+            fprintf(stderr, "[ERROR] %s has incorrect radix root %u\n", filepath, i);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+Image* image_load(const char* filepath) {
+    char* data;
+    size_t size;
+
+#if defined(IMAGE_READ)
+    // Read whole file to memory
+    FILE* file = fopen(filepath, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data = (char*)malloc(size + 1);
+    if (data == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    if (fread(data, 1, size, file) != size) {
+        fprintf(stderr, "[ERROR] Can't read file %s\n", filepath);
+        fclose(file);
+        free(data);
+        return NULL;
+    }
+    fclose(file);
+#else
+    // Map file to memory without reading
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "[ERROR] %s is not a compiled rules file\n", filepath);
+        close(fd);
+        return NULL;
+    }
+    size = (size_t)st.st_size;
+
+    data = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == (char*)MAP_FAILED) {
+        fprintf(stderr, "[ERROR] Can't map file %s\n", filepath);
+        return NULL;
+    }
+#endif
+
+    Image* image = (Image*)malloc(sizeof(Image));
+    if (image == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+    image->data = data;
+    image->size = size;
+#if defined(IMAGE_READ)
+    image->mapped = 0;
+#else
+    image->mapped = 1;
+#endif
+
+    if (image_check(data, size, filepath)) {
+        image_free(image);
+        return NULL;
+    }
+
+    image_setup(image);
+
+    return image;
+}
+
+int image_save(const Image* image, const char* filepath) {
+    FILE* file = fopen(filepath, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return 1;
+    }
+
+    // Write image data as is
+    if (fwrite(image->data, 1, image->size, file) != image->size) {
+        fprintf(stderr, "[ERROR] Can't write file %s\n", filepath);
+        fclose(file);
+        return 1;
+    }
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "[ERROR] Can't write file %s\n", filepath);
+        return 1;
+    }
+
+    return 0;
+}
+
+const char* image_token(const Image* image, const ImageNode* node) {
+    return image->tokens + node->token;
+}
+
+uint8_t image_symbols(const char* bytes, unsigned length) {
+    // Letters and digits make up most of tokens, so
+    // only other bytes are classified by low bits
+    uint8_t symbols = 0;
+    for (unsigned i = 0; i < length; i++) {
+        unsigned char byte = (unsigned char)bytes[i];
+        if ((byte | 0x20) >= 'a' && (byte | 0x20) <= 'z') {
+            continue;
+        }
+        if (byte >= '0' && byte <= '9') {
+            continue;
+        }
+        symbols |= (uint8_t)(1u << (byte % 8));
+    }
+
+    return symbols;
+}
+
+/**
+ * Compare the first bytes of token of image
+ * node with string, short tokens are compared
+ * only by inline bytes of node record
+ */
+static int image_token_bytes(const Image* image, const ImageNode* node, const char* str, unsigned length) {
+    if (length <= IMAGE_INLINE_SIZE) {
+        return memcmp(node->inline_token, str, length);
+    }
+
+    int result = memcmp(node->inline_token, str, IMAGE_INLINE_SIZE);
+    if (result != 0) {
+        return result;
+    }
+
+    return memcmp(image->tokens + node->token + IMAGE_INLINE_SIZE, str + IMAGE_INLINE_SIZE,
+                  length - IMAGE_INLINE_SIZE);
+}
+
+/**
+ * Compare token of image node with string
+ * by bytes, like strcmp for null terminated
+ */
+static int image_token_compare(const Image* image, const ImageNode* node, const char* str, unsigned length) {
+    unsigned min_length = node->token_length < length ? node->token_length : length;
+
+    int result = image_token_bytes(image, node, str, min_length);
+    if (result != 0) {
+        return result;
+    }
+
+    return (int)node->token_length - (int)length;
+}
+
+#if defined(IMAGE_SSE2)
+/**
+ * Get index of the lowest set bit, value is not zero
+ */
+static unsigned image_ctz(unsigned value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(value);
+#endif
+}
+#endif
+
+/**
+ * Get children of small node which tokens start
+ * with key byte, they are stored one after another
+ *
+ * @return Count of found children
+ */
+static uint32_t image_key_range(const Image* image, const ImageNode* node, uint8_t key, uint32_t* first) {
+    const uint8_t* keys = image->keys + node->children;
+    uint32_t count = node->child_count;
+
+#if defined(IMAGE_SSE2)
+    // Compare all keys at once, keys are
+    // padded so reading past the end is safe
+    __m128i chunk = _mm_loadu_si128((const __m128i*)keys);
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8((char)key)));
+    mask &= (1u << count) - 1;
+    if (mask == 0) {
+        *first = node->children;
+        return 0;
+    }
+
+    // Matched keys are contiguous in sorted children
+    unsigned shift = image_ctz(mask);
+    *first = node->children + shift;
+    return image_ctz(~(mask >> shift));
+#else
+    uint32_t i = 0;
+    while (i < count && keys[i] < key) {
+        i++;
+    }
+
+    uint32_t j = i;
+    while (j < count && keys[j] == key) {
+        j++;
+    }
+
+    *first = node->children + i;
+    return j - i;
+#endif
+}
+
+/**
+ * Get children of small node which tokens
+ * may be equal to string or start with it
+ *
+ * @return Count of found children
+ */
+static uint32_t image_candidates(const Image* image, const ImageNode* node, const char* str,
+                                 unsigned length, uint32_t* first) {
+    // Empty string matches all children
+    if (length == 0 || node->child_count > IMAGE_SMALL_NODE) {
+        *first = node->children;
+        return node->child_count;
+    }
+
+    return image_key_range(image, node, (uint8_t)str[0], first);
+}
+
+/**
+ * Get root of radix index of node
+ *
+ * @return Radix node or NULL for small node
+ */
+static const ImageRadix* image_radix_root(const Image* image, const ImageNode* node) {
+    if (node->child_count <= IMAGE_SMALL_NODE) {
+        return NULL;
+    }
+
+    // Links are sorted by image nodes
+    uint32_t index = (uint32_t)(node - image->nodes);
+    uint32_t low = 0, high = image->header->root_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (image->roots[middle].node < index) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    if (low < image->header->root_count && image->roots[low].node == index) {
+        return &image->radix[image->roots[low].radix];
+    }
+
+    return NULL;
+}
+
+/**
+ * Walk radix index by string, each byte
+ * of string is compared only once
+ *
+ * @return Count of children starting with string
+ */
+static uint32_t image_radix_range(const Image* image, const ImageNode* node, const ImageRadix* radix,
+                                  const char* str, unsigned length, uint32_t* first) {
+    unsigned position = 0;
+
+    for (;;) {
+        // Label must match rest of string
+        unsigned rest = length - position;
+        unsigned compared = radix->label_length < rest ? radix->label_length : rest;
+        if (memcmp(image->tokens + radix->label, str + position, compared) != 0) {
+            break;
+        }
+
+        position += compared;
+        if (position == length) {
+            *first = radix->first;
+            return radix->count;
+        }
+
+        // Radix child is found by next byte
+        uint8_t key = (uint8_t)str[position];
+        uint32_t low = radix->children, high = radix->children + radix->child_count;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if ((uint8_t)image->tokens[image->radix[middle].label] < key) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+
+        if (low == radix->children + radix->child_count ||
+            (uint8_t)image->tokens[image->radix[low].label] != key) {
+            break;
+        }
+        radix = &image->radix[low];
+    }
+
+    *first = node->children;
+    return 0;
+}
+
+/**
+ * Get index of the first of children
+ * which token is not less than string
+ */
+static uint32_t image_lower_bound(const Image* image, uint32_t first, uint32_t count,
+                                  const char* str, unsigned length) {
+    while (count > 0) {
+        uint32_t step = count / 2;
+
+        if (image_token_compare(image, &image->nodes[first + step], str, length) < 0) {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+const ImageNode* image_find_child(const Image* image, const ImageNode* node, const char* token, unsigned length) {
+    uint32_t first;
+    const ImageRadix* radix = image_radix_root(image, node);
+
+    // Equal token is the shortest of
+    // found tokens, so it goes first
+    if (radix != NULL) {
+        uint32_t count = image_radix_range(image, node, radix, token, length, &first);
+        if (count > 0 && image->nodes[first].token_length == length) {
+            return &image->nodes[first];
+        }
+        return NULL;
+    }
+
+    uint32_t count = image_candidates(image, node, token, length, &first);
+    uint32_t i = image_lower_bound(image, first, count, token, length);
+
+    // The first of equal tokens is found
+    if (i < first + count && image_token_compare(image, &image->nodes[i], token, length) == 0) {
+        return &image->nodes[i];
+    }
+
+    return NULL;
+}
+
+#if defined(IMAGE_SSE2)
+/**
+ * Get mask of 16-bit fields which have all
+ * bits set, four fields are checked at once
+ */
+static uint32_t image_full_fields(uint64_t fields) {
+    uint64_t low = 0x7fff7fff7fff7fffull;
+    uint64_t zeros = ~fields;
+
+    // Top bit of field is set only if field of zeros is zero
+    uint64_t tops = ~(((zeros & low) + low) | zeros | low);
+
+    // Gather top bits of fields to the lowest four bits
+    return (uint32_t)(((tops >> 15) * 0x0000200040008001ull) >> 45) & 0xf;
+}
+
+/**
+ * Compare inline token of one node,
+ * bytes after prefix are ignored
+ */
+static uint32_t image_prefix_test(const ImageNode* node, __m128i pattern, __m128i ignored) {
+    __m128i token = _mm_loadu_si128((const __m128i*)node->inline_token);
+    __m128i equal = _mm_or_si128(_mm_cmpeq_epi8(token, pattern), ignored);
+
+    return _mm_movemask_epi8(equal) == 0xffff;
+}
+#endif
+
+#if defined(IMAGE_AVX2)
+/**
+ * Check once if processor and
+ * system support AVX2 registers
+ */
+static int image_has_avx2(void) {
+    // Threads may check it at once, they
+    // store the same value atomically
+    static volatile long supported = -1;
+
+    long result = atomic_load_long(&supported);
+    if (result < 0) {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        int os_saves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        result = os_saves && (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        result = __builtin_cpu_supports("avx2") != 0;
+#endif
+        atomic_store_long(&supported, result);
+    }
+
+    return (int)result;
+}
+
+/**
+ * Compare inline tokens of four nodes per step,
+ * record of node takes 32 bytes and its inline
+ * token is the upper half, so halves of two
+ * records are joined in one register
+ */
+IMAGE_TARGET_AVX2
+static uint32_t image_prefix_mask_avx2(const ImageNode* nodes, unsigned count, __m128i pattern,
+                                       __m128i ignored) {
+    __m256i wide_pattern = _mm256_broadcastsi128_si256(pattern);
+    __m256i wide_ignored = _mm256_broadcastsi128_si256(ignored);
+    uint32_t mask = 0;
+    unsigned i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)&nodes[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i*)&nodes[i + 1]);
+        __m256i c = _mm256_loadu_si256((const __m256i*)&nodes[i + 2]);
+        __m256i d = _mm256_loadu_si256((const __m256i*)&nodes[i + 3]);
+
+        __m256i first = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_permute2x128_si256(a, b, 0x31), wide_pattern),
+                                        wide_ignored);
+        __m256i second = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_permute2x128_si256(c, d, 0x31), wide_pattern),
+                                         wide_ignored);
+
+        uint64_t fields = (uint32_t)_mm256_movemask_epi8(first) |
+                          (uint64_t)(uint32_t)_mm256_movemask_epi8(second) << 32;
+        mask |= image_full_fields(fields) << i;
+    }
+
+    for (; i < count; i++) {
+        mask |= image_prefix_test(&nodes[i], pattern, ignored) << i;
+    }
+
+    return mask;
+}
+#endif
+
+uint32_t image_prefix_mask(const Image* image, uint32_t first, unsigned count, const char* prefix,
+                           unsigned length) {
+    const ImageNode* nodes = image->nodes + first;
+    uint32_t mask = 0;
+
+    if (count > IMAGE_MASK_SIZE) {
+        count = IMAGE_MASK_SIZE;
+    }
+
+    // Inline bytes are padded by zeros and prefix
+    // has no zeros, so shorter tokens don't match
+    if (length <= IMAGE_INLINE_SIZE) {
+#if defined(IMAGE_SSE2)
+        // Bytes after prefix are ignored by
+        // setting them in comparison result
+        static const uint8_t ignored_bytes[2 * IMAGE_INLINE_SIZE] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+        };
+        char bytes[IMAGE_INLINE_SIZE] = {0};
+        for (unsigned i = 0; i < length; i++) {
+            bytes[i] = prefix[i];
+        }
+
+        __m128i pattern = _mm_loadu_si128((const __m128i*)bytes);
+        __m128i ignored = _mm_loadu_si128((const __m128i*)(ignored_bytes + IMAGE_INLINE_SIZE - length));
+
+#if defined(IMAGE_AVX2)
+        if (image_has_avx2()) {
+            return image_prefix_mask_avx2(nodes, count, pattern, ignored);
+        }
+#endif
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint64_t fields = 0;
+            for (unsigned j = 0; j < 4; j++) {
+                __m128i token = _mm_loadu_si128((const __m128i*)nodes[i + j].inline_token);
+                __m128i equal = _mm_or_si128(_mm_cmpeq_epi8(token, pattern), ignored);
+                fields |= (uint64_t)(unsigned)_mm_movemask_epi8(equal) << (16 * j);
+            }
+            mask |= image_full_fields(fields) << i;
+        }
+
+        for (; i < count; i++) {
+            mask |= image_prefix_test(&nodes[i], pattern, ignored) << i;
+        }
+#else
+        for (unsigned i = 0; i < count; i++) {
+            mask |= (uint32_t)(memcmp(nodes[i].inline_token, prefix, length) == 0) << i;
+        }
+#endif
+        return mask;
+    }
+
+    // Longer prefixes are compared with tokens blob
+    for (unsigned i = 0; i < count; i++) {
+        if (nodes[i].token_length >= length && image_token_bytes(image, &nodes[i], prefix, length) == 0) {
+            mask |= (uint32_t)1 << i;
+        }
+    }
+
+    return mask;
+}
+
+unsigned image_prefix_range(const Image* image, const ImageNode* node, const char* prefix,
+                            unsigned length, uint32_t* first) {
+    const ImageRadix* radix = image_radix_root(image, node);
+    if (radix != NULL) {
+        return image_radix_range(image, node, radix, prefix, length, first);
+    }
+
+    uint32_t begin;
+    uint32_t end = image_candidates(image, node, prefix, length, &begin);
+    end += begin;
+
+    // Tokens starting with prefix are not less than prefix
+    *first = image_lower_bound(image, begin, end - begin, prefix, length);
+
+    // And they are followed by tokens
+    // greater than all extensions of prefix
+    uint32_t last = *first;
+    uint32_t count = end - last;
+
+    while (count > 0) {
+        uint32_t step = count / 2;
+        const ImageNode* child = &image->nodes[last + step];
+
+        if (child->token_length >= length && image_token_bytes(image, child, prefix, length) == 0) {
+            last += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    return last - *first;
+}
+
+void image_free(Image* image) {
+    // Unmap or free image data
+#if !defined(IMAGE_READ)
+    if (image->mapped) {
+        munmap(image->data, image->size);
+    }
+    else
+#endif
+    {
+        free(image->data);
+    }
+
+    free(image);
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Node* node_create(Arena* arena, const char* token, unsigned token_length) {
+    Node* n;
+
+    // Allocate memory for node
+    if (arena != NULL) {
+        n = (Node*)arena_alloc(arena, sizeof(Node), sizeof(void*));
+    }
+    else {
+        n = (Node*)malloc(sizeof(Node));
+        if (n == NULL) {
+            fprintf(stderr, "[ERROR] Bad node vector memory allocation\n");
+            exit(1);
+        }
+    }
+
+    // Setup fields of node, token
+    // is borrowed and not copied
+    n->token = token;
+    n->token_length = token_length;
+    n->weight = 0;
+
+    // The first children are placed inside of node,
+    // others in the same memory as node
+    n->heap = arena == NULL;
+    node_list_init(&n->children);
+
+    return n;
+}
+
+void node_free(Node* n) {
+    // Nodes in arena are freed with arena
+    if (!n->heap) {
+        return;
+    }
+
+    // Free all child nodes
+    Node** children = node_list_data(&n->children);
+    for (unsigned i = 0; i < n->children.length; i++) {
+        node_free(children[i]);
+    }
+
+    // Free memory for children and self
+    node_list_free(&n->children);
+    free(n);
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+unsigned pool_hash(const char* str, unsigned length) {
+    // FNV-1a hash function
+    unsigned hash = 2166136261u;
+    for (unsigned i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void pool_grow(Pool* pool) {
+    unsigned capacity = pool->capacity * 2;
+
+    PoolEntry* entries = (PoolEntry*)calloc(capacity, sizeof(PoolEntry));
+    if (entries == NULL) {
+        fprintf(stderr, "[ERROR] Bad pool memory allocation\n");
+        exit(1);
+    }
+
+    // Move entries to the new table
+    for (unsigned i = 0; i < pool->capacity; i++) {
+        PoolEntry* entry = &pool->entries[i];
+        if (entry->str == NULL) {
+            continue;
+        }
+
+        unsigned j = entry->hash & (capacity - 1);
+        while (entries[j].str != NULL) {
+            j = (j + 1) & (capacity - 1);
+        }
+        entries[j] = *entry;
+    }
+
+    free(pool->entries);
+    pool->entries = entries;
+    pool->capacity = capacity;
+}
+
+Pool* pool_create(Arena* arena) {
+    // Allocate memory for self
+    Pool* pool = (Pool*)malloc(sizeof(Pool));
+    if (pool == NULL) {
+        fprintf(stderr, "[ERROR] Bad pool memory allocation\n");
+        exit(1);
+    }
+
+    pool->arena = arena;
+    pool->length = 0;
+    pool->capacity = 64;
+
+    pool->entries = (PoolEntry*)calloc(pool->capacity, sizeof(PoolEntry));
+    if (pool->entries == NULL) {
+        fprintf(stderr, "[ERROR] Bad pool memory allocation\n");
+        exit(1);
+    }
+
+    return pool;
+}
+
+const char* pool_intern(Pool* pool, const char* str, unsigned length) {
+    unsigned hash = pool_hash(str, length);
+
+    // Find string or free slot in the table
+    unsigned i = hash & (pool->capacity - 1);
+    while (pool->entries[i].str != NULL) {
+        PoolEntry* entry = &pool->entries[i];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->str, str, length) == 0) {
+            return entry->str;
+        }
+        i = (i + 1) & (pool->capacity - 1);
+    }
+
+    // Copy string to the pool
+    char* copy = (char*)arena_alloc(pool->arena, length + 1, 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+
+    pool->entries[i].str = copy;
+    pool->entries[i].length = length;
+    pool->entries[i].hash = hash;
+
+    // Keep load factor under 0.5
+    if (++pool->length * 2 > pool->capacity) {
+        pool_grow(pool);
+    }
+
+    return copy;
+}
+
+void pool_free(Pool* pool) {
+    // Free table and self
+    free(pool->entries);
+    free(pool);
+}
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+// Count of inputs taken by batch thread at once
+#define PREDICTIONS_BATCH_CHUNK 64
+
+/**
+ * Inputs of batch shared by threads,
+ * threads take chunks of them by counter
+ */
+struct predictions_batch {
+    Query query;           // Query on head of tree
+    uint8_t* flags;        // Flags of nodes by brackets of batch or NULL
+    uint32_t brackets[TREE_BRACKET_WORDS];
+    char** inputs;
+    char* optional_brackets;
+    Predictions** results;
+    unsigned count;
+    volatile long next;    // Index of the first not taken input
+};
+typedef struct predictions_batch PredictionsBatch;
+
+char* token_create(const char* str, unsigned str_len) {
+    // Allocate memory for token
+    char* token = (char*)malloc(sizeof(char) * str_len + 1);
+    if (token == NULL) {
+        fprintf(stderr, "[ERROR] Bad token memory allocation\n");
+        exit(0);
+    }
+
+    // Paste data to token
+    memcpy(token, str, str_len);
+    token[str_len] = '\0';
+
+    // Return token
+    return token;
+}
+
+Tokens* split(char *str, char delimiter) {
+    // Create token vector
+    Tokens* vec = vector_create(1);
+
+    char prev_char = delimiter;
+
+    // Finding tokens and placing them in an array
+    for (unsigned i = 0; str[i] != '\0'; i++) {
+
+        // Skip spaces while token not found
+        if (prev_char == delimiter && str[i] != delimiter) {
+            // Get length of current token
+            unsigned token_length = 0;
+
+            while (str[i + token_length] != delimiter && str[i + token_length] != '\0') {
+                token_length += 1;
+            }
+
+            // Add token to vector
+            vector_push(vec, token_create(str + i, token_length));
+
+            // Move string cursor right
+            i += token_length - 1;
+        }
+
+        // Remember prev character
+        prev_char = str[i];
+    }
+
+    // Add empty string to vector if detected delimiter in the end
+    if (prev_char == delimiter) {
+        char* token = token_create("", 1);
+        vector_push(vec, token);
+    }
+
+    // Return token vector
+    return vec;
+}
+
+/**
+ * Function for receiving found predictions
+ */
+typedef void (*PredictionEmit)(void* context, const char* token, unsigned length, unsigned weight);
+
+/**
+ * Find the last of sorted completions which start with
+ * prefix like completion by index, the nearest of them
+ * are compared at once by leading bytes of tokens and
+ * the rest by exponential and then binary search
+ *
+ * @return Index of the last completion with prefix
+ */
+static unsigned predictions_skip(const Query* query, unsigned index, unsigned count, const char* prefix,
+                                 unsigned length) {
+    // Usually the next completion has other prefix
+    if (index + 1 == count || strncmp(query_token(query, index + 1, NULL), prefix, length) != 0) {
+        return index;
+    }
+
+    // Or only a few completions share it
+    uint32_t mask = image_prefix_mask(query->image, query->first + index, count - index, prefix, length);
+    if (~mask != 0) {
+        unsigned run = 0;
+        while (mask & 1) {
+            mask >>= 1;
+            run += 1;
+        }
+        return index + run - 1;
+    }
+
+    unsigned last = index + IMAGE_MASK_SIZE - 1;
+    unsigned step = 1;
+
+    // Find bound of completions with prefix
+    while (last + step < count && strncmp(query_token(query, last + step, NULL), prefix, length) == 0) {
+        last += step;
+        step *= 2;
+    }
+
+    unsigned bound = last + step < count ? last + step : count;
+    while (last + 1 < bound) {
+        unsigned middle = last + (bound - last) / 2;
+
+        if (strncmp(query_token(query, middle, NULL), prefix, length) == 0) {
+            last = middle;
+        }
+        else {
+            bound = middle;
+        }
+    }
+
+    return last;
+}
+
+/**
+ * Check if flags of query nodes were
+ * set by the same optional brackets
+ */
+static int predictions_classified(const Query* query, const char* optional_brackets) {
+    if (query->flags == NULL) {
+        return 0;
+    }
+
+    uint32_t mask[TREE_BRACKET_WORDS];
+    tree_brackets_mask(optional_brackets, mask);
+
+    return memcmp(mask, query->brackets, sizeof(mask)) == 0;
+}
+
+/**
+ * Find children of query node which start with
+ * last token or probably children if there are
+ * no such children, tokens are borrowed
+ *
+ * @return Type of predictions
+ */
+static PredictType predictions_scan(Query* query, const char* last_token, unsigned length,
+                                    const char* optional_brackets, unsigned distance,
+                                    PredictionEmit emit, void* context) {
+    unsigned count = query_complete(query, last_token, length);
+
+    // Set EXACTLY type for predictions if words was found
+    if (count > 0) {
+        for (unsigned i = 0; i < count; i++) {
+            unsigned token_length;
+            const char* probably_token = query_token(query, i, &token_length);
+            emit(context, probably_token, token_length, query_weight(query, i));
+        }
+
+        return EXACTLY;
+    }
+
+    // Search probably words without optional
+    // brackets if words wasn't found
+    count = query_complete(query, "", 0);
+    unsigned found = 0;
+
+    // Tokens are usually classified by brackets at once,
+    // other brackets are searched only in tokens which
+    // have symbols of the same classes
+    int classified = predictions_classified(query, optional_brackets);
+    uint8_t symbols = image_symbols(optional_brackets, (unsigned)strlen(optional_brackets));
+
+    // Sorted children share prefixes, so
+    // matcher reuses their columns
+    Fuzzy fuzzy;
+    fuzzy_init(&fuzzy, last_token, length, distance);
+
+    for (unsigned i = 0; i < count; i++) {
+        unsigned token_length;
+        const char *probably_token = query_token(query, i, &token_length);
+
+        // Adding a word to predictions if its prefix is
+        // near to last token and it has no symbols for
+        // optional values
+        if (fuzzy_match(&fuzzy, probably_token, token_length)) {
+            int optional = classified ? query_optional(query, i)
+                                      : query_symbolic(query, i, symbols) &&
+                                            contain_chars(probably_token, optional_brackets);
+            if (!optional) {
+                emit(context, probably_token, token_length, query_weight(query, i));
+                found += 1;
+            }
+        }
+        // Skip children with the same hopeless prefix
+        else if (fuzzy.dead > 0) {
+            i = predictions_skip(query, i, count, probably_token, fuzzy.dead);
+        }
+    }
+
+    // Set type depending on the success of the search
+    return found > 0 ? PROBABLY : FAILURE;
+}
+
+static void predictions_emit_copy(void* context, const char* token, unsigned length, unsigned weight) {
+    (void)weight;
+    vector_push((Tokens*)context, token_create(token, length));
+}
+
+/**
+ * Check if prediction is ranked lower than other,
+ * predictions with equal weights keep order of tokens
+ */
+static int prediction_worse(const PredictionView* a, const PredictionView* b) {
+    if (a->weight != b->weight) {
+        return a->weight < b->weight;
+    }
+
+    return strcmp(a->token, b->token) > 0;
+}
+
+/**
+ * Restore heap with the worst prediction on top
+ * after item was replaced by better prediction
+ */
+static void prediction_sift_down(PredictionView* items, unsigned length, unsigned i) {
+    PredictionView item = items[i];
+
+    while (2 * i + 1 < length) {
+        unsigned child = 2 * i + 1;
+        if (child + 1 < length && prediction_worse(&items[child + 1], &items[child])) {
+            child += 1;
+        }
+
+        if (!prediction_worse(&items[child], &item)) {
+            break;
+        }
+        items[i] = items[child];
+        i = child;
+    }
+
+    items[i] = item;
+}
+
+/**
+ * Restore heap with the worst prediction on top
+ * after prediction was appended to the end
+ */
+static void prediction_sift_up(PredictionView* items, unsigned i) {
+    PredictionView item = items[i];
+
+    while (i > 0 && prediction_worse(&item, &items[(i - 1) / 2])) {
+        items[i] = items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+
+    items[i] = item;
+}
+
+static void predictions_emit_view(void* context, const char* token, unsigned length, unsigned weight) {
+    PredictionList* list = (PredictionList*)context;
+    list->total += 1;
+
+    PredictionView item;
+    item.token = token;
+    item.length = length;
+    item.weight = weight;
+
+    // Predictions come in order of tokens, so
+    // without weights the first of them are the best
+    if (list->length < list->capacity) {
+        list->items[list->length] = item;
+        list->length += 1;
+
+        if (list->ranked) {
+            prediction_sift_up(list->items, list->length - 1);
+        }
+    }
+    // Replace the worst of kept predictions
+    else if (list->ranked && list->length > 0 && prediction_worse(&list->items[0], &item)) {
+        list->items[0] = item;
+        prediction_sift_down(list->items, list->length, 0);
+    }
+}
+
+void predictions_fill(Predictions* pred, Query* query, const char* last_token, unsigned length,
+                      const char* optional_brackets) {
+    // Predictions are already in order of tokens
+    if (!query_ranked(query)) {
+        pred->type = predictions_scan(query, last_token, length, optional_brackets, PREDICTIONS_DISTANCE,
+                                      predictions_emit_copy, pred->tokens);
+        return;
+    }
+
+    // Count predictions, then sort all of them by weights
+    PredictionList list;
+    prediction_list_init(&list, NULL, 0);
+    prediction_list_fill(&list, query, last_token, length, optional_brackets);
+
+    PredictionView* items = (PredictionView*)malloc(sizeof(PredictionView) * (list.total + 1));
+    if (items == NULL) {
+        fprintf(stderr, "[ERROR] Bad prediction memory allocation\n");
+        exit(1);
+    }
+    prediction_list_init(&list, items, list.total);
+    prediction_list_fill(&list, query, last_token, length, optional_brackets);
+
+    for (unsigned i = 0; i < list.length; i++) {
+        vector_push(pred->tokens, token_create(items[i].token, items[i].length));
+    }
+    pred->type = list.type;
+
+    free(items);
+}
+
+void prediction_list_init(PredictionList* list, PredictionView* items, unsigned capacity) {
+    list->type = FAILURE;
+    list->items = items;
+    list->capacity = capacity;
+    list->length = 0;
+    list->total = 0;
+    list->ranked = 0;
+    list->distance = PREDICTIONS_DISTANCE;
+}
+
+void prediction_list_fill(PredictionList* list, Query* query, const char* last_token, unsigned length,
+                          const char* optional_brackets) {
+    list->length = 0;
+    list->total = 0;
+    list->ranked = query_ranked(query);
+    list->type = predictions_scan(query, last_token, length, optional_brackets, list->distance,
+                                  predictions_emit_view, list);
+
+    // Sort heap, the worst predictions
+    // are moved from top to the end
+    if (list->ranked) {
+        for (unsigned end = list->length; end-- > 1;) {
+            PredictionView worst = list->items[0];
+            list->items[0] = list->items[end];
+            list->items[end] = worst;
+            prediction_sift_down(list->items, end, 0);
+        }
+    }
+}
+
+/**
+ * Find node of the last complete token of input,
+ * tokens are not copied from input
+ *
+ * @param query - Query for setting on found node
+ * @param input - The entered string
+ * @param optional_brackets - Characters which optional values begin
+ * @param buffer - Memory for text of quoted tokens
+ * @param last_token - Pointer for the last token in input
+ * @param last_length - Pointer for length of the last token
+ *
+ * @return 1 if predictions can be found, 0 otherwise
+ */
+static int predictions_walk(Query* query, const char* input, const char* optional_brackets, char* buffer,
+                            const char** last_token, unsigned* last_length) {
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, input, (unsigned)strlen(input), 0);
+
+    // Finding node in tree by input tokens
+    TokenSpan span;
+    while (tokenizer_next(&tokenizer, &span)) {
+        // If further search makes no sense
+        if (!query_descend_span(query, input, &span, buffer)) {
+            return 0;
+        }
+    }
+
+    // The last token is completed as it is typed, so
+    // predictions continue its quotes and escapes
+    *last_token = input + span.offset;
+    *last_length = span.length;
+
+    // Don't show predictions if last word contains optional brackets
+
+    return predictions_classified(query, optional_brackets) ? !query_bracketed(query, *last_token, *last_length)
+                                                            : !contain_chars(*last_token, optional_brackets);
+}
+
+PredictType predictions_find(Tree* rules, const char* input, const char* optional_brackets,
+                             PredictionList* list) {
+    list->type = FAILURE;
+    list->length = 0;
+    list->total = 0;
+
+    // Query starts from head of compiled tree
+    Query query;
+    query_init(&query, rules);
+
+    char buffer[TOKEN_TEXT_SIZE];
+    const char* last_token;
+    unsigned last_length;
+    if (predictions_walk(&query, input, optional_brackets, buffer, &last_token, &last_length)) {
+        prediction_list_fill(list, &query, last_token, last_length, optional_brackets);
+    }
+
+    return list->type;
+}
+
+PredictionScratch* prediction_scratch_create(unsigned capacity) {
+    // Scratch and its predictions take whole cache lines
+    size_t size = sizeof(PredictionScratch) + sizeof(PredictionView) * capacity;
+    size = (size + PREDICTIONS_CACHE_LINE - 1) / PREDICTIONS_CACHE_LINE * PREDICTIONS_CACHE_LINE;
+
+    char* memory = (char*)malloc(size + PREDICTIONS_CACHE_LINE);
+    if (memory == NULL) {
+        return NULL;
+    }
+
+    // Align scratch to the next cache line
+    size_t shift = PREDICTIONS_CACHE_LINE - (size_t)((uintptr_t)memory % PREDICTIONS_CACHE_LINE);
+    PredictionScratch* scratch = (PredictionScratch*)(memory + shift);
+    scratch->memory = memory;
+    prediction_list_init(&scratch->list, (PredictionView*)(scratch + 1), capacity);
+
+    return scratch;
+}
+
+int predictions_search(const Tree* rules, const char* input, const char* optional_brackets,
+                       PredictionScratch* scratch) {
+    PredictionList* list = &scratch->list;
+    list->type = FAILURE;
+    list->length = 0;
+    list->total = 0;
+
+    // Tree is only read, so it must be compiled before
+    Query query;
+    if (query_start(&query, rules) != 0) {
+        return 1;
+    }
+
+    const char* last_token;
+    unsigned last_length;
+    if (predictions_walk(&query, input, optional_brackets, scratch->buffer, &last_token, &last_length)) {
+        prediction_list_fill(list, &query, last_token, last_length, optional_brackets);
+    }
+
+    return 0;
+}
+
+void prediction_scratch_free(PredictionScratch* scratch) {
+    free(scratch->memory);
+}
+
+/**
+ * Create predictions from query on head of tree,
+ * tree is only read, so threads may share query
+ *
+ * @param start - Query on head of tree
+ * @param input - The entered string
+ * @param optional_brackets - Characters which optional values begin
+ *
+ * @return Predictions for current input
+ */
+static Predictions* predictions_query(const Query* start, const char* input, const char* optional_brackets) {
+    // Initialize result predictions
+    Predictions* pred = (Predictions*)malloc(sizeof(Predictions));
+    if (pred == NULL) {
+        fprintf(stderr, "[ERROR] Bad prediction memory allocation\n");
+        exit(0);
+    }
+    pred->type = FAILURE;
+    pred->tokens = vector_create(1);
+
+    // Search words starts with last token
+    Query query = *start;
+    char buffer[TOKEN_TEXT_SIZE];
+    const char* last_token;
+    unsigned last_length;
+    if (predictions_walk(&query, input, optional_brackets, buffer, &last_token, &last_length)) {
+        predictions_fill(pred, &query, last_token, last_length, optional_brackets);
+    }
+
+    // Return result
+    return pred;
+}
+
+Predictions *predictions_create(Tree *rules, char *input, char *optional_brackets) {
+    // Query starts from head of compiled tree
+    Query query;
+    query_init(&query, rules);
+
+    return predictions_query(&query, input, optional_brackets);
+}
+
+static void predictions_batch_work(void* arg) {
+    PredictionsBatch* batch = (PredictionsBatch*)arg;
+
+    while (1) {
+        long start = atomic_add_long(&batch->next, PREDICTIONS_BATCH_CHUNK);
+        if (start >= (long)batch->count) {
+            break;
+        }
+
+        unsigned end = (unsigned)start + PREDICTIONS_BATCH_CHUNK;
+        if (end > batch->count) {
+            end = batch->count;
+        }
+
+        for (unsigned i = (unsigned)start; i < end; i++) {
+            batch->results[i] = predictions_query(&batch->query, batch->inputs[i], batch->optional_brackets);
+        }
+    }
+}
+
+void predictions_create_batch(Tree* rules, char** inputs, unsigned count, char* optional_brackets,
+                              Predictions** results, unsigned threads) {
+    // Compile tree once, then threads only read it
+    PredictionsBatch batch;
+    query_init(&batch.query, rules);
+    batch.flags = NULL;
+
+    // Tokens are classified for batch if
+    // tree was classified by other brackets
+    if (optional_brackets[0] != '\0' && !predictions_classified(&batch.query, optional_brackets)) {
+        batch.flags = (uint8_t*)malloc(batch.query.image->header->node_count + 1);
+        if (batch.flags == NULL) {
+            fprintf(stderr, "[ERROR] Bad flags memory allocation\n");
+            exit(1);
+        }
+
+        tree_brackets_mask(optional_brackets, batch.brackets);
+        tree_classify(batch.query.image, batch.brackets, batch.flags);
+        batch.query.flags = batch.flags;
+        batch.query.brackets = batch.brackets;
+    }
+
+    batch.inputs = inputs;
+    batch.optional_brackets = optional_brackets;
+    batch.results = results;
+    batch.count = count;
+    batch.next = 0;
+
+    // Threads without inputs are not started
+    unsigned chunks = (count + PREDICTIONS_BATCH_CHUNK - 1) / PREDICTIONS_BATCH_CHUNK;
+    threads = MAX_OF(threads < chunks ? threads : chunks, 1);
+
+    Thread* handles = (Thread*)malloc(sizeof(Thread) * threads);
+    if (handles == NULL) {
+        fprintf(stderr, "[ERROR] Bad threads memory allocation\n");
+        exit(1);
+    }
+
+    // Current thread takes inputs too, so it
+    // finishes the batch if threads can't start
+    unsigned started = 1;
+    while (started < threads && thread_create(&handles[started], predictions_batch_work, &batch) == 0) {
+        started += 1;
+    }
+    predictions_batch_work(&batch);
+    for (unsigned i = 1; i < started; i++) {
+        thread_join(handles[i]);
+    }
+
+    free(handles);
+    free(batch.flags);
+}
+
+void predictions_free(Predictions* predict) {
+    // Free all tokens
+    tokens_free(predict->tokens);
+
+    // Free self
+    free(predict);
+}
+
+void tokens_free(Tokens* tokens) {
+    // Free all input tokens vector
+    for (unsigned i = 0; i < tokens->length; i++) {
+        free(vector_get(tokens, i));
+    }
+
+    // Free self
+    vector_free(tokens);
+}
+
+int contain_chars(const char* str, const char* chars) {
+    // Checking for given characters in a string
+    for (unsigned i = 0; str[i] != '\0'; i++) {
+        for (unsigned j = 0; chars[j] != '\0'; j++) {
+            if (str[i] == chars[j]) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void query_init(Query* query, Tree* tree) {
+    // Compile tree if it was changed
+    tree_finalize(tree);
+    query_start(query, tree);
+}
+
+int query_start(Query* query, const Tree* tree) {
+    if (tree->image == NULL) {
+        return 1;
+    }
+
+    query->image = tree->image;
+    query->usage = tree->usage;
+    query->usage_capacity = tree->usage_capacity;
+    query->flags = tree->flags;
+    query->brackets = tree->brackets;
+    query->node = &tree->image->nodes[0];
+    query->path = TREE_PATH_HEAD;
+    query->first = query->node->children;
+    query->count = 0;
+
+    return 0;
+}
+
+int query_descend(Query* query, const char* token, unsigned length) {
+    const ImageNode* next_node = image_find_child(query->image, query->node, token, length);
+
+    // Query stays on current node
+    // if child wasn't found
+    if (next_node == NULL) {
+        return 0;
+    }
+
+    query->node = next_node;
+    query->path = tree_path(query->path, (uint32_t)(next_node - query->image->nodes));
+    query->first = next_node->children;
+    query->count = 0;
+
+    return 1;
+}
+
+int query_descend_span(Query* query, const char* input, const TokenSpan* span, char* buffer) {
+    if (query_descend(query, input + span->offset, span->length)) {
+        return 1;
+    }
+
+    // Plain token has no other text
+    if (!(span->flags & TOKEN_QUOTED)) {
+        return 0;
+    }
+
+    unsigned length;
+    const char* text = token_text(input, span, buffer, &length);
+
+    return text != NULL && query_descend(query, text, length);
+}
+
+unsigned query_complete(Query* query, const char* prefix, unsigned length) {
+    query->count = image_prefix_range(query->image, query->node, prefix, length, &query->first);
+
+    return query->count;
+}
+
+const char* query_token(const Query* query, unsigned index, unsigned* length) {
+    const ImageNode* node = &query->image->nodes[query->first + index];
+
+    if (length != NULL) {
+        *length = node->token_length;
+    }
+
+    return image_token(query->image, node);
+}
+
+uint32_t query_weight(const Query* query, unsigned index) {
+    uint32_t node = query->first + index;
+
+    // Usage is counted by path, since
+    // equal subtrees share nodes
+    return query->image->weights[node] +
+           tree_usage_count(query->usage, query->usage_capacity, tree_path(query->path, node));
+}
+
+int query_ranked(const Query* query) {
+    return query->image->header->weighted || query->usage != NULL;
+}
+
+int query_optional(const Query* query, unsigned index) {
+    return (query->flags[query->first + index] & TREE_NODE_OPTIONAL) != 0;
+}
+
+int query_symbolic(const Query* query, unsigned index, uint8_t symbols) {
+    return (query->image->symbols[query->first + index] & symbols) != 0;
+}
+
+int query_bracketed(const Query* query, const char* token, unsigned length) {
+    for (unsigned i = 0; i < length; i++) {
+        unsigned char byte = (unsigned char)token[i];
+        if (query->brackets[byte / 32] & (1u << (byte % 32))) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+    #define RULES_INOTIFY
+
+    #include <poll.h>
+    #include <unistd.h>
+    #include <sys/inotify.h>
+#endif
+
+// Period of checking for changes and stop flag
+#define RULES_WATCH_PERIOD 200
+
+#if defined(RULES_INOTIFY)
+
+static void rules_watch(void* arg) {
+    Rules* rules = (Rules*)arg;
+
+    // Editors often replace file by renaming,
+    // so watch directory of configuration file
+    char* dir = (char*)malloc(strlen(rules->filepath) + 2);
+    if (dir == NULL) {
+        fprintf(stderr, "[ERROR] Bad rules memory allocation\n");
+        exit(1);
+    }
+
+    const char* base = strrchr(rules->filepath, '/');
+    if (base == NULL) {
+        strcpy(dir, ".");
+        base = rules->filepath;
+    }
+    else {
+        // Keep root slash for files in root directory
+        size_t dir_length = MAX_OF((size_t)(base - rules->filepath), 1);
+        memcpy(dir, rules->filepath, dir_length);
+        dir[dir_length] = '\0';
+        base += 1;
+    }
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "[ERROR] Can't watch file %s\n", rules->filepath);
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(dir);
+        return;
+    }
+
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!atomic_load_long(&rules->stop)) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, RULES_WATCH_PERIOD) <= 0) {
+            continue;
+        }
+
+        // Check if any event is related to configuration file
+        int changed = 0;
+        ssize_t length;
+        while ((length = read(fd, events, sizeof(events))) > 0) {
+            for (char* ptr = events; ptr < events + length;) {
+                struct inotify_event* event = (struct inotify_event*)ptr;
+                if (event->len > 0 && strcmp(event->name, base) == 0) {
+                    changed = 1;
+                }
+                ptr += sizeof(struct inotify_event) + event->len;
+            }
+        }
+
+        if (changed) {
+            rules_reload(rules);
+        }
+    }
+
+    close(fd);
+    free(dir);
+}
+
+#else
+
+static void rules_watch(void* arg) {
+    Rules* rules = (Rules*)arg;
+
+    // Poll modification time and size of file
+    struct stat last;
+    if (stat(rules->filepath, &last) != 0) {
+        memset(&last, 0, sizeof(last));
+    }
+
+    while (!atomic_load_long(&rules->stop)) {
+        thread_sleep(RULES_WATCH_PERIOD);
+
+        struct stat curr;
+        if (stat(rules->filepath, &curr) != 0) {
+            continue;
+        }
+
+        if (curr.st_mtime != last.st_mtime || curr.st_size != last.st_size) {
+            last = curr;
+            rules_reload(rules);
+        }
+    }
+}
+
+#endif
+
+Rules* rules_create(const char* filepath) {
+    // Allocate memory for self
+    Rules* rules = (Rules*)malloc(sizeof(Rules));
+    if (rules == NULL) {
+        fprintf(stderr, "[ERROR] Bad rules memory allocation\n");
+        exit(1);
+    }
+
+    rules->filepath = (char*)malloc(strlen(filepath) + 1);
+    if (rules->filepath == NULL) {
+        fprintf(stderr, "[ERROR] Bad rules memory allocation\n");
+        exit(1);
+    }
+    strcpy(rules->filepath, filepath);
+
+    // The first tree must be correct
+    rules->current = tree_create(filepath);
+    rules->epoch = 0;
+    rules->readers[0] = 0;
+    rules->readers[1] = 0;
+    rules->stop = 0;
+    mutex_init(&rules->reload_lock);
+
+    // Start watching for changes
+    rules->watching = thread_create(&rules->watcher, rules_watch, rules) == 0;
+    if (!rules->watching) {
+        fprintf(stderr, "[ERROR] Can't start watching file %s\n", filepath);
+    }
+
+    return rules;
+}
+
+RulesSnapshot rules_acquire(Rules* rules) {
+    RulesSnapshot snapshot;
+
+    // Register reader in current epoch, retry
+    // if epoch was changed during registration
+    while (1) {
+        long epoch = atomic_load_long(&rules->epoch);
+        atomic_add_long(&rules->readers[epoch & 1], 1);
+
+        if (atomic_load_long(&rules->epoch) == epoch) {
+            snapshot.epoch = epoch;
+            break;
+        }
+
+        atomic_add_long(&rules->readers[epoch & 1], -1);
+    }
+
+    snapshot.tree = (Tree*)atomic_load_ptr((void* volatile*)&rules->current);
+
+    return snapshot;
+}
+
+void rules_release(Rules* rules, RulesSnapshot snapshot) {
+    atomic_add_long(&rules->readers[snapshot.epoch & 1], -1);
+}
+
+int rules_reload(Rules* rules) {
+    // Build new tree without blocking readers,
+    // keep old tree if file is incorrect
+    Tree* tree = tree_try_create(rules->filepath);
+    if (tree == NULL) {
+        return 1;
+    }
+
+    mutex_lock(&rules->reload_lock);
+
+    // Publish new tree and start new epoch
+    Tree* old = (Tree*)atomic_exchange_ptr((void* volatile*)&rules->current, tree);
+    long epoch = atomic_load_long(&rules->epoch);
+    atomic_store_long(&rules->epoch, epoch + 1);
+
+    // Only readers of previous epoch can use old tree
+    while (atomic_load_long(&rules->readers[epoch & 1]) != 0) {
+        thread_sleep(1);
+    }
+
+    mutex_unlock(&rules->reload_lock);
+
+    tree_free(old);
+
+    return 0;
+}
+
+void rules_free(Rules* rules) {
+    // Stop watching
+    if (rules->watching) {
+        atomic_store_long(&rules->stop, 1);
+        thread_join(rules->watcher);
+    }
+
+    // Free current tree and self
+    tree_free(rules->current);
+    mutex_free(&rules->reload_lock);
+    free(rules->filepath);
+    free(rules);
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Session* session_create(Tree* rules, const char* optional_brackets) {
+    // Allocate memory for self
+    Session* session = (Session*)malloc(sizeof(Session));
+    if (session == NULL) {
+        fprintf(stderr, "[ERROR] Bad session memory allocation\n");
+        exit(1);
+    }
+
+    session->tree = rules;
+    session->optional_brackets = optional_brackets;
+    session->revision = 0;
+    session->input = NULL;
+    session->length = 0;
+    session->capacity = 0;
+    session->steps = NULL;
+    session->step_count = 0;
+    session->step_capacity = 0;
+    cache_init(&session->cache);
+    tree_brackets_mask(optional_brackets, session->brackets);
+
+    return session;
+}
+
+static void session_push(Session* session, const ImageNode* node, uint64_t path, unsigned end) {
+    // Reallocate longer memory if capacity runs out
+    if (session->step_count == session->step_capacity) {
+        session->step_capacity = (session->step_capacity + 1) * 2;
+        session->steps = (SessionStep*)realloc(session->steps, sizeof(SessionStep) * session->step_capacity);
+        if (session->steps == NULL) {
+            fprintf(stderr, "[ERROR] Bad session memory reallocation\n");
+            exit(1);
+        }
+    }
+
+    session->steps[session->step_count].node = node;
+    session->steps[session->step_count].path = path;
+    session->steps[session->step_count].end = end;
+    session->step_count += 1;
+}
+
+static void session_remember(Session* session, const char* input, unsigned length) {
+    // Reallocate longer memory if capacity runs out
+    if (length + 1 > session->capacity) {
+        session->capacity = (length + 1) * 2;
+        session->input = (char*)realloc(session->input, session->capacity);
+        if (session->input == NULL) {
+            fprintf(stderr, "[ERROR] Bad session memory reallocation\n");
+            exit(1);
+        }
+    }
+
+    memcpy(session->input, input, length + 1);
+    session->length = length;
+}
+
+/**
+ * Use flags of nodes if tree is classified by
+ * brackets of session, otherwise brackets are
+ * searched in tokens which have their symbols
+ *
+ * @param session - Session of input line
+ * @param query - Query on head of tree
+ */
+static void session_classify(const Session* session, Query* query) {
+    if (query->flags == NULL || memcmp(query->brackets, session->brackets, sizeof(session->brackets)) != 0) {
+        query->flags = NULL;
+        query->brackets = session->brackets;
+    }
+}
+
+/**
+ * Find node of the last complete token reusing steps
+ * of unchanged beginning of input
+ *
+ * @param session - Session of input line
+ * @param input - The entered string
+ * @param query - Query for setting on found node
+ * @param last_token - Pointer for the last token
+ * @param last_length - Pointer for length of the last token
+ *
+ * @return 1 if predictions can be found, 0 otherwise
+ */
+static int session_walk(Session* session, const char* input, Query* query, const char** last_token,
+                        unsigned* last_length) {
+    // Nodes of steps are invalid if tree was compiled again
+    query_init(query, session->tree);
+    session_classify(session, query);
+    if (session->revision != session->tree->revision) {
+        session->revision = session->tree->revision;
+        session->length = 0;
+        session->step_count = 0;
+    }
+
+    // Get length of unchanged beginning of input
+    unsigned length = (unsigned)strlen(input);
+    unsigned same = 0;
+    while (same < session->length && same < length && session->input[same] == input[same]) {
+        same += 1;
+    }
+
+    // Pop steps of tokens which or
+    // which delimiters were changed
+    while (session->step_count > 0 && session->steps[session->step_count - 1].end >= same) {
+        session->step_count -= 1;
+    }
+
+    unsigned i = 0;
+    if (session->step_count > 0) {
+        i = session->steps[session->step_count - 1].end + 1;
+        query->node = session->steps[session->step_count - 1].node;
+        query->path = session->steps[session->step_count - 1].path;
+    }
+
+    // Finding nodes by new complete tokens,
+    // search stops on the first unknown token
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, input, length, i);
+
+    TokenSpan span;
+    while (query->node != NULL && tokenizer_next(&tokenizer, &span)) {
+        if (!query_descend_span(query, input, &span, session->buffer)) {
+            query->node = NULL;
+        }
+        session_push(session, query->node, query->path, span.offset + span.length);
+    }
+    session_remember(session, input, length);
+
+    if (query->node == NULL) {
+        return 0;
+    }
+
+    // Last token is empty if input ends with delimiter,
+    // it is completed as it is typed
+    *last_token = input + span.offset;
+    *last_length = span.length;
+
+    // Further search makes no sense if some token is unknown or
+    // if last word contains optional brackets
+    return !query_bracketed(query, *last_token, *last_length);
+}
+
+Predictions* session_predict(Session* session, const char* input) {
+    // Initialize result predictions
+    Predictions* pred = (Predictions*)malloc(sizeof(Predictions));
+    if (pred == NULL) {
+        fprintf(stderr, "[ERROR] Bad prediction memory allocation\n");
+        exit(1);
+    }
+    pred->type = FAILURE;
+    pred->tokens = vector_create(1);
+
+    Query query;
+    const char* last_token;
+    unsigned last_length;
+    if (session_walk(session, input, &query, &last_token, &last_length)) {
+        predictions_fill(pred, &query, last_token, last_length, session->optional_brackets);
+    }
+
+    return pred;
+}
+
+PredictType session_find(Session* session, const char* input, PredictionList* list) {
+    list->type = FAILURE;
+    list->length = 0;
+    list->total = 0;
+
+    Query query;
+    const char* last_token;
+    unsigned last_length;
+    if (session_walk(session, input, &query, &last_token, &last_length)) {
+        CacheKey key;
+        key.node = query.node;
+        key.path = query.path;
+        key.revision = session->tree->revision;
+        key.learned = session->tree->learned;
+        key.distance = list->distance;
+        key.prefix = last_token;
+        key.length = last_length;
+
+        // Predictions are found again only
+        // if node or last token was changed
+        if (!cache_find(&session->cache, &key, list)) {
+            prediction_list_fill(list, &query, last_token, last_length, session->optional_brackets);
+            cache_store(&session->cache, &key, list);
+        }
+    }
+
+    return list->type;
+}
+
+void session_free(Session* session) {
+    // Free memory of input, steps, cache and self
+    cache_free(&session->cache);
+    free(session->input);
+    free(session->steps);
+    free(session);
+}
+
+void color_print(char* text, COLOR_TYPE color) {
+#if defined(OS_WINDOWS)
+    HANDLE h_console = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (h_console == NULL) {
+        fprintf(stderr, "[ERROR] Couldn't handle terminal\n");
+        exit(1);
+    }
+
+    CONSOLE_SCREEN_BUFFER_INFO console_info;
+    COLOR_TYPE backup;
+
+    // Save current attributes
+    if (GetConsoleScreenBufferInfo(h_console, &console_info) == 0) {
+        fprintf(stderr, "[ERROR] Couldn't get terminal info\n");
+        exit(1);
+    }
+    backup = console_info.wAttributes;
+
+    // Print colored text
+    if (SetConsoleTextAttribute(h_console, color) == 0) {
+        fprintf(stderr, "[ERROR] Couldn't set terminal color\n");
+        exit(1);
+    }
+
+    printf("%s", text);
+
+    // Restore original color
+    if (SetConsoleTextAttribute(h_console, backup) == 0) {
+        fprintf(stderr, "[ERROR] Couldn't reset terminal color\n");
+        exit(1);
+    }
+#elif defined(OS_UNIX)
+    //Set new terminal color
+    printf("\033[");
+    printf("%s", color);
+    printf("m");
+
+    // Print colored text
+    printf("%s", text);
+
+    //Resets the text to default color
+    printf("\033[0m");
+#endif
+}
+
+#if defined(OS_UNIX)
+int _getch() {
+    int character;
+    struct termios old_attr, new_attr;
+
+    // Backup terminal attributes
+    if (tcgetattr(STDIN_FILENO, &old_attr ) == -1) {
+        fprintf(stderr, "[ERROR] Couldn't get terminal attributes\n");
+        exit(1);
+    }
+
+    // Disable echo
+    new_attr = old_attr;
+    new_attr.c_lflag &= ~(ICANON | ECHO );
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &new_attr) == -1) {
+        fprintf(stderr, "[ERROR] Couldn't set terminal attributes\n");
+        exit(1);
+    }
+
+    // Get input character
+    character = getchar();
+
+    // Restore terminal attributes
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &old_attr) == -1) {
+        fprintf(stderr, "[ERROR] Couldn't reset terminal attributes\n");
+        exit(1);
+    }
+
+    return character;
+}
+#endif
+
+short terminal_width() {
+#if defined(OS_WINDOWS)
+    // Handle current terminal
+    HANDLE h_console = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (h_console == NULL) {
+        fprintf(stderr, "[ERROR] Couldn't handle terminal\n");
+        exit(1);
+    }
+
+    // Get current attributes
+    CONSOLE_SCREEN_BUFFER_INFO console_info;
+    if (GetConsoleScreenBufferInfo(h_console, &console_info) == 0) {
+        fprintf(stderr, "[ERROR] Couldn't get terminal info\n");
+        exit(1);
+    }
+
+    // Return current width
+    return console_info.dwSize.X;
+#elif defined(OS_UNIX)
+    struct winsize t_size;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &t_size) == -1) {
+        fprintf(stderr, "[ERROR] Couldn't get terminal info\n");
+        exit(1);
+    }
+
+    return (short)t_size.ws_col;
+#endif
+}
+
+void clear_line() {
+#if defined(OS_WINDOWS)
+    // Get current terminal width
+    short width = terminal_width();
+    if (width < 1) {
+        fprintf(stderr, "[ERROR] Size of terminal is too small\n");
+        exit(1);
+    }
+
+    // Create long empty string
+    char* empty = (char*)malloc(sizeof(char) * width);
+    memset(empty, ' ', width);
+    empty[width - 1] = '\0';
+
+    // Clear line
+    printf("\r%s\r", empty);
+
+    // Free line
+    free(empty);
+#elif defined(OS_UNIX)
+    printf("\033[2K\r");
+#endif
+}
+
+void set_cursor_x(short x) {
+#if defined(OS_WINDOWS)
+    HANDLE h_console = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (h_console == NULL) {
+        fprintf(stderr, "[ERROR] Couldn't handle terminal\n");
+        exit(1);
+    }
+
+    // Create position
+    COORD xy;
+    xy.X = x - 1;
+    xy.Y = get_cursor_y();
+
+    // Set cursor position
+    if (SetConsoleCursorPosition(h_console, xy) == 0) {
+        fprintf(stderr, "[ERROR] Couldn't set terminal cursor position\n");
+        exit(1);
+    }
+#elif defined(OS_UNIX)
+    printf("\033[%d;%dH", get_cursor_y(), x);
+#endif
+}
+
+short get_cursor_y() {
+#if defined(OS_WINDOWS)
+    HANDLE h_console = GetStdHandle(STD_OUTPUT_HANDLE);
+    if (h_console == NULL) {
+        fprintf(stderr, "[ERROR] Couldn't handle terminal\n");
+        exit(1);
+    }
+
+    // Get terminal info
+    CONSOLE_SCREEN_BUFFER_INFO console_info;
+    if (GetConsoleScreenBufferInfo(h_console, &console_info) == 0) {
+        fprintf(stderr, "[ERROR] Couldn't get terminal Y position\n");
+        exit(1);
+    }
+
+    // Return Y position
+    return console_info.dwCursorPosition.Y;
+#elif defined(OS_UNIX)
+    struct termios old_attr, new_attr;
+    char ch, buf[30] = {0};
+    int i = 0, pow = 1, y = 0;
+
+    // Backup terminal attributes
+    if (tcgetattr(STDIN_FILENO, &new_attr) == -1) {
+        fprintf(stderr, "[ERROR] Couldn't get terminal attributes\n");
+        exit(1);
+    }
+
+    // Disable echo
+    old_attr = new_attr;
+    old_attr.c_lflag &= ~(ICANON | ECHO);
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &old_attr) == -1) {
+        fprintf(stderr, "[ERROR] Couldn't set terminal attributes\n");
+        exit(1);
+    }
+
+    // Get info about cursor
+    if (write(STDOUT_FILENO, "\033[6n", 4) != 4) {
+        fprintf(stderr, "[ERROR] Couldn't get cursor information\n");
+        exit(1);
+    }
+
+    // Get ^[[{this};1R value
+
+    for (ch = 0; ch != 'R'; i++) {
+        if (read(STDIN_FILENO, &ch, 1) != 1) {
+            fprintf(stderr, "[ERROR] Couldn't read cursor information");
+            exit(1);
+        }
+        buf[i] = ch;
+    }
+
+    i -= 2;
+    while (buf[i] != ';') {
+        i -= 1;
+    }
+
+    i -= 1;
+    while (buf[i] != '[') {
+        y = y + (buf[i] - '0') * pow;
+        pow *= 10;
+        i -= 1;
+    }
 
-        // Get length of last word in input
-        short space_offset = 0;
-        while ((buff_len - space_offset) != 0 && buff[buff_len - space_offset - 1] != ' ') {
-            space_offset += 1;
-        }
+    // Reset attributes
+    if (tcsetattr(0, TCSANOW, &new_attr) == -1) {
+        fprintf(stderr, "[ERROR] Couldn't reset terminal attributes\n");
+        exit(1);
+    }
 
-        // Print current buffer
-        color_print(buff, main_color);
+    return (short)y;
+#endif
+}
 
-        // Get predictions
-        Predictions* pred = predictions_create(rules, buff, optional_brackets);
+#include <stdlib.h>
 
-        // Print prediction by hint_num with color
-        if (pred->type != FAILURE) {
-            char* prediction = (char*)vector_get(pred->tokens, hint_num % pred->tokens->length);
+/**
+ * Function and argument passed to
+ * the start routine of thread
+ */
+struct thread_start {
+    ThreadFunction function;
+    void* arg;
+};
+typedef struct thread_start ThreadStart;
 
-            // Print info message before prediction
-            // if prediction is probably
-            if (pred->type == PROBABLY) {
-                color_print("  maybe you mean: ", predict_color);
-            }
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
 
-            // Print trimmed or not trimmed prediction depending on the type
-            color_print(prediction + (pred->type == EXACTLY) * space_offset, predict_color);
-        }
+static DWORD WINAPI thread_routine(LPVOID data) {
+    ThreadStart start = *(ThreadStart*)data;
+    free(data);
 
-        // Move cursor to buffer end
-        short x = (short)(buff_len + title_len + (title_len != 0) + 1 - offset);
-        set_cursor_x(x);
+    start.function(start.arg);
 
-        // Read character from console
-        int ch = _getch();
+    return 0;
+}
 
-        // Wait next symbol if character in ignore keys
-        if (is_ignore_key(ch)) {
-            continue;
-        }
+int thread_create(Thread* thread, ThreadFunction function, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (start == NULL) {
+        return 1;
+    }
+    start->function = function;
+    start->arg = arg;
 
-        // Return buffer if ENTER was pressed
-        else if (ch == ENTER) {
-            // Free predictions and break
-            predictions_free(pred);
-            break;
-        }
+    *thread = CreateThread(NULL, 0, thread_routine, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return 1;
+    }
 
-        // Keyboard interrupt handler for Windows
-        #if defined(OS_WINDOWS)
-        else if (ch == CTRL_C) {
-            predictions_free(pred);
-            tree_free(rules);
-            free(buff);
-            exit(0);
-        }
-        #endif
-        // Edit buffer like backspace if BACKSPACE was pressed
-        else if (ch == BACKSPACE) {
-            if (buff_len != 0 && buff_len - offset >= 1) {
-                // Delete character from buffer
-                for (unsigned i = (unsigned int)(buff_len - offset - 1); i < buff_cap - 1; i++) {
-                    buff[i] = buff[i + 1];
-                }
-                buff_len -= 1;
-            }
-        }
+    return 0;
+}
 
-        // Apply prediction if TAB was pressed
-        else if (ch == TAB) {
-            if (pred->type != FAILURE) {
-                char* prediction = (char*)vector_get(pred->tokens, hint_num % pred->tokens->length);
-                unsigned predict_len = (unsigned int)strlen(prediction);
+void thread_join(Thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
 
-                // Make sure the candidate has no optional brackets
-                if (!contain_chars(prediction, optional_brackets)) {
+void thread_sleep(unsigned milliseconds) {
+    Sleep(milliseconds);
+}
 
-                    // Handle buffer overflow
-                    if (buff_len + predict_len - space_offset >= buff_cap) {
-                        fprintf(stderr, "\n[ERROR] Input string more then terminal width\n");
-                        exit(1);
-                    }
+void mutex_init(Mutex* mutex) {
+    InitializeCriticalSection(mutex);
+}
 
-                    // Append prediction to buffer
-                    for (unsigned i = 0; i < predict_len; i++) {
-                        buff[buff_len - space_offset] = prediction[i];
-                        buff_len++;
-                    }
+void mutex_lock(Mutex* mutex) {
+    EnterCriticalSection(mutex);
+}
 
-                    // Fix buffer length
-                    buff_len = buff_len - space_offset;
+void mutex_unlock(Mutex* mutex) {
+    LeaveCriticalSection(mutex);
+}
 
-                    // Append end characters to buffer
-                    buff[buff_len++] = ' ';
-                    buff[buff_len] = '\0';
-                }
-            }
-        }
+void mutex_free(Mutex* mutex) {
+    DeleteCriticalSection(mutex);
+}
 
-        // Arrows and Delete keys handler
-        else if (
-            ch == SPECIAL_SEQ_1
-        #if defined(OS_WINDOWS)
-            || ch
-        #elif defined(OS_UNIX)
-            && _getch()
-        #endif
-            == SPECIAL_SEQ_2
-        ) {
-            switch (_getch()) {
-                case LEFT:
-                    // Increase offset from the end of the buffer if left key pressed
-                    offset = (offset < buff_len) ? (offset + 1) : buff_len;
-                    break;
-                case RIGHT:
-                    // Decrease offset from the end of the buffer if left key pressed
-                    offset = (offset > 0) ? offset - 1 : 0;
-                    break;
-                case UP:
-                    // Increase hint number
-                    hint_num = hint_num + 1;
-                    clear_line();
-                    break;
-                case DOWN:
-                    // Decrease hint number
-                    hint_num = hint_num - 1;
-                    clear_line();
-                    break;
-                case DEL:
-                    // Edit buffer like DELETE key
-                #if defined(OS_UNIX)
-                    if (_getch() == DEL_AFTER)
-                #endif
-                {
-                    if (buff_len != 0 && offset != 0) {
-                        // Delete character from buffer
-                        for (unsigned i = (unsigned int)(buff_len - offset); i < buff_cap - 1; i++) {
-                            buff[i] = buff[i + 1];
-                        }
-                        buff_len -= 1;
-                        offset -= 1;
-                    }
-                }
-                    break;
-                default:
-                    break;
-            }
-        }
+void* atomic_load_ptr(void* volatile* ptr) {
+    return InterlockedCompareExchangePointer(ptr, NULL, NULL);
+}
 
-        // Add character to buffer considering
-        // offset if any key was pressed
-        else {
-            hint_num = ch == SPACE ? 0 : hint_num;
-            buff[buff_len++] = (char)ch;
-        }
+void* atomic_exchange_ptr(void* volatile* ptr, void* value) {
+    return InterlockedExchangePointer(ptr, value);
+}
 
-        // Free predictions
-        predictions_free(pred);
-    }
+long atomic_load_long(volatile long* ptr) {
+    return InterlockedCompareExchange(ptr, 0, 0);
+}
 
-    return buff;
+void atomic_store_long(volatile long* ptr, long value) {
+    InterlockedExchange(ptr, value);
 }
 
-char* input(Tree* rules) {
-    return custom_input(rules, "", DEFAULT_TITLE_COLOR, DEFAULT_PREDICT_COLOR,
-                        DEFAULT_MAIN_COLOR, "");
+long atomic_add_long(volatile long* ptr, long value) {
+    return InterlockedExchangeAdd(ptr, value);
 }
 
-int is_ignore_key(int ch) {
-    int ignore_keys[] =
-    #if defined(OS_WINDOWS)
-            {1, 2, 19, 24, 26};
-    #elif defined(OS_UNIX)
-            {1, 2, 4, 24};
-    #endif
+#else
 
-    // Calculate length of ignore keys array
-    unsigned len = sizeof(ignore_keys) / sizeof(int);
+#include <time.h>
 
-    // Check if character is ignore key
-    for (unsigned i = 0; i < len; i++) {
-        if (ch == ignore_keys[i]) {
-            return 1;
-        }
-    }
+static void* thread_routine(void* data) {
+    ThreadStart start = *(ThreadStart*)data;
+    free(data);
 
-    return 0;
+    start.function(start.arg);
+
+    return NULL;
 }
 
-Node* node_create(char* token, unsigned token_length) {
-    // Allocate memory for node
-    Node* n = (Node*)malloc(sizeof(Node));
-    if (n == NULL) {
-        fprintf(stderr, "[ERROR] Bad node vector memory allocation\n");
-        exit(1);
+int thread_create(Thread* thread, ThreadFunction function, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (start == NULL) {
+        return 1;
     }
+    start->function = function;
+    start->arg = arg;
 
-    // Allocate memory for token field
-    n->token = (char*)malloc(sizeof(char) * token_length);
-    if (n->token == NULL) {
-        fprintf(stderr, "[ERROR] Bad node vector memory allocation\n");
-        exit(1);
+    if (pthread_create(thread, NULL, thread_routine, start) != 0) {
+        free(start);
+        return 1;
     }
 
-    // Setup fields of node
-    memcpy(n->token, token, sizeof(char) * token_length);
+    return 0;
+}
+
+void thread_join(Thread thread) {
+    pthread_join(thread, NULL);
+}
 
-    n->children = vector_create(1);
+void thread_sleep(unsigned milliseconds) {
+    struct timespec time;
+    time.tv_sec = milliseconds / 1000;
+    time.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
 
-    return n;
+    nanosleep(&time, NULL);
 }
 
-void node_free(Node* n) {
-    // Free all child nodes
-    for (unsigned i = 0; i < n->children->length; i++) {
-        node_free(vector_get(n->children, i));
+void mutex_init(Mutex* mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void mutex_lock(Mutex* mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void mutex_unlock(Mutex* mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void mutex_free(Mutex* mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void* atomic_load_ptr(void* volatile* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+void* atomic_exchange_ptr(void* volatile* ptr, void* value) {
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+long atomic_load_long(volatile long* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+void atomic_store_long(volatile long* ptr, long value) {
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+long atomic_add_long(volatile long* ptr, long value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+#endif
+
+#include <stddef.h>
+
+void tokenizer_init(Tokenizer* tokenizer, const char* input, unsigned length, unsigned position) {
+    tokenizer->input = input;
+    tokenizer->length = length;
+    tokenizer->position = position;
+}
+
+int tokenizer_next(Tokenizer* tokenizer, TokenSpan* span) {
+    const char* input = tokenizer->input;
+    unsigned length = tokenizer->length;
+    unsigned i = tokenizer->position;
+
+    // Skip spaces while token not found
+    while (i < length && input[i] == ' ') {
+        i += 1;
     }
 
-    // Free memory for children, token and self
-    vector_free(n->children);
-    free(n->token);
-    free(n);
+    span->offset = i;
+    span->flags = TOKEN_PLAIN;
+
+    // Find unquoted and unescaped delimiter
+    char quote = '\0';
+    while (i < length && (quote != '\0' || input[i] != ' ')) {
+        char ch = input[i];
+
+        if (quote == '\'') {
+            // Single quotes have no escapes
+            quote = ch == '\'' ? '\0' : quote;
+        }
+        else if (ch == '\\') {
+            // Escaped character never ends token
+            span->flags |= TOKEN_QUOTED;
+            i += i + 1 < length;
+        }
+        else if (quote == '"') {
+            quote = ch == '"' ? '\0' : quote;
+        }
+        else if (ch == '"' || ch == '\'') {
+            span->flags |= TOKEN_QUOTED;
+            quote = ch;
+        }
+        i += 1;
+    }
+
+    span->length = i - span->offset;
+    if (quote != '\0') {
+        span->flags |= TOKEN_OPEN;
+    }
+
+    // The last token isn't followed by delimiter
+    if (i == length) {
+        tokenizer->position = length;
+        return 0;
+    }
+
+    tokenizer->position = i + 1;
+    return 1;
 }
 
-char* token_create(char* str, unsigned str_len) {
-    // Allocate memory for token
-    char* token = (char*)malloc(sizeof(char) * str_len + 1);
-    if (token == NULL) {
-        fprintf(stderr, "[ERROR] Bad token memory allocation\n");
-        exit(0);
+const char* token_text(const char* input, const TokenSpan* span, char* buffer, unsigned* length) {
+    const char* token = input + span->offset;
+
+    // Plain token is used as is
+    if (!(span->flags & TOKEN_QUOTED)) {
+        *length = span->length;
+        return token;
     }
 
-    // Paste data to token
-    memcpy(token, str, str_len);
-    token[str_len] = '\0';
+    // Copy token without quotes and escapes
+    unsigned size = 0;
+    char quote = '\0';
+    for (unsigned i = 0; i < span->length; i++) {
+        char ch = token[i];
 
-    // Return token
-    return token;
+        // Backslash is literal inside of single quotes
+        if (ch == '\\' && quote != '\'' && i + 1 < span->length) {
+            ch = token[++i];
+        }
+        // Opening and closing quotes aren't part of text
+        else if (quote == '\0' && (ch == '"' || ch == '\'')) {
+            quote = ch;
+            continue;
+        }
+        else if (quote != '\0' && ch == quote) {
+            quote = '\0';
+            continue;
+        }
+
+        if (size + 1 >= TOKEN_TEXT_SIZE) {
+            return NULL;
+        }
+        buffer[size++] = ch;
+    }
+
+    buffer[size] = '\0';
+    *length = size;
+    return buffer;
 }
 
-Tokens* split(char *str, char delimiter) {
-    // Create token vector
-    Tokens* vec = vector_create(1);
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-    char prev_char = delimiter;
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #include <io.h>
+    #define READ_FD(fd, buff, size) _read(fd, buff, size)
+#else
+    #include <unistd.h>
+    #define READ_FD(fd, buff, size) read(fd, buff, size)
+#endif
 
-    // Finding tokens and placing them in an array
-    for (unsigned i = 0; str[i] != '\0'; i++) {
+// Size of blocks in which config is read
+#define READ_BLOCK_SIZE (64 * 1024)
 
-        // Skip spaces while token not found
-        if (prev_char == delimiter && str[i] != delimiter) {
-            // Get length of current token
-            unsigned token_length = 0;
+/**
+ * State of single-pass config parser,
+ * fed by blocks of arbitrary size
+ */
+struct parser {
+    Tree* tree;
+    Vector* root_nodes;       // Last node on each indentation level
+    char* line;               // Line carried between blocks
+    unsigned line_length;
+    unsigned line_capacity;
+    unsigned line_counter;    // Counter of lines in config file
+    unsigned tab_length;      // Count of spaces in one tabulation
+    int quiet;                // Don't print errors
+};
+typedef struct parser Parser;
+
+static void parser_init(Parser* parser, Tree* tree) {
+    parser->tree = tree;
+    parser->root_nodes = vector_create(1);
+    vector_push(parser->root_nodes, (void*)tree->head);
+
+    parser->line = NULL;
+    parser->line_length = 0;
+    parser->line_capacity = 0;
+    parser->line_counter = 0;
+    parser->tab_length = 0;
+    parser->quiet = 0;
+}
 
-            while (str[i + token_length] != delimiter && str[i + token_length] != '\0') {
-                token_length += 1;
-            }
+static void parser_free(Parser* parser) {
+    vector_free(parser->root_nodes);
+    free(parser->line);
+}
 
-            // Add token to vector
-            vector_push(vec, token_create(str + i, token_length));
+/**
+ * Parse one line of config and
+ * attach its token to the tree
+ *
+ * @return Zero on success or not zero on error
+ */
+static int parser_line(Parser* parser, const char* line, size_t length) {
+    parser->line_counter += 1;
+
+    // Ignore carriage return of Windows line endings
+    if (length > 0 && line[length - 1] == '\r') {
+        length -= 1;
+    }
 
-            // Move string cursor right
-            i += token_length - 1;
+    // Don't use tab character!!!
+    if (length > 0 && line[0] == '\t') {
+        if (!parser->quiet) {
+            fprintf(stderr, "[ERROR] Tab character detected in line %u, use a sequence of spaces\n", parser->line_counter);
         }
-
-        // Remember prev character
-        prev_char = str[i];
+        return 1;
     }
 
-    // Add empty string to vector if detected delimiter in the end
-    if (prev_char == delimiter) {
-        char* token = token_create("", 1);
-        vector_push(vec, token);
+    // Get space count
+    unsigned space_counter = 0;
+    while (space_counter < length && line[space_counter] == ' ') {
+        space_counter += 1;
     }
 
-    // Return token vector
-    return vec;
-}
+    // Skip empty lines
+    if (space_counter == length) {
+        return 0;
+    }
 
-Predictions *predictions_create(Tree *rules, char *input, char *optional_brackets) {
-    // Initialize result predictions
-    Predictions* pred = (Predictions*)malloc(sizeof(Predictions));
-    if (pred == NULL) {
-        fprintf(stderr, "[ERROR] Bad prediction memory allocation\n");
-        exit(0);
+    // Init correct tab length
+    if (space_counter > parser->tab_length && parser->tab_length == 0) {
+        parser->tab_length = space_counter;
     }
-    pred->type = EXACTLY;
-    pred->tokens = vector_create(1);
 
-    // Split input string to tokens
-    Tokens* tokens = split(input, ' ');
+    // Check count of spaces for correctness
+    if (space_counter % MAX_OF(parser->tab_length, 1) != 0) {
+        if (!parser->quiet) {
+            fprintf(stderr, "[ERROR] Incorrect tab length in line %u\n", parser->line_counter);
+        }
+        return 1;
+    }
 
-    Node* curr_node = rules->head;
-    Node* prev_node = rules->head;
-    Vector* curr_children = curr_node->children;
+    // Get tabulations count
+    unsigned tab_count = space_counter / MAX_OF(parser->tab_length, 1);
 
-    // Don't show predictions if last word contains optional brackets
-    if (contain_chars((char*)vector_get(tokens, tokens->length - 1), optional_brackets)) {
-        pred->type = FAILURE;
-        return pred;
+    // Get token
+    const char* token = line + space_counter;
+    unsigned token_length = 0;
+    while (space_counter + token_length < length && token[token_length] != ' ' && token[token_length] != '\t') {
+        token_length += 1;
     }
 
-    // Finding vector in tree by input tokens
-    for (unsigned i = 0; i < tokens->length - 1; i++) {
-        for (unsigned j = 0; j < curr_children->length; j++) {
-            Node* temp_node = (Node*)vector_get(curr_children, j);
-            char* token = (char*)vector_get(tokens, i);
+    // Get optional weight after token like "commit @10"
+    unsigned weight = 0;
+    unsigned i = space_counter + token_length;
+    if (i < length) {
+        while (i < length && line[i] == ' ') {
+            i += 1;
+        }
 
-            if (strcmp(temp_node->token, token) == 0) {
-                curr_node = temp_node;
-                curr_children = curr_node->children;
-                break;
+        // Handle space symbol in token error
+        if (i == space_counter + token_length || i == length || line[i] != '@') {
+            if (!parser->quiet) {
+                fprintf(stderr, "[ERROR] Token in config file must not have spaces, line %u\n", parser->line_counter);
             }
+            return 1;
         }
 
-        // If further search makes no sense
-        if (prev_node == curr_node) {
-            pred->type = FAILURE;
-            break;
+        // Weight has at most 9 digits
+        unsigned digits = 0;
+        for (i += 1; i < length && line[i] >= '0' && line[i] <= '9' && digits < 9; i++, digits++) {
+            weight = weight * 10 + (unsigned)(line[i] - '0');
         }
 
-        // Remember node
-        prev_node = curr_node;
+        if (digits == 0 || i != length) {
+            if (!parser->quiet) {
+                fprintf(stderr, "[ERROR] Incorrect weight of token in line %u\n", parser->line_counter);
+            }
+            return 1;
+        }
     }
 
-    // Search words starts with last token
-    // if children nodes was found
-    if (pred->type != FAILURE) {
-        for (unsigned i = 0; i < curr_children->length; i++) {
-            char* probably_token = ((Node*)vector_get(curr_children, i))->token;
-            char* last_token = (char*)vector_get(tokens, tokens->length - 1);
-
-            if (strncmp(last_token, probably_token, strlen(last_token)) == 0) {
-                vector_push(pred->tokens, token_create(probably_token, (unsigned int)strlen(probably_token)));
-            }
+    // Push node to tree
+    Vector* root_nodes = parser->root_nodes;
+    if (tab_count >= root_nodes->length) {
+        if (!parser->quiet) {
+            fprintf(stderr, "[ERROR] The token on line %u does not belong to any token\n", parser->line_counter);
         }
+        return 1;
     }
 
-    // Set EXACTLY type for predictions if words was found
-    // or search probably words without optional brackets
-    // if words wasn't found
-    if (pred->tokens->length > 0) {
-        pred->type = EXACTLY;
-    } else if (pred->type != FAILURE) {
-        for (unsigned i = 0; i < curr_children->length; i++) {
-            char *probably_token = ((Node *) vector_get(curr_children, i))->token;
-            char *last_token = (char *) vector_get(tokens, tokens->length - 1);
-
-            // Skip if candidate contain one of symbols for optional values
-            if (contain_chars(probably_token, optional_brackets)) {
-                continue;
-            }
+    Tree* tree = parser->tree;
+    Node* n = node_create(tree->arena, pool_intern(tree->pool, token, token_length), token_length);
+    n->weight = weight;
+    node_list_push(&((Node*)vector_get(root_nodes, tab_count))->children, tree->arena, n);
 
-            // Total misses in probably token
-            unsigned miss = 0;
+    // Add token to root tokens vector by index as tab count
+    if (tab_count + 1 < root_nodes->length) {
+        vector_set(root_nodes, tab_count + 1, n);
+        root_nodes->length = tab_count + 2;
+    }
+    else {
+        vector_push(root_nodes, (void*)n);
+    }
 
-            // Counting misses (no more than 2)
-            for (unsigned j = 0; j < strlen(last_token); j++) {
-                if (last_token[j] != probably_token[j]) {
-                    if (++miss == 2) {
-                        break;
-                    }
+    return 0;
+}
+
+/**
+ * Feed next block of config to parser,
+ * the block may end in the middle of a line
+ *
+ * @return Zero on success or not zero on error
+ */
+static int parser_feed(Parser* parser, const char* data, size_t length) {
+    const char* end = data + length;
+
+    while (data < end) {
+        const char* newline = (const char*)memchr(data, '\n', (size_t)(end - data));
+
+        // Carry incomplete line to the next block
+        if (newline == NULL) {
+            size_t rest = (size_t)(end - data);
+            if (parser->line_length + rest > parser->line_capacity) {
+                parser->line_capacity = (unsigned)((parser->line_length + rest) * 2);
+                parser->line = (char*)realloc(parser->line, parser->line_capacity);
+                if (parser->line == NULL) {
+                    fprintf(stderr, "[ERROR] Bad parser line memory allocation\n");
+                    exit(1);
                 }
             }
+            memcpy(parser->line + parser->line_length, data, rest);
+            parser->line_length += (unsigned)rest;
+            break;
+        }
 
-            // Adding a word to predictions
-            // if there are less than 2 misses
-            if (miss < 2) {
-                vector_push(pred->tokens, token_create(probably_token, (unsigned int)strlen(probably_token)));
+        int error;
+
+        // Complete carried line or parse line in place
+        if (parser->line_length > 0) {
+            size_t rest = (size_t)(newline - data);
+            if (parser->line_length + rest > parser->line_capacity) {
+                parser->line_capacity = (unsigned)(parser->line_length + rest);
+                parser->line = (char*)realloc(parser->line, parser->line_capacity);
+                if (parser->line == NULL) {
+                    fprintf(stderr, "[ERROR] Bad parser line memory allocation\n");
+                    exit(1);
+                }
             }
+            memcpy(parser->line + parser->line_length, data, rest);
+            error = parser_line(parser, parser->line, parser->line_length + rest);
+            parser->line_length = 0;
+        }
+        else {
+            error = parser_line(parser, data, (size_t)(newline - data));
         }
 
-        // Set type depending on the success of the search
-        pred->type = pred->tokens->length > 0 ? PROBABLY : FAILURE;
-    }
+        if (error) {
+            return error;
+        }
 
-    // Free input tokens
-    tokens_free(tokens);
+        // Go to next line
+        data = newline + 1;
+    }
 
-    // Return result
-    return pred;
+    return 0;
 }
 
-void predictions_free(Predictions* predict) {
-    // Free all tokens
-    tokens_free(predict->tokens);
+/**
+ * Parse the last line of config
+ * if it has no line break
+ *
+ * @return Zero on success or not zero on error
+ */
+static int parser_finish(Parser* parser) {
+    if (parser->line_length == 0) {
+        return 0;
+    }
 
-    // Free self
-    free(predict);
+    int error = parser_line(parser, parser->line, parser->line_length);
+    parser->line_length = 0;
+
+    return error;
 }
 
-void tokens_free(Tokens* tokens) {
-    // Free all input tokens vector
-    for (unsigned i = 0; i < tokens->length; i++) {
-        free(vector_get(tokens, i));
+/**
+ * Allocate tree with head node only
+ *
+ * @return Empty tree
+ */
+static Tree* tree_alloc() {
+    Tree* tree = (Tree*)malloc(sizeof(Tree));
+    if (tree == NULL) {
+        fprintf(stderr, "[ERROR] Bad tree memory allocation\n");
+        exit(1);
     }
 
-    // Free self
-    vector_free(tokens);
+    tree->arena = arena_create();
+    tree->pool = pool_create(tree->arena);
+    tree->image = NULL;
+    tree->revision = 0;
+    tree->learned = 0;
+    tree->usage = NULL;
+    tree->usage_capacity = 0;
+    tree->usage_count = 0;
+    tree->flags = NULL;
+    memset(tree->brackets, 0, sizeof(tree->brackets));
+    tree->head = node_create(tree->arena, pool_intern(tree->pool, "", 0), 0);
+    tree->edges = NULL;
+    tree->edge_capacity = 0;
+    tree->edge_count = 0;
+
+    return tree;
 }
 
-int contain_chars(const char* str, const char* chars) {
-    // Checking for given characters in a string
-    for (unsigned i = 0; str[i] != '\0'; i++) {
-        for (unsigned j = 0; chars[j] != '\0'; j++) {
-            if (str[i] == chars[j]) {
-                return 1;
+/**
+ * Parse config from stream or file descriptor
+ * in one pass, only the current block and
+ * incomplete line are kept in memory
+ *
+ * @param stream - Input stream or NULL for reading descriptor
+ * @param fd - Input file descriptor
+ * @param name - Name of input for error messages
+ *
+ * @return Rules in the form of a tree or NULL with printed error
+ */
+static Tree* tree_read(FILE* stream, int fd, const char* name) {
+    // Create buffer for reading by blocks
+    char* buff = (char*)malloc(sizeof(char) * READ_BLOCK_SIZE);
+    if (buff == NULL) {
+        fprintf(stderr, "[ERROR] Bad buffer memory allocation\n");
+        exit(1);
+    }
+
+    // Initialize tree and tree head
+    Tree* tree = tree_alloc();
+
+    Parser parser;
+    parser_init(&parser, tree);
+
+    int error = 0;       // Flag for error handling
+    size_t total = 0;    // Count of read bytes
+
+    // Parse config in one pass, this works
+    // for pipes and other non-seekable files
+    while (!error) {
+        long count;
+
+        if (stream != NULL) {
+            count = (long)fread(buff, sizeof(char), READ_BLOCK_SIZE, stream);
+            if (count == 0 && ferror(stream)) {
+                count = -1;
             }
         }
-    }
+        else {
+            do {
+                count = (long)READ_FD(fd, buff, READ_BLOCK_SIZE);
+            } while (count < 0 && errno == EINTR);
+        }
 
-    return 0;
-}
+        if (count < 0) {
+            fprintf(stderr, "[ERROR] Can't read %s\n", name);
+            error = 1;
+            break;
+        }
+        if (count == 0) {
+            break;
+        }
 
-void color_print(char* text, COLOR_TYPE color) {
-#if defined(OS_WINDOWS)
-    HANDLE h_console = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (h_console == NULL) {
-        fprintf(stderr, "[ERROR] Couldn't handle terminal\n");
-        exit(1);
+        total += (size_t)count;
+        error = parser_feed(&parser, buff, (size_t)count);
+    }
+    if (!error) {
+        error = parser_finish(&parser);
     }
 
-    CONSOLE_SCREEN_BUFFER_INFO console_info;
-    COLOR_TYPE backup;
+    // Remove temporary variables
+    parser_free(&parser);
+    free(buff);
 
-    // Save current attributes
-    if (GetConsoleScreenBufferInfo(h_console, &console_info) == 0) {
-        fprintf(stderr, "[ERROR] Couldn't get terminal info\n");
-        exit(1);
+    // Check for empty config file
+    if (!error && total == 0) {
+        fprintf(stderr, "[ERROR] Config from %s is empty\n", name);
+        error = 1;
     }
-    backup = console_info.wAttributes;
 
-    // Print colored text
-    if (SetConsoleTextAttribute(h_console, color) == 0) {
-        fprintf(stderr, "[ERROR] Couldn't set terminal color\n");
-        exit(1);
+    // Free tree if error
+    if (error) {
+        tree_free(tree);
+        return NULL;
     }
 
-    printf("%s", text);
+    // Compile tree for predictions
+    tree_finalize(tree);
 
-    // Restore original color
-    if (SetConsoleTextAttribute(h_console, backup) == 0) {
-        fprintf(stderr, "[ERROR] Couldn't reset terminal color\n");
-        exit(1);
+    // Return tree
+    return tree;
+}
+
+Tree* tree_try_create(const char* filepath) {
+    // Try open file for reading
+    FILE* config = fopen(filepath, "rb");
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return NULL;
     }
-#elif defined(OS_UNIX)
-    //Set new terminal color
-    printf("\033[");
-    printf("%s", color);
-    printf("m");
 
-    // Print colored text
-    printf("%s", text);
+    Tree* tree = tree_read(config, -1, filepath);
+    fclose(config);
 
-    //Resets the text to default color
-    printf("\033[0m");
-#endif
+    return tree;
 }
 
-#if defined(OS_UNIX)
-int _getch() {
-    int character;
-    struct termios old_attr, new_attr;
+Tree* tree_create_from_stream(FILE* stream) {
+    Tree* tree = tree_read(stream, -1, "input stream");
 
-    // Backup terminal attributes
-    if (tcgetattr(STDIN_FILENO, &old_attr ) == -1) {
-        fprintf(stderr, "[ERROR] Couldn't get terminal attributes\n");
+    // Exit if error
+    if (tree == NULL) {
         exit(1);
     }
 
-    // Disable echo
-    new_attr = old_attr;
-    new_attr.c_lflag &= ~(ICANON | ECHO );
-    if (tcsetattr(STDIN_FILENO, TCSANOW, &new_attr) == -1) {
-        fprintf(stderr, "[ERROR] Couldn't set terminal attributes\n");
+    return tree;
+}
+
+Tree* tree_create_from_fd(int fd) {
+    Tree* tree = tree_read(NULL, fd, "input file descriptor");
+
+    // Exit if error
+    if (tree == NULL) {
         exit(1);
     }
 
-    // Get input character
-    character = getchar();
+    return tree;
+}
 
-    // Restore terminal attributes
-    if (tcsetattr(STDIN_FILENO, TCSANOW, &old_attr) == -1) {
-        fprintf(stderr, "[ERROR] Couldn't reset terminal attributes\n");
+Tree* tree_create(const char* filepath) {
+    Tree* tree = tree_try_create(filepath);
+
+    // Exit if error
+    if (tree == NULL) {
         exit(1);
     }
 
-    return character;
+    return tree;
 }
-#endif
 
-short terminal_width() {
-#if defined(OS_WINDOWS)
-    // Handle current terminal
-    HANDLE h_console = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (h_console == NULL) {
-        fprintf(stderr, "[ERROR] Couldn't handle terminal\n");
-        exit(1);
+Tree* tree_create_from_buffer(const char* data, size_t length) {
+    // Initialize tree and tree head
+    Tree* tree = tree_alloc();
+
+    Parser parser;
+    parser_init(&parser, tree);
+
+    // Parse the whole buffer as one block
+    int error = parser_feed(&parser, data, length);
+    if (!error) {
+        error = parser_finish(&parser);
     }
 
-    // Get current attributes
-    CONSOLE_SCREEN_BUFFER_INFO console_info;
-    if (GetConsoleScreenBufferInfo(h_console, &console_info) == 0) {
-        fprintf(stderr, "[ERROR] Couldn't get terminal info\n");
+    parser_free(&parser);
+
+    // Free tree and exit if error
+    if (error) {
+        tree_free(tree);
         exit(1);
     }
 
-    // Return current width
-    return console_info.dwSize.X;
-#elif defined(OS_UNIX)
-    struct winsize t_size;
+    // Compile tree for predictions
+    tree_finalize(tree);
 
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &t_size) == -1) {
-        fprintf(stderr, "[ERROR] Couldn't get terminal info\n");
+    // Return tree
+    return tree;
+}
+
+/**
+ * Read the whole file to memory by blocks,
+ * this works for non-seekable files too
+ *
+ * @return Allocated data or NULL with printed error
+ */
+static char* tree_read_file(const char* filepath, size_t* length) {
+    FILE* config = fopen(filepath, "rb");
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return NULL;
+    }
+
+    size_t capacity = READ_BLOCK_SIZE;
+    char* data = (char*)malloc(capacity);
+    *length = 0;
+
+    size_t read;
+    while (data != NULL && (read = fread(data + *length, 1, capacity - *length, config)) > 0) {
+        *length += read;
+
+        // Grow buffer if it is full
+        if (*length == capacity) {
+            capacity *= 2;
+            char* grown = (char*)realloc(data, capacity);
+            if (grown == NULL) {
+                free(data);
+            }
+            data = grown;
+        }
+    }
+    fclose(config);
+
+    if (data == NULL) {
+        fprintf(stderr, "[ERROR] Bad buffer memory allocation\n");
         exit(1);
     }
 
-    return (short)t_size.ws_col;
-#endif
+    return data;
+}
+
+/**
+ * Get count of spaces in one tabulation
+ * by the first indented line of config
+ */
+static unsigned config_tab_length(const char* data, size_t length) {
+    size_t i = 0;
+
+    while (i < length) {
+        // Count spaces at the start of line
+        unsigned space_counter = 0;
+        while (i < length && data[i] == ' ') {
+            space_counter += 1;
+            i += 1;
+        }
+
+        // Indented line with token
+        if (space_counter > 0 && i < length && data[i] != '\n' && data[i] != '\r') {
+            return space_counter;
+        }
+
+        // Go to next line
+        const char* newline = (const char*)memchr(data + i, '\n', length - i);
+        if (newline == NULL) {
+            break;
+        }
+        i = (size_t)(newline - data) + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Get start of the first line not before position,
+ * which has token without indentation
+ */
+static size_t config_top_line(const char* data, size_t length, size_t position) {
+    // Go to the start of next line
+    const char* newline = (const char*)memchr(data + position, '\n', length - position);
+    if (newline == NULL) {
+        return length;
+    }
+    position = (size_t)(newline - data) + 1;
+
+    // Skip indented and empty lines
+    while (position < length && (data[position] == ' ' || data[position] == '\n' || data[position] == '\r')) {
+        newline = (const char*)memchr(data + position, '\n', length - position);
+        if (newline == NULL) {
+            return length;
+        }
+        position = (size_t)(newline - data) + 1;
+    }
+
+    return position;
 }
 
-void clear_line() {
-#if defined(OS_WINDOWS)
-    // Get current terminal width
-    short width = terminal_width();
-    if (width < 1) {
-        fprintf(stderr, "[ERROR] Size of terminal is too small\n");
-        exit(1);
-    }
+/**
+ * Part of config parsed by one thread
+ * into its own tree
+ */
+struct tree_chunk {
+    const char* data;
+    size_t length;
+    unsigned tab_length;
+    Tree* tree;
+    int error;
+};
+typedef struct tree_chunk TreeChunk;
 
-    // Create long empty string
-    char* empty = (char*)malloc(sizeof(char) * width);
-    memset(empty, ' ', width);
-    empty[width - 1] = '\0';
+static void tree_chunk_parse(void* arg) {
+    TreeChunk* chunk = (TreeChunk*)arg;
 
-    // Clear line
-    printf("\r%s\r", empty);
+    Parser parser;
+    parser_init(&parser, chunk->tree);
 
-    // Free line
-    free(empty);
-#elif defined(OS_UNIX)
-    printf("\033[2K\r");
-#endif
-}
+    // Errors are printed by serial parsing
+    // with correct line numbers
+    parser.quiet = 1;
+    parser.tab_length = chunk->tab_length;
 
-void set_cursor_x(short x) {
-#if defined(OS_WINDOWS)
-    HANDLE h_console = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (h_console == NULL) {
-        fprintf(stderr, "[ERROR] Couldn't handle terminal\n");
-        exit(1);
+    chunk->error = parser_feed(&parser, chunk->data, chunk->length);
+    if (!chunk->error) {
+        chunk->error = parser_finish(&parser);
     }
 
-    // Create position
-    COORD xy;
-    xy.X = x - 1;
-    xy.Y = get_cursor_y();
+    parser_free(&parser);
+}
 
-    // Set cursor position
-    if (SetConsoleCursorPosition(h_console, xy) == 0) {
-        fprintf(stderr, "[ERROR] Couldn't set terminal cursor position\n");
+Tree* tree_create_parallel(const char* filepath, unsigned threads) {
+    size_t length;
+    char* data = tree_read_file(filepath, &length);
+    if (data == NULL) {
         exit(1);
     }
-#elif defined(OS_UNIX)
-    printf("\033[%d;%dH", get_cursor_y(), x);
-#endif
-}
 
-short get_cursor_y() {
-#if defined(OS_WINDOWS)
-    HANDLE h_console = GetStdHandle(STD_OUTPUT_HANDLE);
-    if (h_console == NULL) {
-        fprintf(stderr, "[ERROR] Couldn't handle terminal\n");
+    // Check for empty config file
+    if (length == 0) {
+        fprintf(stderr, "[ERROR] Config from %s is empty\n", filepath);
+        free(data);
         exit(1);
     }
 
-    // Get terminal info
-    CONSOLE_SCREEN_BUFFER_INFO console_info;
-    if (GetConsoleScreenBufferInfo(h_console, &console_info) == 0) {
-        fprintf(stderr, "[ERROR] Couldn't get terminal Y position\n");
+    threads = MAX_OF(threads, 1);
+
+    TreeChunk* chunks = (TreeChunk*)malloc(sizeof(TreeChunk) * threads);
+    Thread* handles = (Thread*)malloc(sizeof(Thread) * threads);
+    if (chunks == NULL || handles == NULL) {
+        fprintf(stderr, "[ERROR] Bad chunks memory allocation\n");
         exit(1);
     }
 
-    // Return Y position
-    return console_info.dwCursorPosition.Y;
-#elif defined(OS_UNIX)
-    struct termios old_attr, new_attr;
-    char ch, buf[30] = {0};
-    int i = 0, pow = 1, y = 0;
+    // Split config by tokens without indentation,
+    // so each chunk contains independent subtrees
+    unsigned tab_length = config_tab_length(data, length);
+    size_t start = 0;
+    for (unsigned i = 0; i < threads; i++) {
+        size_t end = length;
+        if (i + 1 < threads) {
+            end = config_top_line(data, length, MAX_OF(start, length / threads * (i + 1)));
+        }
 
-    // Backup terminal attributes
-    if (tcgetattr(STDIN_FILENO, &new_attr) == -1) {
-        fprintf(stderr, "[ERROR] Couldn't get terminal attributes\n");
-        exit(1);
+        chunks[i].data = data + start;
+        chunks[i].length = end - start;
+        chunks[i].tab_length = tab_length;
+        chunks[i].tree = tree_alloc();
+        chunks[i].error = 0;
+        start = end;
     }
 
-    // Disable echo
-    old_attr = new_attr;
-    old_attr.c_lflag &= ~(ICANON | ECHO);
-    if (tcsetattr(STDIN_FILENO, TCSANOW, &old_attr) == -1) {
-        fprintf(stderr, "[ERROR] Couldn't set terminal attributes\n");
-        exit(1);
+    // Parse chunks in threads, the first
+    // chunk is parsed by current thread
+    for (unsigned i = 1; i < threads; i++) {
+        if (thread_create(&handles[i], tree_chunk_parse, &chunks[i]) != 0) {
+            fprintf(stderr, "[ERROR] Can't start parsing thread\n");
+            exit(1);
+        }
+    }
+    tree_chunk_parse(&chunks[0]);
+    for (unsigned i = 1; i < threads; i++) {
+        thread_join(handles[i]);
     }
 
-    // Get info about cursor
-    if (write(STDOUT_FILENO, "\033[6n", 4) != 4) {
-        fprintf(stderr, "[ERROR] Couldn't get cursor information\n");
-        exit(1);
+    int error = 0;
+    for (unsigned i = 0; i < threads; i++) {
+        error |= chunks[i].error;
     }
 
-    // Get ^[[{this};1R value
+    // Parse serially to print error with line number,
+    // it exits on error, so tree is returned only if
+    // config is correct and chunks were split badly
+    if (error) {
+        for (unsigned i = 0; i < threads; i++) {
+            tree_free(chunks[i].tree);
+        }
+        free(chunks);
+        free(handles);
 
-    for (ch = 0; ch != 'R'; i++) {
-        if (read(STDIN_FILENO, &ch, 1) != 1) {
-            fprintf(stderr, "[ERROR] Couldn't read cursor information");
-            exit(1);
+        Tree* tree = tree_create_from_buffer(data, length);
+        free(data);
+
+        return tree;
+    }
+
+    // Stitch subtrees of chunks under the first tree
+    Tree* tree = chunks[0].tree;
+    for (unsigned i = 1; i < threads; i++) {
+        Tree* chunk_tree = chunks[i].tree;
+        Node* head = chunk_tree->head;
+
+        Node** children = node_list_data(&head->children);
+        for (unsigned j = 0; j < head->children.length; j++) {
+            node_list_push(&tree->head->children, tree->arena, children[j]);
         }
-        buf[i] = ch;
+
+        // Strings of chunk pool stay in merged arena
+        arena_merge(tree->arena, chunk_tree->arena);
+        pool_free(chunk_tree->pool);
+        free(chunk_tree);
     }
 
-    i -= 2;
-    while (buf[i] != ';') {
-        i -= 1;
+    // Remove temporary variables
+    free(chunks);
+    free(handles);
+    free(data);
+
+    // Compile tree for predictions
+    tree_finalize(tree);
+
+    // Return tree
+    return tree;
+}
+
+/**
+ * Get hash of edge between parent and child by
+ * address of parent and content of child token,
+ * tokens of tree may come from several pools
+ */
+static unsigned tree_edge_hash(const Node* parent, const char* token, unsigned token_length) {
+    uintptr_t hash = (uintptr_t)parent;
+    hash ^= hash >> 17;
+    hash *= 0x9E3779B1u;
+
+    return (unsigned)hash ^ pool_hash(token, token_length);
+}
+
+/**
+ * Add edge to the index of edges
+ * without checking load factor
+ */
+static void tree_edge_put(TreeEdge* edges, unsigned capacity, Node* parent, Node* child, unsigned hash) {
+    unsigned i = hash & (capacity - 1);
+    while (edges[i].parent != NULL) {
+        i = (i + 1) & (capacity - 1);
     }
 
-    i -= 1;
-    while (buf[i] != '[') {
-        y = y + (buf[i] - '0') * pow;
-        pow *= 10;
-        i -= 1;
+    edges[i].parent = parent;
+    edges[i].child = child;
+    edges[i].hash = hash;
+}
+
+/**
+ * Resize index of edges, all edges
+ * of the tree are added on the first call
+ */
+static void tree_edges_grow(Tree* tree) {
+    Vector* queue = NULL;
+    unsigned capacity = MAX_OF(tree->edge_capacity * 2, 1024);
+
+    // Collect nodes of the whole tree
+    // if index is not created yet
+    if (tree->edges == NULL) {
+        queue = vector_create(1);
+        vector_push(queue, tree->head);
+
+        for (unsigned i = 0; i < queue->length; i++) {
+            Node* n = (Node*)vector_get(queue, i);
+            Node** children = node_list_data(&n->children);
+            for (unsigned j = 0; j < n->children.length; j++) {
+                vector_push(queue, children[j]);
+            }
+        }
+
+        tree->edge_count = queue->length - 1;
+        while (tree->edge_count * 2 > capacity) {
+            capacity *= 2;
+        }
     }
 
-    // Reset attributes
-    if (tcsetattr(0, TCSANOW, &new_attr) == -1) {
-        fprintf(stderr, "[ERROR] Couldn't reset terminal attributes\n");
+    TreeEdge* edges = (TreeEdge*)calloc(capacity, sizeof(TreeEdge));
+    if (edges == NULL) {
+        fprintf(stderr, "[ERROR] Bad tree edges memory allocation\n");
         exit(1);
     }
 
-    return (short)y;
-#endif
+    if (queue != NULL) {
+        // Add edges of all collected nodes
+        for (unsigned i = 0; i < queue->length; i++) {
+            Node* n = (Node*)vector_get(queue, i);
+            Node** children = node_list_data(&n->children);
+            for (unsigned j = 0; j < n->children.length; j++) {
+                Node* child = children[j];
+                tree_edge_put(edges, capacity, n, child, tree_edge_hash(n, child->token, child->token_length));
+            }
+        }
+        vector_free(queue);
+    }
+    else {
+        // Move edges to the new table
+        for (unsigned i = 0; i < tree->edge_capacity; i++) {
+            if (tree->edges[i].parent != NULL) {
+                TreeEdge* edge = &tree->edges[i];
+                tree_edge_put(edges, capacity, edge->parent, edge->child, edge->hash);
+            }
+        }
+        free(tree->edges);
+    }
+
+    tree->edges = edges;
+    tree->edge_capacity = capacity;
 }
 
-Tree* tree_create(const char* filepath) {
-    int character; // Variable for reading char by char
+/**
+ * Find child of node by token
+ *
+ * @return Child node or NULL
+ */
+static Node* tree_edge_find(Tree* tree, Node* parent, const char* token, unsigned token_length, unsigned hash) {
+    unsigned i = hash & (tree->edge_capacity - 1);
+    while (tree->edges[i].parent != NULL) {
+        TreeEdge* edge = &tree->edges[i];
+        if (edge->parent == parent && edge->hash == hash && edge->child->token_length == token_length &&
+            memcmp(edge->child->token, token, token_length) == 0) {
+            return edge->child;
+        }
+        i = (i + 1) & (tree->edge_capacity - 1);
+    }
 
-    unsigned buff_length = 0;  // Max token length
-    unsigned buff_counter = 0; // Variable for getting max token length
+    return NULL;
+}
 
-    // Try open file for reading
-    FILE* config = fopen(filepath, "r");
-    if (config == NULL) {
-        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
-        exit(0);
+int tree_add_path(Tree* tree, const char* path) {
+    // Compiled trees can't be changed
+    if (tree->head == NULL) {
+        fprintf(stderr, "[ERROR] Can't add path to the frozen or compiled tree\n");
+        return 1;
     }
 
-    // Check for empty config file
-    character = fgetc(config);
-    if (character == EOF) {
-        fclose(config);
-        fprintf(stderr, "[ERROR] %s file is empty\n", filepath);
-        exit(0);
+    // Index edges for fast search of children
+    if (tree->edges == NULL) {
+        tree_edges_grow(tree);
     }
-    ungetc(character, config);
 
-    // Get max token length
-    while (character != EOF) {
-        buff_counter = 0;
+    Node* curr_node = tree->head;
 
-        while (character == ' ') {
-            character = fgetc(config);
+    for (unsigned i = 0; path[i] != '\0';) {
+        // Skip spaces between tokens
+        if (path[i] == ' ' || path[i] == '\t') {
+            i += 1;
+            continue;
         }
 
-        // Count length of new token
-        while (character != '\n' && character != '\r' && character != EOF) {
-            buff_counter += 1;
-            character = fgetc(config);
+        // Get length of current token
+        unsigned token_length = 0;
+        while (path[i + token_length] != '\0' && path[i + token_length] != ' ' && path[i + token_length] != '\t') {
+            token_length += 1;
         }
 
-        // Update token length if we need
-        if (buff_counter > buff_length) {
-            // +1 for null terminated symbol
-            buff_length = buff_counter + 1;
+        // Find existing child or create new
+        const char* token = path + i;
+        unsigned hash = tree_edge_hash(curr_node, token, token_length);
+        Node* next_node = tree_edge_find(tree, curr_node, token, token_length, hash);
+
+        if (next_node == NULL) {
+            next_node = node_create(tree->arena, pool_intern(tree->pool, token, token_length), token_length);
+            node_list_push(&curr_node->children, tree->arena, next_node);
+
+            if (++tree->edge_count * 2 > tree->edge_capacity) {
+                tree_edges_grow(tree);
+            }
+            tree_edge_put(tree->edges, tree->edge_capacity, curr_node, next_node, hash);
+
+            // Compiled image is outdated
+            if (tree->image != NULL) {
+                image_free(tree->image);
+                tree->image = NULL;
+            }
         }
 
-        while (character != ' ' && character != EOF) {
-            character = fgetc(config);
+        curr_node = next_node;
+        i += token_length;
+    }
+
+    return 0;
+}
+
+void tree_brackets_mask(const char* brackets, uint32_t* mask) {
+    memset(mask, 0, sizeof(uint32_t) * TREE_BRACKET_WORDS);
+
+    for (unsigned i = 0; brackets[i] != '\0'; i++) {
+        unsigned char byte = (unsigned char)brackets[i];
+        mask[byte / 32] |= 1u << (byte % 32);
+    }
+}
+
+void tree_classify(const Image* image, const uint32_t* mask, uint8_t* flags) {
+    // Tokens are classified once, so predictions
+    // don't scan tokens of children for brackets
+    for (uint32_t i = 0; i < image->header->node_count; i++) {
+        const ImageNode* node = &image->nodes[i];
+        const unsigned char* token = (const unsigned char*)image_token(image, node);
+
+        flags[i] = 0;
+        for (uint32_t j = 0; j < node->token_length; j++) {
+            if (mask[token[j] / 32] & (1u << (token[j] % 32))) {
+                flags[i] = TREE_NODE_OPTIONAL;
+                break;
+            }
         }
     }
+}
 
-    // Create buffer for parsing
-    char* buff = (char*)malloc(sizeof(char) * buff_length);
-    if (buff == NULL) {
-        fprintf(stderr, "[ERROR] Bad buffer memory allocation\n");
-        fclose(config);
+/**
+ * Allocate flags of tree nodes by count
+ * of nodes of its image and classify them
+ *
+ * @param tree - Compiled tree with brackets
+ */
+static void tree_flags_create(Tree* tree) {
+    uint32_t count = tree->image->header->node_count;
+
+    tree->flags = (uint8_t*)malloc(count > 0 ? count : 1);
+    if (tree->flags == NULL) {
+        fprintf(stderr, "[ERROR] Bad flags memory allocation\n");
         exit(1);
     }
-    unsigned buff_i;
 
-    unsigned space_counter;       // Counter of spaces before token
-    unsigned tab_length = 0;      // Count of spaces in one tabulation
-    unsigned tab_count;           // Count of tabulations in line
-    unsigned line_counter = 0;    // Counter of lines in config file
+    tree_classify(tree->image, tree->brackets, tree->flags);
+}
 
-    // Initialize tree and tree head
-    Tree* tree = (Tree*)malloc(sizeof(Tree));
-    if (tree == NULL) {
-        fprintf(stderr, "[ERROR] Bad tree memory allocation\n");
-        fclose(config);
-        free(buff);
-        exit(1);
+void tree_finalize(Tree* tree) {
+    // Compile tree if it was changed
+    if (tree->image == NULL) {
+        tree->image = image_create(tree->head);
+        tree->revision += 1;
+
+        // Usage counts and flags are bound to nodes of image
+        free(tree->usage);
+        tree->usage = NULL;
+        tree->usage_capacity = 0;
+        tree->usage_count = 0;
+
+        // Tokens of new image are classified by the same brackets
+        if (tree->flags != NULL) {
+            free(tree->flags);
+            tree_flags_create(tree);
+        }
     }
-    tree->head = node_create("\0", 1);
+}
 
-    // Vector of root nodes for parsing
-    Vector* root_nodes = vector_create(1);
-    vector_push(root_nodes, (void*)tree->head);
+uint64_t tree_path(uint64_t path, uint32_t node) {
+    // Mix hash of parent path with index of child
+    uint64_t hash = path + 0x9E3779B97F4A7C15ull * ((uint64_t)node + 1);
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
 
-    // Set file cursor to the start
-    fseek(config, SEEK_SET, 0);
+    return hash != 0 ? hash : TREE_PATH_HEAD;
+}
 
-    int error = 0;  // Flag for error handling
+/**
+ * Get the first entry for probing
+ * path in usage table
+ */
+static unsigned tree_usage_slot(uint64_t path, unsigned capacity) {
+    return (unsigned)(path ^ (path >> 32)) & (capacity - 1);
+}
 
-    // Start parsing
-    character = fgetc(config);
-    while (character != EOF) {
-        line_counter += 1;
-        space_counter = 0;
-        buff_i = 0;
+uint32_t tree_usage_count(const TreeUsage* usage, unsigned capacity, uint64_t path) {
+    if (usage == NULL) {
+        return 0;
+    }
 
-        // Don't use tab character!!!
-        if (character == '\t') {
-            fprintf(stderr, "[ERROR] Tab character detected in line %d, use a sequence of spaces\n", line_counter);
-            error = 1;
-            break;
+    // Probe entries until path or empty entry is found
+    for (unsigned i = tree_usage_slot(path, capacity); usage[i].path != 0; i = (i + 1) & (capacity - 1)) {
+        if (usage[i].path == path) {
+            return usage[i].count;
         }
+    }
 
-        // Get space count
-        while (character == ' ') {
-            space_counter += 1;
-            character = fgetc(config);
-        }
+    return 0;
+}
 
-        // Init correct tab length
-        if (space_counter > tab_length && tab_length == 0) {
-            tab_length = space_counter;
+/**
+ * Find entry of path in usage table or create
+ * it, table grows twice when it becomes half full
+ *
+ * @param tree - Tree with usage table
+ * @param path - Hash of path to node
+ *
+ * @return Pointer to usage count of path
+ */
+static uint32_t* tree_usage_put(Tree* tree, uint64_t path) {
+    if ((tree->usage_count + 1) * 2 > tree->usage_capacity) {
+        unsigned capacity = tree->usage_capacity > 0 ? tree->usage_capacity * 2 : 64;
+        TreeUsage* usage = (TreeUsage*)calloc(capacity, sizeof(TreeUsage));
+        if (usage == NULL) {
+            fprintf(stderr, "[ERROR] Bad usage memory allocation\n");
+            exit(1);
         }
 
-        // Check count of spaces for correctness
-        if (space_counter % MAX_OF(tab_length, 1) != 0) {
-            fprintf(stderr, "[ERROR] Incorrect tab length in line %d\n", line_counter);
-            error = 1;
-            break;
+        // Move entries to their places in new table
+        for (unsigned i = 0; i < tree->usage_capacity; i++) {
+            if (tree->usage[i].path != 0) {
+                unsigned j = tree_usage_slot(tree->usage[i].path, capacity);
+                while (usage[j].path != 0) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                usage[j] = tree->usage[i];
+            }
         }
 
-        // Get tabulations count;
-        tab_count = space_counter / MAX_OF(tab_length, 1);
+        free(tree->usage);
+        tree->usage = usage;
+        tree->usage_capacity = capacity;
+    }
 
-        // Get token
-        while (character != '\n' && character != '\r' && character != EOF) {
-            // Handle space symbol in token error
-            if (character == ' ' || character == '\t') {
-                error = 1;
-                break;
-            }
+    unsigned i = tree_usage_slot(path, tree->usage_capacity);
+    while (tree->usage[i].path != 0 && tree->usage[i].path != path) {
+        i = (i + 1) & (tree->usage_capacity - 1);
+    }
 
-            buff[buff_i++] = (char)character;
-            character = fgetc(config);
-        }
+    if (tree->usage[i].path == 0) {
+        tree->usage[i].path = path;
+        tree->usage_count += 1;
+    }
 
-        // Handle error when getting token
-        if (error) {
-            fprintf(stderr, "[ERROR] Token in config file must not have spaces, line %d\n", line_counter);
-            break;
-        }
+    return &tree->usage[i].count;
+}
 
-        buff[buff_i] = '\0';
+void tree_learn(Tree* tree, const char* input) {
+    tree_finalize(tree);
 
-        // Create node by token
-        Node* n = node_create(buff, buff_length);
+    // Ranks of predictions are changed
+    tree->learned += 1;
 
-        // Push node to tree
-        if (tab_count >= root_nodes->length) {
-            fprintf(stderr, "[ERROR] The token on line %d does not belong to any token\n", line_counter);
-            error = 1;
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, input, (unsigned)strlen(input), 0);
+
+    // Count paths of all tokens like predictions
+    // find them, until unknown token is found
+    Query query;
+    query_start(&query, tree);
+
+    char buffer[TOKEN_TEXT_SIZE];
+    int complete = 1;
+    while (complete) {
+        TokenSpan span;
+        complete = tokenizer_next(&tokenizer, &span);
+
+        if (span.length == 0 || !query_descend_span(&query, input, &span, buffer)) {
             break;
         }
-        vector_push(((Node*)vector_get(root_nodes, tab_count))->children, (void*)n);
 
-        // Add token to root tokens vector by index as tab count
-        if (tab_count + 1 < root_nodes->length) {
-            vector_set(root_nodes, tab_count + 1, n);
-        }
-        else if (tab_count + 1 == root_nodes->length) {
-            vector_push(root_nodes, (void*)n);
-        }
+        uint32_t* count = tree_usage_put(tree, query.path);
+        *count += *count < TREE_MAX_USAGE;
+    }
+}
 
-        // Go to next line
-        while (character != ' ' && character != EOF) {
-            character = fgetc(config);
+void tree_set_brackets(Tree* tree, const char* brackets) {
+    tree_finalize(tree);
+
+    uint32_t mask[TREE_BRACKET_WORDS];
+    tree_brackets_mask(brackets, mask);
+
+    // Flags are kept while brackets are the same
+    if (tree->flags != NULL && memcmp(mask, tree->brackets, sizeof(mask)) == 0) {
+        return;
+    }
+
+    memcpy(tree->brackets, mask, sizeof(mask));
+    free(tree->flags);
+    tree_flags_create(tree);
+}
+
+void tree_shrink(Tree* tree) {
+    // Compiled trees have no nodes
+    if (tree->head == NULL) {
+        return;
+    }
+
+    Arena* arena = arena_create();
+    Pool* pool = pool_create(arena);
+    Node* head = node_create(arena, pool_intern(pool, tree->head->token, tree->head->token_length),
+                             tree->head->token_length);
+
+    // Copy nodes in breadth-first order,
+    // pairs of old and new nodes are queued
+    Vector* queue = vector_create(2);
+    vector_push(queue, tree->head);
+    vector_push(queue, head);
+
+    for (unsigned i = 0; i < queue->length; i += 2) {
+        Node* old_node = (Node*)vector_get(queue, i);
+        Node* new_node = (Node*)vector_get(queue, i + 1);
+        Node** children = node_list_data(&old_node->children);
+
+        node_list_reserve(&new_node->children, arena, old_node->children.length);
+        for (unsigned j = 0; j < old_node->children.length; j++) {
+            Node* child = node_create(arena, pool_intern(pool, children[j]->token, children[j]->token_length),
+                                      children[j]->token_length);
+            child->weight = children[j]->weight;
+            node_list_push(&new_node->children, arena, child);
+
+            vector_push(queue, children[j]);
+            vector_push(queue, child);
         }
     }
+    vector_free(queue);
+
+    // Replace old memory, index of
+    // edges is rebuilt on demand
+    pool_free(tree->pool);
+    arena_free(tree->arena);
+    free(tree->edges);
+
+    tree->head = head;
+    tree->arena = arena;
+    tree->pool = pool;
+    tree->edges = NULL;
+    tree->edge_capacity = 0;
+    tree->edge_count = 0;
+}
 
-    // Remove temporary variables
-    fclose(config);
-    vector_free(root_nodes);
-    free(buff);
+void tree_freeze(Tree* tree) {
+    tree_finalize(tree);
 
-    // Free tree and exit if error
-    if (error) {
-        tree_free(tree);
+    // Nodes are not needed for predictions
+    if (tree->arena != NULL) {
+        pool_free(tree->pool);
+        arena_free(tree->arena);
+    }
+    free(tree->edges);
+
+    tree->head = NULL;
+    tree->arena = NULL;
+    tree->pool = NULL;
+    tree->edges = NULL;
+    tree->edge_capacity = 0;
+    tree->edge_count = 0;
+}
+
+int tree_compile(const char* text_path, const char* bin_path) {
+    Tree* tree = tree_create(text_path);
+
+    // Compiled image is written as is
+    int error = image_save(tree->image, bin_path);
+
+    tree_free(tree);
+
+    return error;
+}
+
+Tree* tree_load_binary(const char* filepath) {
+    Image* image = image_load(filepath);
+    if (image == NULL) {
         exit(1);
     }
 
-    // Return tree
+    // Initialize tree with image only
+    Tree* tree = (Tree*)malloc(sizeof(Tree));
+    if (tree == NULL) {
+        fprintf(stderr, "[ERROR] Bad tree memory allocation\n");
+        exit(1);
+    }
+    tree->head = NULL;
+    tree->arena = NULL;
+    tree->pool = NULL;
+    tree->image = image;
+    tree->revision = 1;
+    tree->learned = 0;
+    tree->usage = NULL;
+    tree->usage_capacity = 0;
+    tree->usage_count = 0;
+    tree->flags = NULL;
+    memset(tree->brackets, 0, sizeof(tree->brackets));
+    tree->edges = NULL;
+    tree->edge_capacity = 0;
+    tree->edge_count = 0;
+
     return tree;
 }
 
 void tree_free(Tree* t) {
-    // Free all nodes from the head and self
-    node_free(t->head);
+    // Free compiled image
+    if (t->image != NULL) {
+        image_free(t->image);
+    }
+
+    // Free all nodes and tokens at once by
+    // arena blocks, then pool table and self
+    if (t->arena != NULL) {
+        pool_free(t->pool);
+        arena_free(t->arena);
+    }
+    free(t->edges);
+    free(t->usage);
+    free(t->flags);
     free(t);
 }
 
+#include <stdlib.h>
+#include <stdio.h>
+
 Vector* vector_create(unsigned length) {
     // Allocate memory for self
     Vector* vec = (Vector*)malloc(sizeof(Vector));
@@ -1194,7 +6861,7 @@ Vector* vector_create(unsigned length) {
     vec->capacity = MAX_OF(length, 1);
 
     // Allocate memory for data field
-    vec->data = (void**)malloc(sizeof(void*) * length);
+    vec->data = (void**)malloc(sizeof(void*) * vec->capacity);
     if (vec->data == NULL) {
         fprintf(stderr, "[ERROR] Bad vector memory allocation\n");
         exit(1);
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/arena.h"
+
+// Size of the first block of arena
+#define ARENA_FIRST_BLOCK_SIZE (64 * 1024)
+
+// Size after which blocks stop growing
+#define ARENA_MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+// Space for pointer to previous block
+#define ARENA_BLOCK_HEADER ARENA_ALIGNMENT
+
+Arena* arena_create() {
+    // Allocate memory for self
+    Arena* arena = (Arena*)malloc(sizeof(Arena));
+    if (arena == NULL) {
+        fprintf(stderr, "[ERROR] Bad arena memory allocation\n");
+        exit(1);
+    }
+
+    // First block is allocated on demand
+    arena->block = NULL;
+    arena->used = 0;
+    arena->size = 0;
+
+    return arena;
+}
+
+void* arena_alloc(Arena* arena, size_t size, size_t alignment) {
+    size_t offset = (arena->used + alignment - 1) & ~(alignment - 1);
+
+    // Use new block if current block runs out
+    if (arena->block == NULL || offset + size > arena->size) {
+        size_t block_size = ARENA_FIRST_BLOCK_SIZE;
+        if (arena->size != 0) {
+            block_size = arena->size < ARENA_MAX_BLOCK_SIZE ? arena->size * 2 : arena->size;
+        }
+        if (size + ARENA_BLOCK_HEADER > block_size) {
+            block_size = size + ARENA_BLOCK_HEADER;
+        }
+
+        char* block = (char*)malloc(block_size);
+        if (block == NULL) {
+            fprintf(stderr, "[ERROR] Bad arena block memory allocation\n");
+            exit(1);
+        }
+
+        memcpy(block, &arena->block, sizeof(char*));
+        arena->block = block;
+        arena->size = block_size;
+        offset = ARENA_BLOCK_HEADER;
+    }
+
+    arena->used = offset + size;
+
+    return arena->block + offset;
+}
+
+void arena_merge(Arena* arena, Arena* other) {
+    if (other->block != NULL) {
+        // Find the first block of other arena
+        char* first = other->block;
+        char* prev;
+        memcpy(&prev, first, sizeof(char*));
+        while (prev != NULL) {
+            first = prev;
+            memcpy(&prev, first, sizeof(char*));
+        }
+
+        // Insert blocks of other arena before
+        // current block, which is still used
+        if (arena->block != NULL) {
+            memcpy(&prev, arena->block, sizeof(char*));
+            memcpy(first, &prev, sizeof(char*));
+            memcpy(arena->block, &other->block, sizeof(char*));
+        }
+        else {
+            arena->block = other->block;
+            arena->used = other->used;
+            arena->size = other->size;
+        }
+    }
+
+    // Free self of other arena
+    free(other);
+}
+
+void arena_free(Arena* arena) {
+    // Free all blocks from the last
+    while (arena->block != NULL) {
+        char* prev;
+        memcpy(&prev, arena->block, sizeof(char*));
+        free(arena->block);
+        arena->block = prev;
+    }
+
+    // Free self
+    free(arena);
+}
@@ -1,5 +1,6 @@
 #include "../include/autocomplete.h"
 #include "../include/predictions.h"
+#include "../include/session.h"
 
 char* custom_input(Tree* rules, char* title, COLOR_TYPE title_color, COLOR_TYPE predict_color,
                    COLOR_TYPE main_color, char* optional_brackets) {
@@ -21,36 +22,67 @@ char* custom_input(Tree* rules, char* title, COLOR_TYPE title_color, COLOR_TYPE
     // Calculate title length
     int title_len = (short)strlen(title);
 
+    // Session remembers nodes of entered tokens
+    Session* session = session_create(rules, optional_brackets);
+
+    // Predictions are borrowed from the tree, memory
+    // for them grows only if there are more predictions
+    unsigned views_cap = 16;
+    PredictionView* views = (PredictionView*)malloc(views_cap * sizeof(PredictionView));
+    if (views == NULL) {
+        fprintf(stderr, "[ERROR] Couldn't allocate memory for predictions\n");
+        exit(1);
+    }
+    PredictionList pred;
+    prediction_list_init(&pred, views, views_cap);
+
     while (1) {
         // Print title with title color
         clear_line();
         color_print(title, title_color);
         printf(title_len != 0 ? " " : "");
 
-        // Get length of last word in input
-        short space_offset = 0;
-        while ((buff_len - space_offset) != 0 && buff[buff_len - space_offset - 1] != ' ') {
-            space_offset += 1;
-        }
+        // Get last word in input as it is typed,
+        // predictions are completed from it
+        Tokenizer tokenizer;
+        TokenSpan last;
+        tokenizer_init(&tokenizer, buff, (unsigned)buff_len, 0);
+        while (tokenizer_next(&tokenizer, &last)) {}
+
+        unsigned last_length = last.length;
+        short space_offset = (short)last.length;
 
         // Print current buffer
         color_print(buff, main_color);
 
-        // Get predictions
-        Predictions* pred = predictions_create(rules, buff, optional_brackets);
+        // Get predictions, session caches them, so switching
+        // hints or redrawing doesn't find them again
+        session_find(session, buff, &pred);
+
+        // Grow memory and find again if not all predictions were written
+        if (pred.total > pred.capacity) {
+            views_cap = pred.total;
+            views = (PredictionView*)realloc(views, views_cap * sizeof(PredictionView));
+            if (views == NULL) {
+                fprintf(stderr, "[ERROR] Couldn't allocate memory for predictions\n");
+                exit(1);
+            }
+            prediction_list_init(&pred, views, views_cap);
+            session_find(session, buff, &pred);
+        }
 
         // Print prediction by hint_num with color
-        if (pred->type != FAILURE) {
-            char* prediction = (char*)vector_get(pred->tokens, hint_num % pred->tokens->length);
+        if (pred.type != FAILURE) {
+            const char* prediction = pred.items[hint_num % pred.length].token;
 
             // Print info message before prediction
             // if prediction is probably
-            if (pred->type == PROBABLY) {
+            if (pred.type == PROBABLY) {
                 color_print("  maybe you mean: ", predict_color);
             }
 
             // Print trimmed or not trimmed prediction depending on the type
-            color_print(prediction + (pred->type == EXACTLY) * space_offset, predict_color);
+            color_print((char*)prediction + (pred.type == EXACTLY) * last_length, predict_color);
         }
 
         // Move cursor to buffer end
@@ -67,15 +99,14 @@ char* custom_input(Tree* rules, char* title, COLOR_TYPE title_color, COLOR_TYPE
 
         // Return buffer if ENTER was pressed
         else if (ch == ENTER) {
-            // Free predictions and break
-            predictions_free(pred);
             break;
         }
 
         // Keyboard interrupt handler for Windows
         #if defined(OS_WINDOWS)
         else if (ch == CTRL_C) {
-            predictions_free(pred);
+            free(views);
+            session_free(session);
             tree_free(rules);
             free(buff);
             exit(0);
@@ -95,9 +126,9 @@ char* custom_input(Tree* rules, char* title, COLOR_TYPE title_color, COLOR_TYPE
 
         // Apply prediction if TAB was pressed
         else if (ch == TAB) {
-            if (pred->type != FAILURE) {
-                char* prediction = (char*)vector_get(pred->tokens, hint_num % pred->tokens->length);
-                unsigned predict_len = (unsigned int)strlen(prediction);
+            if (pred.type != FAILURE) {
+                const char* prediction = pred.items[hint_num % pred.length].token;
+                unsigned predict_len = pred.items[hint_num % pred.length].length;
 
                 // Make sure the candidate has no optional brackets
                 if (!contain_chars(prediction, optional_brackets)) {
@@ -180,11 +211,11 @@ char* custom_input(Tree* rules, char* title, COLOR_TYPE title_color, COLOR_TYPE
             hint_num = ch == SPACE ? 0 : hint_num;
             buff[buff_len++] = (char)ch;
         }
-
-        // Free predictions
-        predictions_free(pred);
     }
 
+    free(views);
+    session_free(session);
+
     return buff;
 }
 
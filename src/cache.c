@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/cache.h"
+
+void cache_init(Cache* cache) {
+    for (unsigned i = 0; i < CACHE_SIZE; i++) {
+        cache->entries[i].items = NULL;
+        cache->entries[i].capacity = 0;
+        cache->entries[i].used = 0;
+    }
+    cache->clock = 0;
+}
+
+static int cache_match(const CacheEntry* entry, const CacheKey* key) {
+    return entry->used != 0 && entry->node == key->node && entry->path == key->path &&
+           entry->length == key->length && entry->revision == key->revision && entry->learned == key->learned &&
+           entry->distance == key->distance && memcmp(entry->prefix, key->prefix, key->length) == 0;
+}
+
+int cache_find(Cache* cache, const CacheKey* key, PredictionList* list) {
+    for (unsigned i = 0; i < CACHE_SIZE; i++) {
+        CacheEntry* entry = &cache->entries[i];
+        if (!cache_match(entry, key)) {
+            continue;
+        }
+
+        // The best predictions are the first of all
+        // predictions, so fewer of them are known
+        if (entry->count < entry->total && entry->count < list->capacity) {
+            return 0;
+        }
+
+        list->length = list->capacity < entry->count ? list->capacity : entry->count;
+        if (list->length > 0) {
+            memcpy(list->items, entry->items, sizeof(PredictionView) * list->length);
+        }
+        list->total = entry->total;
+        list->ranked = entry->ranked;
+        list->type = entry->type;
+
+        cache->clock += 1;
+        entry->used = cache->clock;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+void cache_store(Cache* cache, const CacheKey* key, const PredictionList* list) {
+    // Text of longer tokens isn't found
+    if (key->length >= TOKEN_TEXT_SIZE) {
+        return;
+    }
+
+    // Replace entry of the same key or
+    // the least recently used entry
+    CacheEntry* entry = &cache->entries[0];
+    for (unsigned i = 0; i < CACHE_SIZE; i++) {
+        if (cache_match(&cache->entries[i], key)) {
+            entry = &cache->entries[i];
+            break;
+        }
+        if (cache->entries[i].used < entry->used) {
+            entry = &cache->entries[i];
+        }
+    }
+
+    // Reallocate longer memory if capacity runs out
+    if (list->length > entry->capacity) {
+        entry->capacity = list->length;
+        entry->items = (PredictionView*)realloc(entry->items, sizeof(PredictionView) * entry->capacity);
+        if (entry->items == NULL) {
+            fprintf(stderr, "[ERROR] Bad cache memory reallocation\n");
+            exit(1);
+        }
+    }
+
+    entry->node = key->node;
+    entry->path = key->path;
+    entry->revision = key->revision;
+    entry->learned = key->learned;
+    entry->distance = key->distance;
+    memcpy(entry->prefix, key->prefix, key->length);
+    entry->length = key->length;
+
+    if (list->length > 0) {
+        memcpy(entry->items, list->items, sizeof(PredictionView) * list->length);
+    }
+    entry->count = list->length;
+    entry->total = list->total;
+    entry->ranked = list->ranked;
+    entry->type = list->type;
+
+    cache->clock += 1;
+    entry->used = cache->clock;
+}
+
+void cache_free(Cache* cache) {
+    // Free predictions of all entries
+    for (unsigned i = 0; i < CACHE_SIZE; i++) {
+        free(cache->entries[i].items);
+        cache->entries[i].items = NULL;
+        cache->entries[i].capacity = 0;
+        cache->entries[i].used = 0;
+    }
+}
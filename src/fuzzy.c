@@ -0,0 +1,127 @@
+#include <string.h>
+
+#include "../include/fuzzy.h"
+
+/**
+ * Check if column of distance matrix after j characters
+ * of text has cell not greater than distance, otherwise
+ * longer prefixes of text never match, only cells near
+ * diagonal may be small enough, so cells are checked
+ * from the top of diagonal band
+ */
+static int fuzzy_alive(const Fuzzy* fuzzy, const FuzzyState* state, unsigned j) {
+    unsigned k = fuzzy->distance;
+    unsigned row = j > k ? j - k : 0;
+    unsigned last = j + k < fuzzy->length ? j + k : fuzzy->length;
+    unsigned cell = state->band;
+
+    if (row > fuzzy->length) {
+        return 0;
+    }
+
+    // Go down by vertical differences
+    while (cell > k && row < last) {
+        cell = cell + ((state->vp >> row) & 1) - ((state->vn >> row) & 1);
+        row += 1;
+    }
+
+    return cell <= k;
+}
+
+void fuzzy_init(Fuzzy* fuzzy, const char* pattern, unsigned length, unsigned distance) {
+    if (length > FUZZY_MAX_LENGTH) {
+        length = FUZZY_MAX_LENGTH;
+    }
+
+    // Set bits of pattern positions for each character
+    memset(fuzzy->peq, 0, sizeof(fuzzy->peq));
+    for (unsigned i = 0; i < length; i++) {
+        fuzzy->peq[(unsigned char)pattern[i]] |= (uint64_t)1 << i;
+    }
+
+    fuzzy->length = length;
+    fuzzy->distance = distance < FUZZY_MAX_DISTANCE ? distance : FUZZY_MAX_DISTANCE;
+    fuzzy->text = NULL;
+    fuzzy->depth = 0;
+    fuzzy->dead = 0;
+
+    // The first column is distance of pattern
+    // prefixes and empty text, it grows by one
+    FuzzyState* state = &fuzzy->states[0];
+    state->vp = ~(uint64_t)0;
+    state->vn = 0;
+    state->d0 = 0;
+    state->pm = 0;
+    state->score = length;
+    state->best = length;
+    state->band = 0;
+    state->alive = 1;
+}
+
+int fuzzy_match(Fuzzy* fuzzy, const char* text, unsigned length) {
+    // Longer prefixes of text are farther from pattern
+    unsigned limit = fuzzy->length + fuzzy->distance;
+    if (length < limit) {
+        limit = length;
+    }
+
+    // Reuse columns of prefix which is common with the previous text
+    unsigned j = 0;
+    while (j < fuzzy->depth && j < limit && fuzzy->text[j] == text[j]) {
+        j += 1;
+    }
+
+    uint64_t high = fuzzy->length > 0 ? (uint64_t)1 << (fuzzy->length - 1) : 0;
+    FuzzyState* state = &fuzzy->states[j];
+
+    while (state->best > fuzzy->distance && state->alive && j < limit) {
+        FuzzyState* next = state + 1;
+        uint64_t pm = fuzzy->peq[(unsigned char)text[j]];
+
+        // Diagonal is zero on match, by vertical difference
+        // or by transposition of this and previous characters
+        uint64_t tr = (((~state->d0) & pm) << 1) & state->pm;
+        uint64_t d0 = (((pm & state->vp) + state->vp) ^ state->vp) | pm | state->vn | tr;
+        uint64_t hp = state->vn | ~(d0 | state->vp);
+        uint64_t hn = state->vp & d0;
+
+        // Distance of the whole pattern is in the last row
+        next->score = state->score + ((hp & high) != 0) - ((hn & high) != 0);
+        next->best = next->score < state->best ? next->score : state->best;
+
+        // Row of empty pattern grows by one
+        hp = (hp << 1) | 1;
+        hn = hn << 1;
+        next->vp = hn | ~(d0 | hp);
+        next->vn = hp & d0;
+        next->d0 = d0;
+        next->pm = pm;
+
+        // Top of band moves by diagonal
+        // difference or stays in empty pattern row
+        if (j < fuzzy->distance) {
+            next->band = j + 1;
+        }
+        else {
+            unsigned row = j - fuzzy->distance;
+            next->band = state->band + (row >= fuzzy->length || !((d0 >> row) & 1));
+        }
+        next->alive = fuzzy_alive(fuzzy, next, j + 1);
+
+        state = next;
+        j += 1;
+    }
+
+    fuzzy->text = text;
+    fuzzy->depth = j;
+
+    if (state->best <= fuzzy->distance) {
+        fuzzy->dead = 0;
+        return 1;
+    }
+
+    // Prefixes longer than limit are not
+    // compared, so they never match too
+    fuzzy->dead = !state->alive || j == fuzzy->length + fuzzy->distance ? j : 0;
+    return 0;
+}
@@ -0,0 +1,1295 @@
+#ifdef _MSC_VER
+    #ifndef _CRT_SECURE_NO_WARNINGS
+        #define _CRT_SECURE_NO_WARNINGS
+    #endif
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/image.h"
+#include "../include/pool.h"
+#include "../include/thread.h"
+#include "../include/vector.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define IMAGE_SSE2
+    #include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+// AVX2 code is compiled for x86-64 and
+// used only if processor supports it
+#if defined(IMAGE_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define IMAGE_AVX2
+    #define IMAGE_TARGET_AVX2 __attribute__((target("avx2")))
+    #include <immintrin.h>
+#elif defined(IMAGE_SSE2) && defined(_MSC_VER) && defined(_M_X64)
+    #define IMAGE_AVX2
+    #define IMAGE_TARGET_AVX2
+    #include <immintrin.h>
+#endif
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #define IMAGE_READ
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+/**
+ * Entry of map from token
+ * to offset in tokens blob
+ */
+struct image_token_entry {
+    const char* token;
+    unsigned length;
+    uint32_t offset;
+};
+typedef struct image_token_entry ImageTokenEntry;
+
+/**
+ * Offsets of image sections from the start of image
+ */
+struct image_layout {
+    size_t nodes;
+    size_t radix;
+    size_t roots;
+    size_t weights;
+    size_t keys;
+    size_t symbols;
+    size_t tokens;
+    size_t size;
+};
+typedef struct image_layout ImageLayout;
+
+/**
+ * Get offsets of sections by counts from header
+ */
+static ImageLayout image_layout(const ImageHeader* header) {
+    ImageLayout layout;
+
+    layout.nodes = sizeof(ImageHeader);
+    layout.radix = layout.nodes + sizeof(ImageNode) * (size_t)header->node_count;
+    layout.roots = layout.radix + sizeof(ImageRadix) * (size_t)header->radix_count;
+    layout.weights = layout.roots + sizeof(ImageRadixRoot) * (size_t)header->root_count;
+    layout.keys = layout.weights + sizeof(uint32_t) * (size_t)header->node_count;
+
+    // Keys are padded for reading by 16 bytes
+    layout.symbols = layout.keys + (((size_t)header->node_count + IMAGE_KEY_PADDING + 3) & ~(size_t)3);
+    layout.tokens = layout.symbols + (((size_t)header->node_count + 3) & ~(size_t)3);
+    layout.size = layout.tokens + header->token_size;
+
+    return layout;
+}
+
+/**
+ * Setup pointers to sections of image data
+ */
+static void image_setup(Image* image) {
+    ImageLayout layout = image_layout((const ImageHeader*)image->data);
+
+    image->header = (const ImageHeader*)image->data;
+    image->nodes = (const ImageNode*)((char*)image->data + layout.nodes);
+    image->radix = (const ImageRadix*)((char*)image->data + layout.radix);
+    image->roots = (const ImageRadixRoot*)((char*)image->data + layout.roots);
+    image->weights = (const uint32_t*)((char*)image->data + layout.weights);
+    image->keys = (const uint8_t*)image->data + layout.keys;
+    image->symbols = (const uint8_t*)image->data + layout.symbols;
+    image->tokens = (const char*)image->data + layout.tokens;
+}
+
+static uint32_t image_checksum(const void* data, size_t size) {
+    // FNV-1a hash function by 32-bit words,
+    // size of data is always aligned to 4 bytes
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < size; i += 4) {
+        uint32_t word;
+        memcpy(&word, bytes + i, 4);
+        hash = (hash ^ word) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32_t image_token_offset(ImageTokenEntry* entries, unsigned capacity, const char* token,
+                                   unsigned token_length, uint32_t* token_size, unsigned* length) {
+    // Tokens may come from several pools,
+    // so they are compared by content
+    unsigned i = pool_hash(token, token_length) & (capacity - 1);
+    while (entries[i].token != NULL) {
+        if (entries[i].token == token || (entries[i].length == token_length &&
+                                          memcmp(entries[i].token, token, token_length) == 0)) {
+            return entries[i].offset;
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+
+    // Reserve place in tokens blob
+    entries[i].token = token;
+    entries[i].length = token_length;
+    entries[i].offset = *token_size;
+    *token_size += token_length + 1;
+    *length += 1;
+
+    return entries[i].offset;
+}
+
+static int image_node_compare(const Node* a, const Node* b) {
+    unsigned length = a->token_length < b->token_length ? a->token_length : b->token_length;
+
+    int result = memcmp(a->token, b->token, length);
+    if (result != 0) {
+        return result;
+    }
+
+    return (int)a->token_length - (int)b->token_length;
+}
+
+/**
+ * Stable merge sort of nodes by tokens, equal
+ * tokens keep the order of config file
+ */
+static void image_sort_nodes(void** nodes, unsigned count, void** temp) {
+    if (count < 2) {
+        return;
+    }
+
+    unsigned middle = count / 2;
+    image_sort_nodes(nodes, middle, temp);
+    image_sort_nodes(nodes + middle, count - middle, temp);
+
+    // Merge sorted halves through temporary array
+    unsigned i = 0, j = middle, k = 0;
+    while (i < middle && j < count) {
+        if (image_node_compare((Node*)nodes[j], (Node*)nodes[i]) < 0) {
+            temp[k++] = nodes[j++];
+        }
+        else {
+            temp[k++] = nodes[i++];
+        }
+    }
+    while (i < middle) {
+        temp[k++] = nodes[i++];
+    }
+
+    memcpy(nodes, temp, sizeof(void*) * j);
+}
+
+/**
+ * Growable array of radix nodes and
+ * links to radix roots while building
+ */
+struct image_radix_list {
+    ImageRadix* radix;
+    uint32_t radix_count;
+    uint32_t radix_capacity;
+    ImageRadixRoot* roots;
+    uint32_t root_count;
+    uint32_t root_capacity;
+};
+typedef struct image_radix_list ImageRadixList;
+
+/**
+ * Reserve radix nodes at the end of list
+ *
+ * @return Index of the first reserved node
+ */
+static uint32_t image_radix_reserve(ImageRadixList* list, uint32_t count) {
+    if (list->radix_count + count > list->radix_capacity) {
+        while (list->radix_count + count > list->radix_capacity) {
+            list->radix_capacity = list->radix_capacity ? list->radix_capacity * 2 : 64;
+        }
+
+        list->radix = (ImageRadix*)realloc(list->radix, sizeof(ImageRadix) * list->radix_capacity);
+        if (list->radix == NULL) {
+            fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+            exit(1);
+        }
+    }
+
+    list->radix_count += count;
+    return list->radix_count - count;
+}
+
+/**
+ * Fill radix node covering sorted children
+ * which tokens have the same prefix of depth
+ *
+ * @param list - List of radix nodes
+ * @param index - Index of reserved radix node
+ * @param children - Sorted children of image node
+ * @param offsets - Offsets of tokens by image index
+ * @param base - Image index of the first child
+ * @param low - The first covered child
+ * @param high - Child after the last covered
+ * @param depth - Length of common prefix
+ */
+static void image_radix_fill(ImageRadixList* list, uint32_t index, void** children, const uint32_t* offsets,
+                             uint32_t base, uint32_t low, uint32_t high, unsigned depth) {
+    // Common prefix of sorted tokens is
+    // the prefix of the first and the last
+    Node* a = (Node*)children[low];
+    Node* b = (Node*)children[high - 1];
+    unsigned min_length = a->token_length < b->token_length ? a->token_length : b->token_length;
+
+    unsigned end = depth;
+    while (end < min_length && a->token[end] == b->token[end]) {
+        end++;
+    }
+
+    // Tokens equal to prefix go first and
+    // others are grouped by next byte
+    uint32_t i = low;
+    while (i < high && ((Node*)children[i])->token_length == end) {
+        i++;
+    }
+
+    uint32_t groups = 0;
+    for (uint32_t j = i; j < high; groups++) {
+        char key = ((Node*)children[j])->token[end];
+        while (j < high && ((Node*)children[j])->token[end] == key) {
+            j++;
+        }
+    }
+
+    uint32_t first = image_radix_reserve(list, groups);
+
+    ImageRadix* radix = &list->radix[index];
+    radix->label = offsets[base + low] + depth;
+    radix->label_length = end - depth;
+    radix->children = first;
+    radix->child_count = groups;
+    radix->first = base + low;
+    radix->count = high - low;
+
+    // Fill groups after reserving them
+    // all, so they are placed together
+    for (uint32_t g = 0; g < groups; g++) {
+        uint32_t j = i;
+        char key = ((Node*)children[j])->token[end];
+        while (j < high && ((Node*)children[j])->token[end] == key) {
+            j++;
+        }
+
+        image_radix_fill(list, first + g, children, offsets, base, i, j, end);
+        i = j;
+    }
+}
+
+/**
+ * Build radix indexes over children of nodes
+ * which are not small, nodes sharing children
+ * share radix index too
+ */
+static void image_radix_build(ImageRadixList* list, Vector* order, const uint32_t* children,
+                              const uint32_t* offsets) {
+    // Radix roots by index of the first child
+    uint32_t* built = (uint32_t*)malloc(sizeof(uint32_t) * order->length);
+    if (built == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+    memset(built, 0xff, sizeof(uint32_t) * order->length);
+
+    for (unsigned i = 0; i < order->length; i++) {
+        Node* n = (Node*)vector_get(order, i);
+
+        if (n->children.length > IMAGE_SMALL_NODE) {
+            if (list->root_count == list->root_capacity) {
+                list->root_capacity = list->root_capacity ? list->root_capacity * 2 : 16;
+                list->roots = (ImageRadixRoot*)realloc(list->roots, sizeof(ImageRadixRoot) * list->root_capacity);
+                if (list->roots == NULL) {
+                    fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+                    exit(1);
+                }
+            }
+
+            uint32_t root = built[children[i]];
+            if (root == UINT32_MAX) {
+                root = image_radix_reserve(list, 1);
+                built[children[i]] = root;
+                image_radix_fill(list, root, order->data + children[i], offsets, children[i],
+                                 0, n->children.length, 0);
+            }
+
+            list->roots[list->root_count].node = i;
+            list->roots[list->root_count].radix = root;
+            list->root_count++;
+        }
+    }
+
+    free(built);
+}
+
+/**
+ * Table for hash consing, entries are
+ * indexes of nodes in queue plus one
+ */
+struct image_cons {
+    uint32_t* entries;
+    uint32_t* hashes;
+    unsigned capacity;
+};
+typedef struct image_cons ImageCons;
+
+/**
+ * Identifiers of subtrees while
+ * deduplicating tree in queue
+ */
+struct image_subtrees {
+    Vector* queue;
+    const uint32_t* starts;  // Index of the first child in queue
+    uint32_t* ids;           // Identifier of subtree by node
+    uint32_t* lists;         // Identifier of children by node, zero if none
+};
+typedef struct image_subtrees ImageSubtrees;
+
+static uint32_t image_list_hash(const ImageSubtrees* subtrees, uint32_t i) {
+    Node* n = (Node*)vector_get(subtrees->queue, i);
+    uint32_t hash = 2166136261u;
+
+    for (unsigned j = 0; j < n->children.length; j++) {
+        hash = (hash ^ subtrees->ids[subtrees->starts[i] + j]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static int image_list_equal(const ImageSubtrees* subtrees, uint32_t a, uint32_t b) {
+    Node* x = (Node*)vector_get(subtrees->queue, a);
+    Node* y = (Node*)vector_get(subtrees->queue, b);
+    if (x->children.length != y->children.length) {
+        return 0;
+    }
+
+    return memcmp(subtrees->ids + subtrees->starts[a], subtrees->ids + subtrees->starts[b],
+                  sizeof(uint32_t) * x->children.length) == 0;
+}
+
+static int image_subtree_equal(const ImageSubtrees* subtrees, uint32_t a, uint32_t b) {
+    Node* x = (Node*)vector_get(subtrees->queue, a);
+    Node* y = (Node*)vector_get(subtrees->queue, b);
+
+    return subtrees->lists[a] == subtrees->lists[b] && x->weight == y->weight && x->token_length == y->token_length &&
+           memcmp(x->token, y->token, x->token_length) == 0;
+}
+
+/**
+ * Find equal entry in table or insert node
+ *
+ * @return Index of node in queue with equal entry
+ */
+static uint32_t image_cons_find(ImageCons* cons, const ImageSubtrees* subtrees, uint32_t i, uint32_t hash,
+                                int (*equal)(const ImageSubtrees*, uint32_t, uint32_t)) {
+    unsigned k = hash & (cons->capacity - 1);
+
+    while (cons->entries[k] != 0) {
+        if (cons->hashes[k] == hash && equal(subtrees, cons->entries[k] - 1, i)) {
+            return cons->entries[k] - 1;
+        }
+        k = (k + 1) & (cons->capacity - 1);
+    }
+
+    cons->entries[k] = i + 1;
+    cons->hashes[k] = hash;
+
+    return i;
+}
+
+/**
+ * Give equal identifiers to structurally
+ * equal subtrees and to equal lists of
+ * children, nodes are processed from leaves
+ */
+static void image_subtrees_build(ImageSubtrees* subtrees) {
+    unsigned length = subtrees->queue->length;
+
+    ImageCons lists, nodes;
+    lists.capacity = nodes.capacity = 64;
+    while (lists.capacity < length * 2) {
+        lists.capacity *= 2;
+    }
+    nodes.capacity = lists.capacity;
+
+    lists.entries = (uint32_t*)calloc(lists.capacity, sizeof(uint32_t));
+    lists.hashes = (uint32_t*)malloc(sizeof(uint32_t) * lists.capacity);
+    nodes.entries = (uint32_t*)calloc(nodes.capacity, sizeof(uint32_t));
+    nodes.hashes = (uint32_t*)malloc(sizeof(uint32_t) * nodes.capacity);
+    if (lists.entries == NULL || lists.hashes == NULL || nodes.entries == NULL || nodes.hashes == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    // Children follow parents in breadth-first
+    // order, so they get identifiers before them
+    uint32_t next_list = 1;
+    for (unsigned i = length; i-- > 0;) {
+        Node* n = (Node*)vector_get(subtrees->queue, i);
+
+        if (n->children.length == 0) {
+            subtrees->lists[i] = 0;
+        }
+        else {
+            uint32_t same = image_cons_find(&lists, subtrees, i, image_list_hash(subtrees, i), image_list_equal);
+            subtrees->lists[i] = same == i ? next_list++ : subtrees->lists[same];
+        }
+
+        uint32_t hash = pool_hash(n->token, n->token_length) ^ (subtrees->lists[i] * 2654435761u) ^ n->weight;
+        subtrees->ids[i] = image_cons_find(&nodes, subtrees, i, hash, image_subtree_equal);
+    }
+
+    free(lists.entries);
+    free(lists.hashes);
+    free(nodes.entries);
+    free(nodes.hashes);
+}
+
+Image* image_create(Node* head) {
+    // Queue of all nodes in breadth-first order,
+    // children of each node follow one another
+    Vector* queue = vector_create(1);
+    vector_push(queue, head);
+
+    // Temporary array for sorting children
+    Vector* temp = vector_create(1);
+
+    for (unsigned i = 0; i < queue->length; i++) {
+        Node* n = (Node*)vector_get(queue, i);
+        unsigned first = queue->length;
+
+        Node** children = node_list_data(&n->children);
+        for (unsigned j = 0; j < n->children.length; j++) {
+            vector_push(queue, children[j]);
+        }
+        while (temp->length < n->children.length) {
+            vector_push(temp, NULL);
+        }
+
+        // Children are sorted for binary search
+        image_sort_nodes(queue->data + first, n->children.length, temp->data);
+    }
+    vector_free(temp);
+
+    // Index of the first child of each node in queue
+    uint32_t* starts = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    uint32_t* ids = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    uint32_t* lists = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    uint32_t* placed = (uint32_t*)malloc(sizeof(uint32_t) * (queue->length + 1));
+    uint32_t* sources = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    uint32_t* children = (uint32_t*)malloc(sizeof(uint32_t) * queue->length);
+    if (starts == NULL || ids == NULL || lists == NULL || placed == NULL || sources == NULL || children == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    uint32_t next_child = 1;
+    for (unsigned i = 0; i < queue->length; i++) {
+        starts[i] = next_child;
+        next_child += ((Node*)vector_get(queue, i))->children.length;
+    }
+
+    // Equal subtrees have equal lists of
+    // children, each list is placed once
+    ImageSubtrees subtrees;
+    subtrees.queue = queue;
+    subtrees.starts = starts;
+    subtrees.ids = ids;
+    subtrees.lists = lists;
+    image_subtrees_build(&subtrees);
+
+    memset(placed, 0xff, sizeof(uint32_t) * (queue->length + 1));
+    sources[0] = 0;
+    uint32_t count = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        Node* n = (Node*)vector_get(queue, sources[i]);
+        uint32_t list_id = lists[sources[i]];
+
+        if (n->children.length == 0) {
+            children[i] = count;
+        }
+        else {
+            if (placed[list_id] == UINT32_MAX) {
+                placed[list_id] = count;
+                for (unsigned j = 0; j < n->children.length; j++) {
+                    sources[count++] = starts[sources[i]] + j;
+                }
+            }
+            children[i] = placed[list_id];
+        }
+    }
+
+    // Nodes of image in placement order
+    Vector* order = vector_create(1);
+    for (uint32_t i = 0; i < count; i++) {
+        vector_push(order, vector_get(queue, sources[i]));
+    }
+
+    free(starts);
+    free(ids);
+    free(lists);
+    free(placed);
+    free(sources);
+    vector_free(queue);
+
+    // Table of distinct tokens, not more
+    // than count of nodes with load factor 0.5
+    unsigned capacity = 64;
+    while (capacity < order->length * 2) {
+        capacity *= 2;
+    }
+
+    ImageTokenEntry* entries = (ImageTokenEntry*)calloc(capacity, sizeof(ImageTokenEntry));
+    uint32_t* offsets = (uint32_t*)malloc(sizeof(uint32_t) * order->length);
+    if (entries == NULL || offsets == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    // Get offsets of tokens in blob
+    uint32_t token_size = 0;
+    unsigned token_count = 0;
+    for (unsigned i = 0; i < order->length; i++) {
+        Node* n = (Node*)vector_get(order, i);
+        offsets[i] = image_token_offset(entries, capacity, n->token, n->token_length, &token_size, &token_count);
+    }
+    token_size = (token_size + 3) & ~3u;
+
+    // Build radix indexes, labels are
+    // parts of tokens in tokens blob
+    ImageRadixList list;
+    memset(&list, 0, sizeof(ImageRadixList));
+    image_radix_build(&list, order, children, offsets);
+
+    // Allocate image data at once
+    ImageHeader counts;
+    counts.node_count = order->length;
+    counts.token_size = token_size;
+    counts.radix_count = list.radix_count;
+    counts.root_count = list.root_count;
+    ImageLayout layout = image_layout(&counts);
+    size_t size = layout.size;
+
+    Image* image = (Image*)malloc(sizeof(Image));
+    char* data = (char*)calloc(size, 1);
+    if (image == NULL || data == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    ImageHeader* header = (ImageHeader*)data;
+    ImageNode* nodes = (ImageNode*)(data + layout.nodes);
+    uint32_t* weights = (uint32_t*)(data + layout.weights);
+    uint8_t* keys = (uint8_t*)data + layout.keys;
+    uint8_t* symbols = (uint8_t*)data + layout.symbols;
+    char* tokens = data + layout.tokens;
+
+    if (list.radix_count > 0) {
+        memcpy(data + layout.radix, list.radix, sizeof(ImageRadix) * list.radix_count);
+        memcpy(data + layout.roots, list.roots, sizeof(ImageRadixRoot) * list.root_count);
+    }
+
+    // Fill nodes, equal lists of
+    // children are shared by parents
+    uint32_t weighted = 0;
+    for (unsigned i = 0; i < order->length; i++) {
+        Node* n = (Node*)vector_get(order, i);
+
+        nodes[i].token = offsets[i];
+        nodes[i].token_length = n->token_length;
+        nodes[i].children = children[i];
+        nodes[i].child_count = n->children.length;
+        weights[i] = n->weight;
+        weighted |= n->weight != 0;
+        keys[i] = (uint8_t)n->token[0];
+        symbols[i] = image_symbols(n->token, n->token_length);
+        memcpy(nodes[i].inline_token, n->token,
+               n->token_length < IMAGE_INLINE_SIZE ? n->token_length : IMAGE_INLINE_SIZE);
+
+        memcpy(tokens + offsets[i], n->token, n->token_length + 1);
+    }
+
+    // Fill header
+    memcpy(header->magic, IMAGE_MAGIC, 4);
+    header->version = IMAGE_VERSION;
+    header->byte_order = IMAGE_BYTE_ORDER;
+    header->node_count = order->length;
+    header->token_size = token_size;
+    header->radix_count = list.radix_count;
+    header->root_count = list.root_count;
+    header->weighted = weighted;
+    header->checksum = image_checksum(data + sizeof(ImageHeader), size - sizeof(ImageHeader));
+
+    image->data = data;
+    image->size = size;
+    image->mapped = 0;
+    image_setup(image);
+
+    // Remove temporary variables
+    vector_free(order);
+    free(children);
+    free(entries);
+    free(offsets);
+    free(list.radix);
+    free(list.roots);
+
+    return image;
+}
+
+/**
+ * Check that inline bytes of node are
+ * the first bytes of token padded by zeros
+ */
+static int image_inline_valid(const ImageNode* node, const char* token) {
+    for (unsigned i = 0; i < IMAGE_INLINE_SIZE; i++) {
+        char expected = i < node->token_length ? token[i] : '\0';
+        if (node->inline_token[i] != expected) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * Check that image data is correct
+ *
+ * @return Zero on success or not zero with printed error
+ */
+static int image_check(const char* data, size_t size, const char* filepath) {
+    const ImageHeader* header = (const ImageHeader*)data;
+
+    if (size < sizeof(ImageHeader) || memcmp(header->magic, IMAGE_MAGIC, 4) != 0) {
+        fprintf(stderr, "[ERROR] %s is not a compiled rules file\n", filepath);
+        return 1;
+    }
+
+    if (header->byte_order != IMAGE_BYTE_ORDER) {
+        fprintf(stderr, "[ERROR] %s was compiled for another byte order\n", filepath);
+        return 1;
+    }
+
+    if (header->version != IMAGE_VERSION) {
+        fprintf(stderr, "[ERROR] %s has version %u, but version %u is required\n",
+                filepath, header->version, IMAGE_VERSION);
+        return 1;
+    }
+
+    ImageLayout layout = image_layout(header);
+    if (header->node_count == 0 || header->token_size % 4 != 0 || size != layout.size) {
+        fprintf(stderr, "[ERROR] %s has incorrect size\n", filepath);
+        return 1;
+    }
+
+    if (header->checksum != image_checksum(data + sizeof(ImageHeader), size - sizeof(ImageHeader))) {
+        fprintf(stderr, "[ERROR] %s has incorrect checksum\n", filepath);
+        return 1;
+    }
+
+    // Links must not point outside of image
+    const ImageNode* nodes = (const ImageNode*)(data + layout.nodes);
+    const uint8_t* keys = (const uint8_t*)data + layout.keys;
+    const char* tokens = data + layout.tokens;
+    for (uint32_t i = 0; i < header->node_count; i++) {
+        const ImageNode* n = &nodes[i];
+        if ((uint64_t)n->children + n->child_count > header->node_count ||
+            (uint64_t)n->token + n->token_length >= header->token_size ||
+            tokens[n->token + n->token_length] != '\0' || keys[i] != (uint8_t)tokens[n->token] ||
+            !image_inline_valid(n, tokens + n->token)) {
+            fprintf(stderr, "[ERROR] %s has incorrect node %u\n", filepath, i);
+            return 1;
+        }
+    }
+
+    // Radix children follow their parents,
+    // so walking of index always stops
+    const ImageRadix* radix = (const ImageRadix*)(data + layout.radix);
+    for (uint32_t i = 0; i < header->radix_count; i++) {
+        const ImageRadix* r = &radix[i];
+        if ((r->child_count > 0 && r->children <= i) ||
+            (uint64_t)r->children + r->child_count > header->radix_count ||
+            (uint64_t)r->first + r->count > header->node_count ||
+            (uint64_t)r->label + r->label_length >= header->token_size) {
+            fprintf(stderr, "[ERROR] %s has incorrect radix node %u\n", filepath, i);
+            return 1;
+        }
+    }
+
+    const ImageRadixRoot* roots = (const ImageRadixRoot*)(data + layout.roots);
+    for (uint32_t i = 0; i < header->root_count; i++) {
+        if (roots[i].node >= header->node_count || roots[i].radix >= header->radix_count ||
+            (i > 0 && roots[i].node <= roots[i - 1].node)) {
+            fprintf(stderr, "[ERROR] %s has incorrect radix root %u\n", filepath, i);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+Image* image_load(const char* filepath) {
+    char* data;
+    size_t size;
+
+#if defined(IMAGE_READ)
+    // Read whole file to memory
+    FILE* file = fopen(filepath, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data = (char*)malloc(size + 1);
+    if (data == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+
+    if (fread(data, 1, size, file) != size) {
+        fprintf(stderr, "[ERROR] Can't read file %s\n", filepath);
+        fclose(file);
+        free(data);
+        return NULL;
+    }
+    fclose(file);
+#else
+    // Map file to memory without reading
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        fprintf(stderr, "[ERROR] %s is not a compiled rules file\n", filepath);
+        close(fd);
+        return NULL;
+    }
+    size = (size_t)st.st_size;
+
+    data = (char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == (char*)MAP_FAILED) {
+        fprintf(stderr, "[ERROR] Can't map file %s\n", filepath);
+        return NULL;
+    }
+#endif
+
+    Image* image = (Image*)malloc(sizeof(Image));
+    if (image == NULL) {
+        fprintf(stderr, "[ERROR] Bad image memory allocation\n");
+        exit(1);
+    }
+    image->data = data;
+    image->size = size;
+#if defined(IMAGE_READ)
+    image->mapped = 0;
+#else
+    image->mapped = 1;
+#endif
+
+    if (image_check(data, size, filepath)) {
+        image_free(image);
+        return NULL;
+    }
+
+    image_setup(image);
+
+    return image;
+}
+
+int image_save(const Image* image, const char* filepath) {
+    FILE* file = fopen(filepath, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return 1;
+    }
+
+    // Write image data as is
+    if (fwrite(image->data, 1, image->size, file) != image->size) {
+        fprintf(stderr, "[ERROR] Can't write file %s\n", filepath);
+        fclose(file);
+        return 1;
+    }
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "[ERROR] Can't write file %s\n", filepath);
+        return 1;
+    }
+
+    return 0;
+}
+
+const char* image_token(const Image* image, const ImageNode* node) {
+    return image->tokens + node->token;
+}
+
+uint8_t image_symbols(const char* bytes, unsigned length) {
+    // Letters and digits make up most of tokens, so
+    // only other bytes are classified by low bits
+    uint8_t symbols = 0;
+    for (unsigned i = 0; i < length; i++) {
+        unsigned char byte = (unsigned char)bytes[i];
+        if ((byte | 0x20) >= 'a' && (byte | 0x20) <= 'z') {
+            continue;
+        }
+        if (byte >= '0' && byte <= '9') {
+            continue;
+        }
+        symbols |= (uint8_t)(1u << (byte % 8));
+    }
+
+    return symbols;
+}
+
+/**
+ * Compare the first bytes of token of image
+ * node with string, short tokens are compared
+ * only by inline bytes of node record
+ */
+static int image_token_bytes(const Image* image, const ImageNode* node, const char* str, unsigned length) {
+    if (length <= IMAGE_INLINE_SIZE) {
+        return memcmp(node->inline_token, str, length);
+    }
+
+    int result = memcmp(node->inline_token, str, IMAGE_INLINE_SIZE);
+    if (result != 0) {
+        return result;
+    }
+
+    return memcmp(image->tokens + node->token + IMAGE_INLINE_SIZE, str + IMAGE_INLINE_SIZE,
+                  length - IMAGE_INLINE_SIZE);
+}
+
+/**
+ * Compare token of image node with string
+ * by bytes, like strcmp for null terminated
+ */
+static int image_token_compare(const Image* image, const ImageNode* node, const char* str, unsigned length) {
+    unsigned min_length = node->token_length < length ? node->token_length : length;
+
+    int result = image_token_bytes(image, node, str, min_length);
+    if (result != 0) {
+        return result;
+    }
+
+    return (int)node->token_length - (int)length;
+}
+
+#if defined(IMAGE_SSE2)
+/**
+ * Get index of the lowest set bit, value is not zero
+ */
+static unsigned image_ctz(unsigned value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(value);
+#endif
+}
+#endif
+
+/**
+ * Get children of small node which tokens start
+ * with key byte, they are stored one after another
+ *
+ * @return Count of found children
+ */
+static uint32_t image_key_range(const Image* image, const ImageNode* node, uint8_t key, uint32_t* first) {
+    const uint8_t* keys = image->keys + node->children;
+    uint32_t count = node->child_count;
+
+#if defined(IMAGE_SSE2)
+    // Compare all keys at once, keys are
+    // padded so reading past the end is safe
+    __m128i chunk = _mm_loadu_si128((const __m128i*)keys);
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8((char)key)));
+    mask &= (1u << count) - 1;
+    if (mask == 0) {
+        *first = node->children;
+        return 0;
+    }
+
+    // Matched keys are contiguous in sorted children
+    unsigned shift = image_ctz(mask);
+    *first = node->children + shift;
+    return image_ctz(~(mask >> shift));
+#else
+    uint32_t i = 0;
+    while (i < count && keys[i] < key) {
+        i++;
+    }
+
+    uint32_t j = i;
+    while (j < count && keys[j] == key) {
+        j++;
+    }
+
+    *first = node->children + i;
+    return j - i;
+#endif
+}
+
+/**
+ * Get children of small node which tokens
+ * may be equal to string or start with it
+ *
+ * @return Count of found children
+ */
+static uint32_t image_candidates(const Image* image, const ImageNode* node, const char* str,
+                                 unsigned length, uint32_t* first) {
+    // Empty string matches all children
+    if (length == 0 || node->child_count > IMAGE_SMALL_NODE) {
+        *first = node->children;
+        return node->child_count;
+    }
+
+    return image_key_range(image, node, (uint8_t)str[0], first);
+}
+
+/**
+ * Get root of radix index of node
+ *
+ * @return Radix node or NULL for small node
+ */
+static const ImageRadix* image_radix_root(const Image* image, const ImageNode* node) {
+    if (node->child_count <= IMAGE_SMALL_NODE) {
+        return NULL;
+    }
+
+    // Links are sorted by image nodes
+    uint32_t index = (uint32_t)(node - image->nodes);
+    uint32_t low = 0, high = image->header->root_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (image->roots[middle].node < index) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    if (low < image->header->root_count && image->roots[low].node == index) {
+        return &image->radix[image->roots[low].radix];
+    }
+
+    return NULL;
+}
+
+/**
+ * Walk radix index by string, each byte
+ * of string is compared only once
+ *
+ * @return Count of children starting with string
+ */
+static uint32_t image_radix_range(const Image* image, const ImageNode* node, const ImageRadix* radix,
+                                  const char* str, unsigned length, uint32_t* first) {
+    unsigned position = 0;
+
+    for (;;) {
+        // Label must match rest of string
+        unsigned rest = length - position;
+        unsigned compared = radix->label_length < rest ? radix->label_length : rest;
+        if (memcmp(image->tokens + radix->label, str + position, compared) != 0) {
+            break;
+        }
+
+        position += compared;
+        if (position == length) {
+            *first = radix->first;
+            return radix->count;
+        }
+
+        // Radix child is found by next byte
+        uint8_t key = (uint8_t)str[position];
+        uint32_t low = radix->children, high = radix->children + radix->child_count;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if ((uint8_t)image->tokens[image->radix[middle].label] < key) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+
+        if (low == radix->children + radix->child_count ||
+            (uint8_t)image->tokens[image->radix[low].label] != key) {
+            break;
+        }
+        radix = &image->radix[low];
+    }
+
+    *first = node->children;
+    return 0;
+}
+
+/**
+ * Get index of the first of children
+ * which token is not less than string
+ */
+static uint32_t image_lower_bound(const Image* image, uint32_t first, uint32_t count,
+                                  const char* str, unsigned length) {
+    while (count > 0) {
+        uint32_t step = count / 2;
+
+        if (image_token_compare(image, &image->nodes[first + step], str, length) < 0) {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+const ImageNode* image_find_child(const Image* image, const ImageNode* node, const char* token, unsigned length) {
+    uint32_t first;
+    const ImageRadix* radix = image_radix_root(image, node);
+
+    // Equal token is the shortest of
+    // found tokens, so it goes first
+    if (radix != NULL) {
+        uint32_t count = image_radix_range(image, node, radix, token, length, &first);
+        if (count > 0 && image->nodes[first].token_length == length) {
+            return &image->nodes[first];
+        }
+        return NULL;
+    }
+
+    uint32_t count = image_candidates(image, node, token, length, &first);
+    uint32_t i = image_lower_bound(image, first, count, token, length);
+
+    // The first of equal tokens is found
+    if (i < first + count && image_token_compare(image, &image->nodes[i], token, length) == 0) {
+        return &image->nodes[i];
+    }
+
+    return NULL;
+}
+
+#if defined(IMAGE_SSE2)
+/**
+ * Get mask of 16-bit fields which have all
+ * bits set, four fields are checked at once
+ */
+static uint32_t image_full_fields(uint64_t fields) {
+    uint64_t low = 0x7fff7fff7fff7fffull;
+    uint64_t zeros = ~fields;
+
+    // Top bit of field is set only if field of zeros is zero
+    uint64_t tops = ~(((zeros & low) + low) | zeros | low);
+
+    // Gather top bits of fields to the lowest four bits
+    return (uint32_t)(((tops >> 15) * 0x0000200040008001ull) >> 45) & 0xf;
+}
+
+/**
+ * Compare inline token of one node,
+ * bytes after prefix are ignored
+ */
+static uint32_t image_prefix_test(const ImageNode* node, __m128i pattern, __m128i ignored) {
+    __m128i token = _mm_loadu_si128((const __m128i*)node->inline_token);
+    __m128i equal = _mm_or_si128(_mm_cmpeq_epi8(token, pattern), ignored);
+
+    return _mm_movemask_epi8(equal) == 0xffff;
+}
+#endif
+
+#if defined(IMAGE_AVX2)
+/**
+ * Check once if processor and
+ * system support AVX2 registers
+ */
+static int image_has_avx2(void) {
+    // Threads may check it at once, they
+    // store the same value atomically
+    static volatile long supported = -1;
+
+    long result = atomic_load_long(&supported);
+    if (result < 0) {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        int os_saves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        result = os_saves && (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        result = __builtin_cpu_supports("avx2") != 0;
+#endif
+        atomic_store_long(&supported, result);
+    }
+
+    return (int)result;
+}
+
+/**
+ * Compare inline tokens of four nodes per step,
+ * record of node takes 32 bytes and its inline
+ * token is the upper half, so halves of two
+ * records are joined in one register
+ */
+IMAGE_TARGET_AVX2
+static uint32_t image_prefix_mask_avx2(const ImageNode* nodes, unsigned count, __m128i pattern,
+                                       __m128i ignored) {
+    __m256i wide_pattern = _mm256_broadcastsi128_si256(pattern);
+    __m256i wide_ignored = _mm256_broadcastsi128_si256(ignored);
+    uint32_t mask = 0;
+    unsigned i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)&nodes[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i*)&nodes[i + 1]);
+        __m256i c = _mm256_loadu_si256((const __m256i*)&nodes[i + 2]);
+        __m256i d = _mm256_loadu_si256((const __m256i*)&nodes[i + 3]);
+
+        __m256i first = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_permute2x128_si256(a, b, 0x31), wide_pattern),
+                                        wide_ignored);
+        __m256i second = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_permute2x128_si256(c, d, 0x31), wide_pattern),
+                                         wide_ignored);
+
+        uint64_t fields = (uint32_t)_mm256_movemask_epi8(first) |
+                          (uint64_t)(uint32_t)_mm256_movemask_epi8(second) << 32;
+        mask |= image_full_fields(fields) << i;
+    }
+
+    for (; i < count; i++) {
+        mask |= image_prefix_test(&nodes[i], pattern, ignored) << i;
+    }
+
+    return mask;
+}
+#endif
+
+uint32_t image_prefix_mask(const Image* image, uint32_t first, unsigned count, const char* prefix,
+                           unsigned length) {
+    const ImageNode* nodes = image->nodes + first;
+    uint32_t mask = 0;
+
+    if (count > IMAGE_MASK_SIZE) {
+        count = IMAGE_MASK_SIZE;
+    }
+
+    // Inline bytes are padded by zeros and prefix
+    // has no zeros, so shorter tokens don't match
+    if (length <= IMAGE_INLINE_SIZE) {
+#if defined(IMAGE_SSE2)
+        // Bytes after prefix are ignored by
+        // setting them in comparison result
+        static const uint8_t ignored_bytes[2 * IMAGE_INLINE_SIZE] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+        };
+        char bytes[IMAGE_INLINE_SIZE] = {0};
+        for (unsigned i = 0; i < length; i++) {
+            bytes[i] = prefix[i];
+        }
+
+        __m128i pattern = _mm_loadu_si128((const __m128i*)bytes);
+        __m128i ignored = _mm_loadu_si128((const __m128i*)(ignored_bytes + IMAGE_INLINE_SIZE - length));
+
+#if defined(IMAGE_AVX2)
+        if (image_has_avx2()) {
+            return image_prefix_mask_avx2(nodes, count, pattern, ignored);
+        }
+#endif
+        unsigned i = 0;
+        for (; i + 4 <= count; i += 4) {
+            uint64_t fields = 0;
+            for (unsigned j = 0; j < 4; j++) {
+                __m128i token = _mm_loadu_si128((const __m128i*)nodes[i + j].inline_token);
+                __m128i equal = _mm_or_si128(_mm_cmpeq_epi8(token, pattern), ignored);
+                fields |= (uint64_t)(unsigned)_mm_movemask_epi8(equal) << (16 * j);
+            }
+            mask |= image_full_fields(fields) << i;
+        }
+
+        for (; i < count; i++) {
+            mask |= image_prefix_test(&nodes[i], pattern, ignored) << i;
+        }
+#else
+        for (unsigned i = 0; i < count; i++) {
+            mask |= (uint32_t)(memcmp(nodes[i].inline_token, prefix, length) == 0) << i;
+        }
+#endif
+        return mask;
+    }
+
+    // Longer prefixes are compared with tokens blob
+    for (unsigned i = 0; i < count; i++) {
+        if (nodes[i].token_length >= length && image_token_bytes(image, &nodes[i], prefix, length) == 0) {
+            mask |= (uint32_t)1 << i;
+        }
+    }
+
+    return mask;
+}
+
+unsigned image_prefix_range(const Image* image, const ImageNode* node, const char* prefix,
+                            unsigned length, uint32_t* first) {
+    const ImageRadix* radix = image_radix_root(image, node);
+    if (radix != NULL) {
+        return image_radix_range(image, node, radix, prefix, length, first);
+    }
+
+    uint32_t begin;
+    uint32_t end = image_candidates(image, node, prefix, length, &begin);
+    end += begin;
+
+    // Tokens starting with prefix are not less than prefix
+    *first = image_lower_bound(image, begin, end - begin, prefix, length);
+
+    // And they are followed by tokens
+    // greater than all extensions of prefix
+    uint32_t last = *first;
+    uint32_t count = end - last;
+
+    while (count > 0) {
+        uint32_t step = count / 2;
+        const ImageNode* child = &image->nodes[last + step];
+
+        if (child->token_length >= length && image_token_bytes(image, child, prefix, length) == 0) {
+            last += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    return last - *first;
+}
+
+void image_free(Image* image) {
+    // Unmap or free image data
+#if !defined(IMAGE_READ)
+    if (image->mapped) {
+        munmap(image->data, image->size);
+    }
+    else
+#endif
+    {
+        free(image->data);
+    }
+
+    free(image);
+}
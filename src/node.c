@@ -4,37 +4,48 @@
 
 #include "../include/node.h"
 
-Node* node_create(char* token, unsigned token_length) {
+Node* node_create(Arena* arena, const char* token, unsigned token_length) {
+    Node* n;
+
     // Allocate memory for node
-    Node* n = (Node*)malloc(sizeof(Node));
-    if (n == NULL) {
-        fprintf(stderr, "[ERROR] Bad node vector memory allocation\n");
-        exit(1);
+    if (arena != NULL) {
+        n = (Node*)arena_alloc(arena, sizeof(Node), sizeof(void*));
     }
-
-    // Allocate memory for token field
-    n->token = (char*)malloc(sizeof(char) * token_length);
-    if (n->token == NULL) {
-        fprintf(stderr, "[ERROR] Bad node vector memory allocation\n");
-        exit(1);
+    else {
+        n = (Node*)malloc(sizeof(Node));
+        if (n == NULL) {
+            fprintf(stderr, "[ERROR] Bad node vector memory allocation\n");
+            exit(1);
+        }
     }
 
-    // Setup fields of node
-    memcpy(n->token, token, sizeof(char) * token_length);
+    // Setup fields of node, token
+    // is borrowed and not copied
+    n->token = token;
+    n->token_length = token_length;
+    n->weight = 0;
 
-    n->children = vector_create(1);
+    // The first children are placed inside of node,
+    // others in the same memory as node
+    n->heap = arena == NULL;
+    node_list_init(&n->children);
 
     return n;
 }
 
 void node_free(Node* n) {
+    // Nodes in arena are freed with arena
+    if (!n->heap) {
+        return;
+    }
+
     // Free all child nodes
-    for (unsigned i = 0; i < n->children->length; i++) {
-        node_free(vector_get(n->children, i));
+    Node** children = node_list_data(&n->children);
+    for (unsigned i = 0; i < n->children.length; i++) {
+        node_free(children[i]);
     }
 
-    // Free memory for children, token and self
-    vector_free(n->children);
-    free(n->token);
+    // Free memory for children and self
+    node_list_free(&n->children);
     free(n);
-}
\ No newline at end of file
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/pool.h"
+
+unsigned pool_hash(const char* str, unsigned length) {
+    // FNV-1a hash function
+    unsigned hash = 2166136261u;
+    for (unsigned i = 0; i < length; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+static void pool_grow(Pool* pool) {
+    unsigned capacity = pool->capacity * 2;
+
+    PoolEntry* entries = (PoolEntry*)calloc(capacity, sizeof(PoolEntry));
+    if (entries == NULL) {
+        fprintf(stderr, "[ERROR] Bad pool memory allocation\n");
+        exit(1);
+    }
+
+    // Move entries to the new table
+    for (unsigned i = 0; i < pool->capacity; i++) {
+        PoolEntry* entry = &pool->entries[i];
+        if (entry->str == NULL) {
+            continue;
+        }
+
+        unsigned j = entry->hash & (capacity - 1);
+        while (entries[j].str != NULL) {
+            j = (j + 1) & (capacity - 1);
+        }
+        entries[j] = *entry;
+    }
+
+    free(pool->entries);
+    pool->entries = entries;
+    pool->capacity = capacity;
+}
+
+Pool* pool_create(Arena* arena) {
+    // Allocate memory for self
+    Pool* pool = (Pool*)malloc(sizeof(Pool));
+    if (pool == NULL) {
+        fprintf(stderr, "[ERROR] Bad pool memory allocation\n");
+        exit(1);
+    }
+
+    pool->arena = arena;
+    pool->length = 0;
+    pool->capacity = 64;
+
+    pool->entries = (PoolEntry*)calloc(pool->capacity, sizeof(PoolEntry));
+    if (pool->entries == NULL) {
+        fprintf(stderr, "[ERROR] Bad pool memory allocation\n");
+        exit(1);
+    }
+
+    return pool;
+}
+
+const char* pool_intern(Pool* pool, const char* str, unsigned length) {
+    unsigned hash = pool_hash(str, length);
+
+    // Find string or free slot in the table
+    unsigned i = hash & (pool->capacity - 1);
+    while (pool->entries[i].str != NULL) {
+        PoolEntry* entry = &pool->entries[i];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->str, str, length) == 0) {
+            return entry->str;
+        }
+        i = (i + 1) & (pool->capacity - 1);
+    }
+
+    // Copy string to the pool
+    char* copy = (char*)arena_alloc(pool->arena, length + 1, 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+
+    pool->entries[i].str = copy;
+    pool->entries[i].length = length;
+    pool->entries[i].hash = hash;
+
+    // Keep load factor under 0.5
+    if (++pool->length * 2 > pool->capacity) {
+        pool_grow(pool);
+    }
+
+    return copy;
+}
+
+void pool_free(Pool* pool) {
+    // Free table and self
+    free(pool->entries);
+    free(pool);
+}
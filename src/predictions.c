@@ -3,8 +3,28 @@
 #include <stdio.h>
 
 #include "../include/predictions.h"
-
-char* token_create(char* str, unsigned str_len) {
+#include "../include/thread.h"
+
+// Count of inputs taken by batch thread at once
+#define PREDICTIONS_BATCH_CHUNK 64
+
+/**
+ * Inputs of batch shared by threads,
+ * threads take chunks of them by counter
+ */
+struct predictions_batch {
+    Query query;           // Query on head of tree
+    uint8_t* flags;        // Flags of nodes by brackets of batch or NULL
+    uint32_t brackets[TREE_BRACKET_WORDS];
+    char** inputs;
+    char* optional_brackets;
+    Predictions** results;
+    unsigned count;
+    volatile long next;    // Index of the first not taken input
+};
+typedef struct predictions_batch PredictionsBatch;
+
+char* token_create(const char* str, unsigned str_len) {
     // Allocate memory for token
     char* token = (char*)malloc(sizeof(char) * str_len + 1);
     if (token == NULL) {
@@ -59,110 +79,499 @@ Tokens* split(char *str, char delimiter) {
     return vec;
 }
 
-Predictions *predictions_create(Tree *rules, char *input, char *optional_brackets) {
-    // Initialize result predictions
-    Predictions* pred = (Predictions*)malloc(sizeof(Predictions));
-    if (pred == NULL) {
-        fprintf(stderr, "[ERROR] Bad prediction memory allocation\n");
-        exit(0);
+/**
+ * Function for receiving found predictions
+ */
+typedef void (*PredictionEmit)(void* context, const char* token, unsigned length, unsigned weight);
+
+/**
+ * Find the last of sorted completions which start with
+ * prefix like completion by index, the nearest of them
+ * are compared at once by leading bytes of tokens and
+ * the rest by exponential and then binary search
+ *
+ * @return Index of the last completion with prefix
+ */
+static unsigned predictions_skip(const Query* query, unsigned index, unsigned count, const char* prefix,
+                                 unsigned length) {
+    // Usually the next completion has other prefix
+    if (index + 1 == count || strncmp(query_token(query, index + 1, NULL), prefix, length) != 0) {
+        return index;
     }
-    pred->type = EXACTLY;
-    pred->tokens = vector_create(1);
 
-    // Split input string to tokens
-    Tokens* tokens = split(input, ' ');
+    // Or only a few completions share it
+    uint32_t mask = image_prefix_mask(query->image, query->first + index, count - index, prefix, length);
+    if (~mask != 0) {
+        unsigned run = 0;
+        while (mask & 1) {
+            mask >>= 1;
+            run += 1;
+        }
+        return index + run - 1;
+    }
 
-    Node* curr_node = rules->head;
-    Node* prev_node = rules->head;
-    Vector* curr_children = curr_node->children;
+    unsigned last = index + IMAGE_MASK_SIZE - 1;
+    unsigned step = 1;
 
-    // Don't show predictions if last word contains optional brackets
-    if (contain_chars((char*)vector_get(tokens, tokens->length - 1), optional_brackets)) {
-        pred->type = FAILURE;
-        return pred;
+    // Find bound of completions with prefix
+    while (last + step < count && strncmp(query_token(query, last + step, NULL), prefix, length) == 0) {
+        last += step;
+        step *= 2;
+    }
+
+    unsigned bound = last + step < count ? last + step : count;
+    while (last + 1 < bound) {
+        unsigned middle = last + (bound - last) / 2;
+
+        if (strncmp(query_token(query, middle, NULL), prefix, length) == 0) {
+            last = middle;
+        }
+        else {
+            bound = middle;
+        }
     }
 
-    // Finding vector in tree by input tokens
-    for (unsigned i = 0; i < tokens->length - 1; i++) {
-        for (unsigned j = 0; j < curr_children->length; j++) {
-            Node* temp_node = (Node*)vector_get(curr_children, j);
-            char* token = (char*)vector_get(tokens, i);
+    return last;
+}
 
-            if (strcmp(temp_node->token, token) == 0) {
-                curr_node = temp_node;
-                curr_children = curr_node->children;
-                break;
+/**
+ * Check if flags of query nodes were
+ * set by the same optional brackets
+ */
+static int predictions_classified(const Query* query, const char* optional_brackets) {
+    if (query->flags == NULL) {
+        return 0;
+    }
+
+    uint32_t mask[TREE_BRACKET_WORDS];
+    tree_brackets_mask(optional_brackets, mask);
+
+    return memcmp(mask, query->brackets, sizeof(mask)) == 0;
+}
+
+/**
+ * Find children of query node which start with
+ * last token or probably children if there are
+ * no such children, tokens are borrowed
+ *
+ * @return Type of predictions
+ */
+static PredictType predictions_scan(Query* query, const char* last_token, unsigned length,
+                                    const char* optional_brackets, unsigned distance,
+                                    PredictionEmit emit, void* context) {
+    unsigned count = query_complete(query, last_token, length);
+
+    // Set EXACTLY type for predictions if words was found
+    if (count > 0) {
+        for (unsigned i = 0; i < count; i++) {
+            unsigned token_length;
+            const char* probably_token = query_token(query, i, &token_length);
+            emit(context, probably_token, token_length, query_weight(query, i));
+        }
+
+        return EXACTLY;
+    }
+
+    // Search probably words without optional
+    // brackets if words wasn't found
+    count = query_complete(query, "", 0);
+    unsigned found = 0;
+
+    // Tokens are usually classified by brackets at once,
+    // other brackets are searched only in tokens which
+    // have symbols of the same classes
+    int classified = predictions_classified(query, optional_brackets);
+    uint8_t symbols = image_symbols(optional_brackets, (unsigned)strlen(optional_brackets));
+
+    // Sorted children share prefixes, so
+    // matcher reuses their columns
+    Fuzzy fuzzy;
+    fuzzy_init(&fuzzy, last_token, length, distance);
+
+    for (unsigned i = 0; i < count; i++) {
+        unsigned token_length;
+        const char *probably_token = query_token(query, i, &token_length);
+
+        // Adding a word to predictions if its prefix is
+        // near to last token and it has no symbols for
+        // optional values
+        if (fuzzy_match(&fuzzy, probably_token, token_length)) {
+            int optional = classified ? query_optional(query, i)
+                                      : query_symbolic(query, i, symbols) &&
+                                            contain_chars(probably_token, optional_brackets);
+            if (!optional) {
+                emit(context, probably_token, token_length, query_weight(query, i));
+                found += 1;
             }
         }
+        // Skip children with the same hopeless prefix
+        else if (fuzzy.dead > 0) {
+            i = predictions_skip(query, i, count, probably_token, fuzzy.dead);
+        }
+    }
 
-        // If further search makes no sense
-        if (prev_node == curr_node) {
-            pred->type = FAILURE;
+    // Set type depending on the success of the search
+    return found > 0 ? PROBABLY : FAILURE;
+}
+
+static void predictions_emit_copy(void* context, const char* token, unsigned length, unsigned weight) {
+    (void)weight;
+    vector_push((Tokens*)context, token_create(token, length));
+}
+
+/**
+ * Check if prediction is ranked lower than other,
+ * predictions with equal weights keep order of tokens
+ */
+static int prediction_worse(const PredictionView* a, const PredictionView* b) {
+    if (a->weight != b->weight) {
+        return a->weight < b->weight;
+    }
+
+    return strcmp(a->token, b->token) > 0;
+}
+
+/**
+ * Restore heap with the worst prediction on top
+ * after item was replaced by better prediction
+ */
+static void prediction_sift_down(PredictionView* items, unsigned length, unsigned i) {
+    PredictionView item = items[i];
+
+    while (2 * i + 1 < length) {
+        unsigned child = 2 * i + 1;
+        if (child + 1 < length && prediction_worse(&items[child + 1], &items[child])) {
+            child += 1;
+        }
+
+        if (!prediction_worse(&items[child], &item)) {
             break;
         }
+        items[i] = items[child];
+        i = child;
+    }
 
-        // Remember node
-        prev_node = curr_node;
+    items[i] = item;
+}
+
+/**
+ * Restore heap with the worst prediction on top
+ * after prediction was appended to the end
+ */
+static void prediction_sift_up(PredictionView* items, unsigned i) {
+    PredictionView item = items[i];
+
+    while (i > 0 && prediction_worse(&item, &items[(i - 1) / 2])) {
+        items[i] = items[(i - 1) / 2];
+        i = (i - 1) / 2;
     }
 
-    // Search words starts with last token
-    // if children nodes was found
-    if (pred->type != FAILURE) {
-        for (unsigned i = 0; i < curr_children->length; i++) {
-            char* probably_token = ((Node*)vector_get(curr_children, i))->token;
-            char* last_token = (char*)vector_get(tokens, tokens->length - 1);
-
-            if (strncmp(last_token, probably_token, strlen(last_token)) == 0) {
-                vector_push(pred->tokens, token_create(probably_token, (unsigned int) strlen(probably_token)));
-            }
+    items[i] = item;
+}
+
+static void predictions_emit_view(void* context, const char* token, unsigned length, unsigned weight) {
+    PredictionList* list = (PredictionList*)context;
+    list->total += 1;
+
+    PredictionView item;
+    item.token = token;
+    item.length = length;
+    item.weight = weight;
+
+    // Predictions come in order of tokens, so
+    // without weights the first of them are the best
+    if (list->length < list->capacity) {
+        list->items[list->length] = item;
+        list->length += 1;
+
+        if (list->ranked) {
+            prediction_sift_up(list->items, list->length - 1);
         }
     }
+    // Replace the worst of kept predictions
+    else if (list->ranked && list->length > 0 && prediction_worse(&list->items[0], &item)) {
+        list->items[0] = item;
+        prediction_sift_down(list->items, list->length, 0);
+    }
+}
 
-    // Set EXACTLY type for predictions if words was found
-    // or search probably words without optional brackets
-    // if words wasn't found
-    if (pred->tokens->length > 0) {
-        pred->type = EXACTLY;
-    } else if (pred->type != FAILURE) {
-        for (unsigned i = 0; i < curr_children->length; i++) {
-            char *probably_token = ((Node *) vector_get(curr_children, i))->token;
-            char *last_token = (char *) vector_get(tokens, tokens->length - 1);
-
-            // Skip if candidate contain one of symbols for optional values
-            if (contain_chars(probably_token, optional_brackets)) {
-                continue;
-            }
+void predictions_fill(Predictions* pred, Query* query, const char* last_token, unsigned length,
+                      const char* optional_brackets) {
+    // Predictions are already in order of tokens
+    if (!query_ranked(query)) {
+        pred->type = predictions_scan(query, last_token, length, optional_brackets, PREDICTIONS_DISTANCE,
+                                      predictions_emit_copy, pred->tokens);
+        return;
+    }
 
-            // Total misses in probably token
-            unsigned miss = 0;
+    // Count predictions, then sort all of them by weights
+    PredictionList list;
+    prediction_list_init(&list, NULL, 0);
+    prediction_list_fill(&list, query, last_token, length, optional_brackets);
 
-            // Counting misses (no more than 2)
-            for (unsigned j = 0; j < strlen(last_token); j++) {
-                if (last_token[j] != probably_token[j]) {
-                    if (++miss == 2) {
-                        break;
-                    }
-                }
-            }
+    PredictionView* items = (PredictionView*)malloc(sizeof(PredictionView) * (list.total + 1));
+    if (items == NULL) {
+        fprintf(stderr, "[ERROR] Bad prediction memory allocation\n");
+        exit(1);
+    }
+    prediction_list_init(&list, items, list.total);
+    prediction_list_fill(&list, query, last_token, length, optional_brackets);
 
-            // Adding a word to predictions
-            // if there are less than 2 misses
-            if (miss < 2) {
-                vector_push(pred->tokens, token_create(probably_token, (unsigned int)strlen(probably_token)));
-            }
+    for (unsigned i = 0; i < list.length; i++) {
+        vector_push(pred->tokens, token_create(items[i].token, items[i].length));
+    }
+    pred->type = list.type;
+
+    free(items);
+}
+
+void prediction_list_init(PredictionList* list, PredictionView* items, unsigned capacity) {
+    list->type = FAILURE;
+    list->items = items;
+    list->capacity = capacity;
+    list->length = 0;
+    list->total = 0;
+    list->ranked = 0;
+    list->distance = PREDICTIONS_DISTANCE;
+}
+
+void prediction_list_fill(PredictionList* list, Query* query, const char* last_token, unsigned length,
+                          const char* optional_brackets) {
+    list->length = 0;
+    list->total = 0;
+    list->ranked = query_ranked(query);
+    list->type = predictions_scan(query, last_token, length, optional_brackets, list->distance,
+                                  predictions_emit_view, list);
+
+    // Sort heap, the worst predictions
+    // are moved from top to the end
+    if (list->ranked) {
+        for (unsigned end = list->length; end-- > 1;) {
+            PredictionView worst = list->items[0];
+            list->items[0] = list->items[end];
+            list->items[end] = worst;
+            prediction_sift_down(list->items, end, 0);
         }
+    }
+}
+
+/**
+ * Find node of the last complete token of input,
+ * tokens are not copied from input
+ *
+ * @param query - Query for setting on found node
+ * @param input - The entered string
+ * @param optional_brackets - Characters which optional values begin
+ * @param buffer - Memory for text of quoted tokens
+ * @param last_token - Pointer for the last token in input
+ * @param last_length - Pointer for length of the last token
+ *
+ * @return 1 if predictions can be found, 0 otherwise
+ */
+static int predictions_walk(Query* query, const char* input, const char* optional_brackets, char* buffer,
+                            const char** last_token, unsigned* last_length) {
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, input, (unsigned)strlen(input), 0);
+
+    // Finding node in tree by input tokens
+    TokenSpan span;
+    while (tokenizer_next(&tokenizer, &span)) {
+        // If further search makes no sense
+        if (!query_descend_span(query, input, &span, buffer)) {
+            return 0;
+        }
+    }
+
+    // The last token is completed as it is typed, so
+    // predictions continue its quotes and escapes
+    *last_token = input + span.offset;
+    *last_length = span.length;
+
+    // Don't show predictions if last word contains optional brackets
+
+    return predictions_classified(query, optional_brackets) ? !query_bracketed(query, *last_token, *last_length)
+                                                            : !contain_chars(*last_token, optional_brackets);
+}
+
+PredictType predictions_find(Tree* rules, const char* input, const char* optional_brackets,
+                             PredictionList* list) {
+    list->type = FAILURE;
+    list->length = 0;
+    list->total = 0;
+
+    // Query starts from head of compiled tree
+    Query query;
+    query_init(&query, rules);
+
+    char buffer[TOKEN_TEXT_SIZE];
+    const char* last_token;
+    unsigned last_length;
+    if (predictions_walk(&query, input, optional_brackets, buffer, &last_token, &last_length)) {
+        prediction_list_fill(list, &query, last_token, last_length, optional_brackets);
+    }
+
+    return list->type;
+}
+
+PredictionScratch* prediction_scratch_create(unsigned capacity) {
+    // Scratch and its predictions take whole cache lines
+    size_t size = sizeof(PredictionScratch) + sizeof(PredictionView) * capacity;
+    size = (size + PREDICTIONS_CACHE_LINE - 1) / PREDICTIONS_CACHE_LINE * PREDICTIONS_CACHE_LINE;
 
-        // Set type depending on the success of the search
-        pred->type = pred->tokens->length > 0 ? PROBABLY : FAILURE;
+    char* memory = (char*)malloc(size + PREDICTIONS_CACHE_LINE);
+    if (memory == NULL) {
+        return NULL;
+    }
+
+    // Align scratch to the next cache line
+    size_t shift = PREDICTIONS_CACHE_LINE - (size_t)((uintptr_t)memory % PREDICTIONS_CACHE_LINE);
+    PredictionScratch* scratch = (PredictionScratch*)(memory + shift);
+    scratch->memory = memory;
+    prediction_list_init(&scratch->list, (PredictionView*)(scratch + 1), capacity);
+
+    return scratch;
+}
+
+int predictions_search(const Tree* rules, const char* input, const char* optional_brackets,
+                       PredictionScratch* scratch) {
+    PredictionList* list = &scratch->list;
+    list->type = FAILURE;
+    list->length = 0;
+    list->total = 0;
+
+    // Tree is only read, so it must be compiled before
+    Query query;
+    if (query_start(&query, rules) != 0) {
+        return 1;
+    }
+
+    const char* last_token;
+    unsigned last_length;
+    if (predictions_walk(&query, input, optional_brackets, scratch->buffer, &last_token, &last_length)) {
+        prediction_list_fill(list, &query, last_token, last_length, optional_brackets);
+    }
+
+    return 0;
+}
+
+void prediction_scratch_free(PredictionScratch* scratch) {
+    free(scratch->memory);
+}
+
+/**
+ * Create predictions from query on head of tree,
+ * tree is only read, so threads may share query
+ *
+ * @param start - Query on head of tree
+ * @param input - The entered string
+ * @param optional_brackets - Characters which optional values begin
+ *
+ * @return Predictions for current input
+ */
+static Predictions* predictions_query(const Query* start, const char* input, const char* optional_brackets) {
+    // Initialize result predictions
+    Predictions* pred = (Predictions*)malloc(sizeof(Predictions));
+    if (pred == NULL) {
+        fprintf(stderr, "[ERROR] Bad prediction memory allocation\n");
+        exit(0);
     }
+    pred->type = FAILURE;
+    pred->tokens = vector_create(1);
 
-    // Free input tokens
-    tokens_free(tokens);
+    // Search words starts with last token
+    Query query = *start;
+    char buffer[TOKEN_TEXT_SIZE];
+    const char* last_token;
+    unsigned last_length;
+    if (predictions_walk(&query, input, optional_brackets, buffer, &last_token, &last_length)) {
+        predictions_fill(pred, &query, last_token, last_length, optional_brackets);
+    }
 
     // Return result
     return pred;
 }
 
+Predictions *predictions_create(Tree *rules, char *input, char *optional_brackets) {
+    // Query starts from head of compiled tree
+    Query query;
+    query_init(&query, rules);
+
+    return predictions_query(&query, input, optional_brackets);
+}
+
+static void predictions_batch_work(void* arg) {
+    PredictionsBatch* batch = (PredictionsBatch*)arg;
+
+    while (1) {
+        long start = atomic_add_long(&batch->next, PREDICTIONS_BATCH_CHUNK);
+        if (start >= (long)batch->count) {
+            break;
+        }
+
+        unsigned end = (unsigned)start + PREDICTIONS_BATCH_CHUNK;
+        if (end > batch->count) {
+            end = batch->count;
+        }
+
+        for (unsigned i = (unsigned)start; i < end; i++) {
+            batch->results[i] = predictions_query(&batch->query, batch->inputs[i], batch->optional_brackets);
+        }
+    }
+}
+
+void predictions_create_batch(Tree* rules, char** inputs, unsigned count, char* optional_brackets,
+                              Predictions** results, unsigned threads) {
+    // Compile tree once, then threads only read it
+    PredictionsBatch batch;
+    query_init(&batch.query, rules);
+    batch.flags = NULL;
+
+    // Tokens are classified for batch if
+    // tree was classified by other brackets
+    if (optional_brackets[0] != '\0' && !predictions_classified(&batch.query, optional_brackets)) {
+        batch.flags = (uint8_t*)malloc(batch.query.image->header->node_count + 1);
+        if (batch.flags == NULL) {
+            fprintf(stderr, "[ERROR] Bad flags memory allocation\n");
+            exit(1);
+        }
+
+        tree_brackets_mask(optional_brackets, batch.brackets);
+        tree_classify(batch.query.image, batch.brackets, batch.flags);
+        batch.query.flags = batch.flags;
+        batch.query.brackets = batch.brackets;
+    }
+
+    batch.inputs = inputs;
+    batch.optional_brackets = optional_brackets;
+    batch.results = results;
+    batch.count = count;
+    batch.next = 0;
+
+    // Threads without inputs are not started
+    unsigned chunks = (count + PREDICTIONS_BATCH_CHUNK - 1) / PREDICTIONS_BATCH_CHUNK;
+    threads = MAX_OF(threads < chunks ? threads : chunks, 1);
+
+    Thread* handles = (Thread*)malloc(sizeof(Thread) * threads);
+    if (handles == NULL) {
+        fprintf(stderr, "[ERROR] Bad threads memory allocation\n");
+        exit(1);
+    }
+
+    // Current thread takes inputs too, so it
+    // finishes the batch if threads can't start
+    unsigned started = 1;
+    while (started < threads && thread_create(&handles[started], predictions_batch_work, &batch) == 0) {
+        started += 1;
+    }
+    predictions_batch_work(&batch);
+    for (unsigned i = 1; i < started; i++) {
+        thread_join(handles[i]);
+    }
+
+    free(handles);
+    free(batch.flags);
+}
+
 void predictions_free(Predictions* predict) {
     // Free all tokens
     tokens_free(predict->tokens);
@@ -0,0 +1,106 @@
+#include "../include/query.h"
+
+void query_init(Query* query, Tree* tree) {
+    // Compile tree if it was changed
+    tree_finalize(tree);
+    query_start(query, tree);
+}
+
+int query_start(Query* query, const Tree* tree) {
+    if (tree->image == NULL) {
+        return 1;
+    }
+
+    query->image = tree->image;
+    query->usage = tree->usage;
+    query->usage_capacity = tree->usage_capacity;
+    query->flags = tree->flags;
+    query->brackets = tree->brackets;
+    query->node = &tree->image->nodes[0];
+    query->path = TREE_PATH_HEAD;
+    query->first = query->node->children;
+    query->count = 0;
+
+    return 0;
+}
+
+int query_descend(Query* query, const char* token, unsigned length) {
+    const ImageNode* next_node = image_find_child(query->image, query->node, token, length);
+
+    // Query stays on current node
+    // if child wasn't found
+    if (next_node == NULL) {
+        return 0;
+    }
+
+    query->node = next_node;
+    query->path = tree_path(query->path, (uint32_t)(next_node - query->image->nodes));
+    query->first = next_node->children;
+    query->count = 0;
+
+    return 1;
+}
+
+int query_descend_span(Query* query, const char* input, const TokenSpan* span, char* buffer) {
+    if (query_descend(query, input + span->offset, span->length)) {
+        return 1;
+    }
+
+    // Plain token has no other text
+    if (!(span->flags & TOKEN_QUOTED)) {
+        return 0;
+    }
+
+    unsigned length;
+    const char* text = token_text(input, span, buffer, &length);
+
+    return text != NULL && query_descend(query, text, length);
+}
+
+unsigned query_complete(Query* query, const char* prefix, unsigned length) {
+    query->count = image_prefix_range(query->image, query->node, prefix, length, &query->first);
+
+    return query->count;
+}
+
+const char* query_token(const Query* query, unsigned index, unsigned* length) {
+    const ImageNode* node = &query->image->nodes[query->first + index];
+
+    if (length != NULL) {
+        *length = node->token_length;
+    }
+
+    return image_token(query->image, node);
+}
+
+uint32_t query_weight(const Query* query, unsigned index) {
+    uint32_t node = query->first + index;
+
+    // Usage is counted by path, since
+    // equal subtrees share nodes
+    return query->image->weights[node] +
+           tree_usage_count(query->usage, query->usage_capacity, tree_path(query->path, node));
+}
+
+int query_ranked(const Query* query) {
+    return query->image->header->weighted || query->usage != NULL;
+}
+
+int query_optional(const Query* query, unsigned index) {
+    return (query->flags[query->first + index] & TREE_NODE_OPTIONAL) != 0;
+}
+
+int query_symbolic(const Query* query, unsigned index, uint8_t symbols) {
+    return (query->image->symbols[query->first + index] & symbols) != 0;
+}
+
+int query_bracketed(const Query* query, const char* token, unsigned length) {
+    for (unsigned i = 0; i < length; i++) {
+        unsigned char byte = (unsigned char)token[i];
+        if (query->brackets[byte / 32] & (1u << (byte % 32))) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+#ifdef _MSC_VER
+    #ifndef _CRT_SECURE_NO_WARNINGS
+        #define _CRT_SECURE_NO_WARNINGS
+    #endif
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "../include/rules.h"
+#include "../include/vector.h"
+
+#if defined(__linux__)
+    #define RULES_INOTIFY
+
+    #include <poll.h>
+    #include <unistd.h>
+    #include <sys/inotify.h>
+#endif
+
+// Period of checking for changes and stop flag
+#define RULES_WATCH_PERIOD 200
+
+#if defined(RULES_INOTIFY)
+
+static void rules_watch(void* arg) {
+    Rules* rules = (Rules*)arg;
+
+    // Editors often replace file by renaming,
+    // so watch directory of configuration file
+    char* dir = (char*)malloc(strlen(rules->filepath) + 2);
+    if (dir == NULL) {
+        fprintf(stderr, "[ERROR] Bad rules memory allocation\n");
+        exit(1);
+    }
+
+    const char* base = strrchr(rules->filepath, '/');
+    if (base == NULL) {
+        strcpy(dir, ".");
+        base = rules->filepath;
+    }
+    else {
+        // Keep root slash for files in root directory
+        size_t dir_length = MAX_OF((size_t)(base - rules->filepath), 1);
+        memcpy(dir, rules->filepath, dir_length);
+        dir[dir_length] = '\0';
+        base += 1;
+    }
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "[ERROR] Can't watch file %s\n", rules->filepath);
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(dir);
+        return;
+    }
+
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (!atomic_load_long(&rules->stop)) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, RULES_WATCH_PERIOD) <= 0) {
+            continue;
+        }
+
+        // Check if any event is related to configuration file
+        int changed = 0;
+        ssize_t length;
+        while ((length = read(fd, events, sizeof(events))) > 0) {
+            for (char* ptr = events; ptr < events + length;) {
+                struct inotify_event* event = (struct inotify_event*)ptr;
+                if (event->len > 0 && strcmp(event->name, base) == 0) {
+                    changed = 1;
+                }
+                ptr += sizeof(struct inotify_event) + event->len;
+            }
+        }
+
+        if (changed) {
+            rules_reload(rules);
+        }
+    }
+
+    close(fd);
+    free(dir);
+}
+
+#else
+
+static void rules_watch(void* arg) {
+    Rules* rules = (Rules*)arg;
+
+    // Poll modification time and size of file
+    struct stat last;
+    if (stat(rules->filepath, &last) != 0) {
+        memset(&last, 0, sizeof(last));
+    }
+
+    while (!atomic_load_long(&rules->stop)) {
+        thread_sleep(RULES_WATCH_PERIOD);
+
+        struct stat curr;
+        if (stat(rules->filepath, &curr) != 0) {
+            continue;
+        }
+
+        if (curr.st_mtime != last.st_mtime || curr.st_size != last.st_size) {
+            last = curr;
+            rules_reload(rules);
+        }
+    }
+}
+
+#endif
+
+Rules* rules_create(const char* filepath) {
+    // Allocate memory for self
+    Rules* rules = (Rules*)malloc(sizeof(Rules));
+    if (rules == NULL) {
+        fprintf(stderr, "[ERROR] Bad rules memory allocation\n");
+        exit(1);
+    }
+
+    rules->filepath = (char*)malloc(strlen(filepath) + 1);
+    if (rules->filepath == NULL) {
+        fprintf(stderr, "[ERROR] Bad rules memory allocation\n");
+        exit(1);
+    }
+    strcpy(rules->filepath, filepath);
+
+    // The first tree must be correct
+    rules->current = tree_create(filepath);
+    rules->epoch = 0;
+    rules->readers[0] = 0;
+    rules->readers[1] = 0;
+    rules->stop = 0;
+    mutex_init(&rules->reload_lock);
+
+    // Start watching for changes
+    rules->watching = thread_create(&rules->watcher, rules_watch, rules) == 0;
+    if (!rules->watching) {
+        fprintf(stderr, "[ERROR] Can't start watching file %s\n", filepath);
+    }
+
+    return rules;
+}
+
+RulesSnapshot rules_acquire(Rules* rules) {
+    RulesSnapshot snapshot;
+
+    // Register reader in current epoch, retry
+    // if epoch was changed during registration
+    while (1) {
+        long epoch = atomic_load_long(&rules->epoch);
+        atomic_add_long(&rules->readers[epoch & 1], 1);
+
+        if (atomic_load_long(&rules->epoch) == epoch) {
+            snapshot.epoch = epoch;
+            break;
+        }
+
+        atomic_add_long(&rules->readers[epoch & 1], -1);
+    }
+
+    snapshot.tree = (Tree*)atomic_load_ptr((void* volatile*)&rules->current);
+
+    return snapshot;
+}
+
+void rules_release(Rules* rules, RulesSnapshot snapshot) {
+    atomic_add_long(&rules->readers[snapshot.epoch & 1], -1);
+}
+
+int rules_reload(Rules* rules) {
+    // Build new tree without blocking readers,
+    // keep old tree if file is incorrect
+    Tree* tree = tree_try_create(rules->filepath);
+    if (tree == NULL) {
+        return 1;
+    }
+
+    mutex_lock(&rules->reload_lock);
+
+    // Publish new tree and start new epoch
+    Tree* old = (Tree*)atomic_exchange_ptr((void* volatile*)&rules->current, tree);
+    long epoch = atomic_load_long(&rules->epoch);
+    atomic_store_long(&rules->epoch, epoch + 1);
+
+    // Only readers of previous epoch can use old tree
+    while (atomic_load_long(&rules->readers[epoch & 1]) != 0) {
+        thread_sleep(1);
+    }
+
+    mutex_unlock(&rules->reload_lock);
+
+    tree_free(old);
+
+    return 0;
+}
+
+void rules_free(Rules* rules) {
+    // Stop watching
+    if (rules->watching) {
+        atomic_store_long(&rules->stop, 1);
+        thread_join(rules->watcher);
+    }
+
+    // Free current tree and self
+    tree_free(rules->current);
+    mutex_free(&rules->reload_lock);
+    free(rules->filepath);
+    free(rules);
+}
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/session.h"
+
+Session* session_create(Tree* rules, const char* optional_brackets) {
+    // Allocate memory for self
+    Session* session = (Session*)malloc(sizeof(Session));
+    if (session == NULL) {
+        fprintf(stderr, "[ERROR] Bad session memory allocation\n");
+        exit(1);
+    }
+
+    session->tree = rules;
+    session->optional_brackets = optional_brackets;
+    session->revision = 0;
+    session->input = NULL;
+    session->length = 0;
+    session->capacity = 0;
+    session->steps = NULL;
+    session->step_count = 0;
+    session->step_capacity = 0;
+    cache_init(&session->cache);
+    tree_brackets_mask(optional_brackets, session->brackets);
+
+    return session;
+}
+
+static void session_push(Session* session, const ImageNode* node, uint64_t path, unsigned end) {
+    // Reallocate longer memory if capacity runs out
+    if (session->step_count == session->step_capacity) {
+        session->step_capacity = (session->step_capacity + 1) * 2;
+        session->steps = (SessionStep*)realloc(session->steps, sizeof(SessionStep) * session->step_capacity);
+        if (session->steps == NULL) {
+            fprintf(stderr, "[ERROR] Bad session memory reallocation\n");
+            exit(1);
+        }
+    }
+
+    session->steps[session->step_count].node = node;
+    session->steps[session->step_count].path = path;
+    session->steps[session->step_count].end = end;
+    session->step_count += 1;
+}
+
+static void session_remember(Session* session, const char* input, unsigned length) {
+    // Reallocate longer memory if capacity runs out
+    if (length + 1 > session->capacity) {
+        session->capacity = (length + 1) * 2;
+        session->input = (char*)realloc(session->input, session->capacity);
+        if (session->input == NULL) {
+            fprintf(stderr, "[ERROR] Bad session memory reallocation\n");
+            exit(1);
+        }
+    }
+
+    memcpy(session->input, input, length + 1);
+    session->length = length;
+}
+
+/**
+ * Use flags of nodes if tree is classified by
+ * brackets of session, otherwise brackets are
+ * searched in tokens which have their symbols
+ *
+ * @param session - Session of input line
+ * @param query - Query on head of tree
+ */
+static void session_classify(const Session* session, Query* query) {
+    if (query->flags == NULL || memcmp(query->brackets, session->brackets, sizeof(session->brackets)) != 0) {
+        query->flags = NULL;
+        query->brackets = session->brackets;
+    }
+}
+
+/**
+ * Find node of the last complete token reusing steps
+ * of unchanged beginning of input
+ *
+ * @param session - Session of input line
+ * @param input - The entered string
+ * @param query - Query for setting on found node
+ * @param last_token - Pointer for the last token
+ * @param last_length - Pointer for length of the last token
+ *
+ * @return 1 if predictions can be found, 0 otherwise
+ */
+static int session_walk(Session* session, const char* input, Query* query, const char** last_token,
+                        unsigned* last_length) {
+    // Nodes of steps are invalid if tree was compiled again
+    query_init(query, session->tree);
+    session_classify(session, query);
+    if (session->revision != session->tree->revision) {
+        session->revision = session->tree->revision;
+        session->length = 0;
+        session->step_count = 0;
+    }
+
+    // Get length of unchanged beginning of input
+    unsigned length = (unsigned)strlen(input);
+    unsigned same = 0;
+    while (same < session->length && same < length && session->input[same] == input[same]) {
+        same += 1;
+    }
+
+    // Pop steps of tokens which or
+    // which delimiters were changed
+    while (session->step_count > 0 && session->steps[session->step_count - 1].end >= same) {
+        session->step_count -= 1;
+    }
+
+    unsigned i = 0;
+    if (session->step_count > 0) {
+        i = session->steps[session->step_count - 1].end + 1;
+        query->node = session->steps[session->step_count - 1].node;
+        query->path = session->steps[session->step_count - 1].path;
+    }
+
+    // Finding nodes by new complete tokens,
+    // search stops on the first unknown token
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, input, length, i);
+
+    TokenSpan span;
+    while (query->node != NULL && tokenizer_next(&tokenizer, &span)) {
+        if (!query_descend_span(query, input, &span, session->buffer)) {
+            query->node = NULL;
+        }
+        session_push(session, query->node, query->path, span.offset + span.length);
+    }
+    session_remember(session, input, length);
+
+    if (query->node == NULL) {
+        return 0;
+    }
+
+    // Last token is empty if input ends with delimiter,
+    // it is completed as it is typed
+    *last_token = input + span.offset;
+    *last_length = span.length;
+
+    // Further search makes no sense if some token is unknown or
+    // if last word contains optional brackets
+    return !query_bracketed(query, *last_token, *last_length);
+}
+
+Predictions* session_predict(Session* session, const char* input) {
+    // Initialize result predictions
+    Predictions* pred = (Predictions*)malloc(sizeof(Predictions));
+    if (pred == NULL) {
+        fprintf(stderr, "[ERROR] Bad prediction memory allocation\n");
+        exit(1);
+    }
+    pred->type = FAILURE;
+    pred->tokens = vector_create(1);
+
+    Query query;
+    const char* last_token;
+    unsigned last_length;
+    if (session_walk(session, input, &query, &last_token, &last_length)) {
+        predictions_fill(pred, &query, last_token, last_length, session->optional_brackets);
+    }
+
+    return pred;
+}
+
+PredictType session_find(Session* session, const char* input, PredictionList* list) {
+    list->type = FAILURE;
+    list->length = 0;
+    list->total = 0;
+
+    Query query;
+    const char* last_token;
+    unsigned last_length;
+    if (session_walk(session, input, &query, &last_token, &last_length)) {
+        CacheKey key;
+        key.node = query.node;
+        key.path = query.path;
+        key.revision = session->tree->revision;
+        key.learned = session->tree->learned;
+        key.distance = list->distance;
+        key.prefix = last_token;
+        key.length = last_length;
+
+        // Predictions are found again only
+        // if node or last token was changed
+        if (!cache_find(&session->cache, &key, list)) {
+            prediction_list_fill(list, &query, last_token, last_length, session->optional_brackets);
+            cache_store(&session->cache, &key, list);
+        }
+    }
+
+    return list->type;
+}
+
+void session_free(Session* session) {
+    // Free memory of input, steps, cache and self
+    cache_free(&session->cache);
+    free(session->input);
+    free(session->steps);
+    free(session);
+}
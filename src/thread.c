@@ -0,0 +1,165 @@
+#include <stdlib.h>
+
+#include "../include/thread.h"
+
+/**
+ * Function and argument passed to
+ * the start routine of thread
+ */
+struct thread_start {
+    ThreadFunction function;
+    void* arg;
+};
+typedef struct thread_start ThreadStart;
+
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+
+static DWORD WINAPI thread_routine(LPVOID data) {
+    ThreadStart start = *(ThreadStart*)data;
+    free(data);
+
+    start.function(start.arg);
+
+    return 0;
+}
+
+int thread_create(Thread* thread, ThreadFunction function, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (start == NULL) {
+        return 1;
+    }
+    start->function = function;
+    start->arg = arg;
+
+    *thread = CreateThread(NULL, 0, thread_routine, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return 1;
+    }
+
+    return 0;
+}
+
+void thread_join(Thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+void thread_sleep(unsigned milliseconds) {
+    Sleep(milliseconds);
+}
+
+void mutex_init(Mutex* mutex) {
+    InitializeCriticalSection(mutex);
+}
+
+void mutex_lock(Mutex* mutex) {
+    EnterCriticalSection(mutex);
+}
+
+void mutex_unlock(Mutex* mutex) {
+    LeaveCriticalSection(mutex);
+}
+
+void mutex_free(Mutex* mutex) {
+    DeleteCriticalSection(mutex);
+}
+
+void* atomic_load_ptr(void* volatile* ptr) {
+    return InterlockedCompareExchangePointer(ptr, NULL, NULL);
+}
+
+void* atomic_exchange_ptr(void* volatile* ptr, void* value) {
+    return InterlockedExchangePointer(ptr, value);
+}
+
+long atomic_load_long(volatile long* ptr) {
+    return InterlockedCompareExchange(ptr, 0, 0);
+}
+
+void atomic_store_long(volatile long* ptr, long value) {
+    InterlockedExchange(ptr, value);
+}
+
+long atomic_add_long(volatile long* ptr, long value) {
+    return InterlockedExchangeAdd(ptr, value);
+}
+
+#else
+
+#include <time.h>
+
+static void* thread_routine(void* data) {
+    ThreadStart start = *(ThreadStart*)data;
+    free(data);
+
+    start.function(start.arg);
+
+    return NULL;
+}
+
+int thread_create(Thread* thread, ThreadFunction function, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (start == NULL) {
+        return 1;
+    }
+    start->function = function;
+    start->arg = arg;
+
+    if (pthread_create(thread, NULL, thread_routine, start) != 0) {
+        free(start);
+        return 1;
+    }
+
+    return 0;
+}
+
+void thread_join(Thread thread) {
+    pthread_join(thread, NULL);
+}
+
+void thread_sleep(unsigned milliseconds) {
+    struct timespec time;
+    time.tv_sec = milliseconds / 1000;
+    time.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+
+    nanosleep(&time, NULL);
+}
+
+void mutex_init(Mutex* mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+
+void mutex_lock(Mutex* mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void mutex_unlock(Mutex* mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void mutex_free(Mutex* mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+void* atomic_load_ptr(void* volatile* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+void* atomic_exchange_ptr(void* volatile* ptr, void* value) {
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+long atomic_load_long(volatile long* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+void atomic_store_long(volatile long* ptr, long value) {
+    __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+long atomic_add_long(volatile long* ptr, long value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+#endif
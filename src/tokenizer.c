@@ -0,0 +1,101 @@
+#include <stddef.h>
+
+#include "../include/tokenizer.h"
+
+void tokenizer_init(Tokenizer* tokenizer, const char* input, unsigned length, unsigned position) {
+    tokenizer->input = input;
+    tokenizer->length = length;
+    tokenizer->position = position;
+}
+
+int tokenizer_next(Tokenizer* tokenizer, TokenSpan* span) {
+    const char* input = tokenizer->input;
+    unsigned length = tokenizer->length;
+    unsigned i = tokenizer->position;
+
+    // Skip spaces while token not found
+    while (i < length && input[i] == ' ') {
+        i += 1;
+    }
+
+    span->offset = i;
+    span->flags = TOKEN_PLAIN;
+
+    // Find unquoted and unescaped delimiter
+    char quote = '\0';
+    while (i < length && (quote != '\0' || input[i] != ' ')) {
+        char ch = input[i];
+
+        if (quote == '\'') {
+            // Single quotes have no escapes
+            quote = ch == '\'' ? '\0' : quote;
+        }
+        else if (ch == '\\') {
+            // Escaped character never ends token
+            span->flags |= TOKEN_QUOTED;
+            i += i + 1 < length;
+        }
+        else if (quote == '"') {
+            quote = ch == '"' ? '\0' : quote;
+        }
+        else if (ch == '"' || ch == '\'') {
+            span->flags |= TOKEN_QUOTED;
+            quote = ch;
+        }
+        i += 1;
+    }
+
+    span->length = i - span->offset;
+    if (quote != '\0') {
+        span->flags |= TOKEN_OPEN;
+    }
+
+    // The last token isn't followed by delimiter
+    if (i == length) {
+        tokenizer->position = length;
+        return 0;
+    }
+
+    tokenizer->position = i + 1;
+    return 1;
+}
+
+const char* token_text(const char* input, const TokenSpan* span, char* buffer, unsigned* length) {
+    const char* token = input + span->offset;
+
+    // Plain token is used as is
+    if (!(span->flags & TOKEN_QUOTED)) {
+        *length = span->length;
+        return token;
+    }
+
+    // Copy token without quotes and escapes
+    unsigned size = 0;
+    char quote = '\0';
+    for (unsigned i = 0; i < span->length; i++) {
+        char ch = token[i];
+
+        // Backslash is literal inside of single quotes
+        if (ch == '\\' && quote != '\'' && i + 1 < span->length) {
+            ch = token[++i];
+        }
+        // Opening and closing quotes aren't part of text
+        else if (quote == '\0' && (ch == '"' || ch == '\'')) {
+            quote = ch;
+            continue;
+        }
+        else if (quote != '\0' && ch == quote) {
+            quote = '\0';
+            continue;
+        }
+
+        if (size + 1 >= TOKEN_TEXT_SIZE) {
+            return NULL;
+        }
+        buffer[size++] = ch;
+    }
+
+    buffer[size] = '\0';
+    *length = size;
+    return buffer;
+}
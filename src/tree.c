@@ -4,188 +4,1146 @@
     #endif
 #endif
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#if defined(_WIN32) || defined(__CYGWIN__) || defined(_WIN64)
+    #include <io.h>
+    #define READ_FD(fd, buff, size) _read(fd, buff, size)
+#else
+    #include <unistd.h>
+    #define READ_FD(fd, buff, size) read(fd, buff, size)
+#endif
+
+#include "../include/query.h"
+#include "../include/thread.h"
+#include "../include/tokenizer.h"
 #include "../include/tree.h"
+#include "../include/vector.h"
 
-Tree* tree_create(const char* filepath) {
-    int character; // Variable for reading char by char
+// Size of blocks in which config is read
+#define READ_BLOCK_SIZE (64 * 1024)
 
-    unsigned buff_length = 0;  // Max token length
-    unsigned buff_counter = 0; // Variable for getting max token length
+/**
+ * State of single-pass config parser,
+ * fed by blocks of arbitrary size
+ */
+struct parser {
+    Tree* tree;
+    Vector* root_nodes;       // Last node on each indentation level
+    char* line;               // Line carried between blocks
+    unsigned line_length;
+    unsigned line_capacity;
+    unsigned line_counter;    // Counter of lines in config file
+    unsigned tab_length;      // Count of spaces in one tabulation
+    int quiet;                // Don't print errors
+};
+typedef struct parser Parser;
 
-    // Try open file for reading
-    FILE* config = fopen(filepath, "r");
-    if (config == NULL) {
-        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
-        exit(0);
+static void parser_init(Parser* parser, Tree* tree) {
+    parser->tree = tree;
+    parser->root_nodes = vector_create(1);
+    vector_push(parser->root_nodes, (void*)tree->head);
+
+    parser->line = NULL;
+    parser->line_length = 0;
+    parser->line_capacity = 0;
+    parser->line_counter = 0;
+    parser->tab_length = 0;
+    parser->quiet = 0;
+}
+
+static void parser_free(Parser* parser) {
+    vector_free(parser->root_nodes);
+    free(parser->line);
+}
+
+/**
+ * Parse one line of config and
+ * attach its token to the tree
+ *
+ * @return Zero on success or not zero on error
+ */
+static int parser_line(Parser* parser, const char* line, size_t length) {
+    parser->line_counter += 1;
+
+    // Ignore carriage return of Windows line endings
+    if (length > 0 && line[length - 1] == '\r') {
+        length -= 1;
     }
 
-    // Check for empty config file
-    character = fgetc(config);
-    if (character == EOF) {
-        fclose(config);
-        fprintf(stderr, "[ERROR] %s file is empty\n", filepath);
-        exit(0);
+    // Don't use tab character!!!
+    if (length > 0 && line[0] == '\t') {
+        if (!parser->quiet) {
+            fprintf(stderr, "[ERROR] Tab character detected in line %u, use a sequence of spaces\n", parser->line_counter);
+        }
+        return 1;
+    }
+
+    // Get space count
+    unsigned space_counter = 0;
+    while (space_counter < length && line[space_counter] == ' ') {
+        space_counter += 1;
+    }
+
+    // Skip empty lines
+    if (space_counter == length) {
+        return 0;
+    }
+
+    // Init correct tab length
+    if (space_counter > parser->tab_length && parser->tab_length == 0) {
+        parser->tab_length = space_counter;
+    }
+
+    // Check count of spaces for correctness
+    if (space_counter % MAX_OF(parser->tab_length, 1) != 0) {
+        if (!parser->quiet) {
+            fprintf(stderr, "[ERROR] Incorrect tab length in line %u\n", parser->line_counter);
+        }
+        return 1;
     }
-    ungetc(character, config);
 
-    // Get max token length
-    while (character != EOF) {
-        buff_counter = 0;
+    // Get tabulations count
+    unsigned tab_count = space_counter / MAX_OF(parser->tab_length, 1);
 
-        while (character == ' ') {
-            character = fgetc(config);
+    // Get token
+    const char* token = line + space_counter;
+    unsigned token_length = 0;
+    while (space_counter + token_length < length && token[token_length] != ' ' && token[token_length] != '\t') {
+        token_length += 1;
+    }
+
+    // Get optional weight after token like "commit @10"
+    unsigned weight = 0;
+    unsigned i = space_counter + token_length;
+    if (i < length) {
+        while (i < length && line[i] == ' ') {
+            i += 1;
         }
 
-        // Count length of new token
-        while (character != '\n' && character != '\r' && character != EOF) {
-            buff_counter += 1;
-            character = fgetc(config);
+        // Handle space symbol in token error
+        if (i == space_counter + token_length || i == length || line[i] != '@') {
+            if (!parser->quiet) {
+                fprintf(stderr, "[ERROR] Token in config file must not have spaces, line %u\n", parser->line_counter);
+            }
+            return 1;
         }
 
-        // Update token length if we need
-        if (buff_counter > buff_length) {
-            // +1 for null terminated symbol
-            buff_length = buff_counter + 1;
+        // Weight has at most 9 digits
+        unsigned digits = 0;
+        for (i += 1; i < length && line[i] >= '0' && line[i] <= '9' && digits < 9; i++, digits++) {
+            weight = weight * 10 + (unsigned)(line[i] - '0');
         }
 
-        while (character != ' ' && character != EOF) {
-            character = fgetc(config);
+        if (digits == 0 || i != length) {
+            if (!parser->quiet) {
+                fprintf(stderr, "[ERROR] Incorrect weight of token in line %u\n", parser->line_counter);
+            }
+            return 1;
         }
     }
 
-    // Create buffer for parsing
-    char* buff = (char*)malloc(sizeof(char) * buff_length);
-    if (buff == NULL) {
-        fprintf(stderr, "[ERROR] Bad buffer memory allocation\n");
-        fclose(config);
-        exit(1);
+    // Push node to tree
+    Vector* root_nodes = parser->root_nodes;
+    if (tab_count >= root_nodes->length) {
+        if (!parser->quiet) {
+            fprintf(stderr, "[ERROR] The token on line %u does not belong to any token\n", parser->line_counter);
+        }
+        return 1;
     }
-    unsigned buff_i;
 
-    unsigned space_counter;       // Counter of spaces before token
-    unsigned tab_length = 0;      // Count of spaces in one tabulation
-    unsigned tab_count;           // Count of tabulations in line
-    unsigned line_counter = 0;    // Counter of lines in config file
+    Tree* tree = parser->tree;
+    Node* n = node_create(tree->arena, pool_intern(tree->pool, token, token_length), token_length);
+    n->weight = weight;
+    node_list_push(&((Node*)vector_get(root_nodes, tab_count))->children, tree->arena, n);
 
-    // Initialize tree and tree head
+    // Add token to root tokens vector by index as tab count
+    if (tab_count + 1 < root_nodes->length) {
+        vector_set(root_nodes, tab_count + 1, n);
+        root_nodes->length = tab_count + 2;
+    }
+    else {
+        vector_push(root_nodes, (void*)n);
+    }
+
+    return 0;
+}
+
+/**
+ * Feed next block of config to parser,
+ * the block may end in the middle of a line
+ *
+ * @return Zero on success or not zero on error
+ */
+static int parser_feed(Parser* parser, const char* data, size_t length) {
+    const char* end = data + length;
+
+    while (data < end) {
+        const char* newline = (const char*)memchr(data, '\n', (size_t)(end - data));
+
+        // Carry incomplete line to the next block
+        if (newline == NULL) {
+            size_t rest = (size_t)(end - data);
+            if (parser->line_length + rest > parser->line_capacity) {
+                parser->line_capacity = (unsigned)((parser->line_length + rest) * 2);
+                parser->line = (char*)realloc(parser->line, parser->line_capacity);
+                if (parser->line == NULL) {
+                    fprintf(stderr, "[ERROR] Bad parser line memory allocation\n");
+                    exit(1);
+                }
+            }
+            memcpy(parser->line + parser->line_length, data, rest);
+            parser->line_length += (unsigned)rest;
+            break;
+        }
+
+        int error;
+
+        // Complete carried line or parse line in place
+        if (parser->line_length > 0) {
+            size_t rest = (size_t)(newline - data);
+            if (parser->line_length + rest > parser->line_capacity) {
+                parser->line_capacity = (unsigned)(parser->line_length + rest);
+                parser->line = (char*)realloc(parser->line, parser->line_capacity);
+                if (parser->line == NULL) {
+                    fprintf(stderr, "[ERROR] Bad parser line memory allocation\n");
+                    exit(1);
+                }
+            }
+            memcpy(parser->line + parser->line_length, data, rest);
+            error = parser_line(parser, parser->line, parser->line_length + rest);
+            parser->line_length = 0;
+        }
+        else {
+            error = parser_line(parser, data, (size_t)(newline - data));
+        }
+
+        if (error) {
+            return error;
+        }
+
+        // Go to next line
+        data = newline + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Parse the last line of config
+ * if it has no line break
+ *
+ * @return Zero on success or not zero on error
+ */
+static int parser_finish(Parser* parser) {
+    if (parser->line_length == 0) {
+        return 0;
+    }
+
+    int error = parser_line(parser, parser->line, parser->line_length);
+    parser->line_length = 0;
+
+    return error;
+}
+
+/**
+ * Allocate tree with head node only
+ *
+ * @return Empty tree
+ */
+static Tree* tree_alloc() {
     Tree* tree = (Tree*)malloc(sizeof(Tree));
     if (tree == NULL) {
         fprintf(stderr, "[ERROR] Bad tree memory allocation\n");
-        fclose(config);
-        free(buff);
         exit(1);
     }
-    tree->head = node_create("\0", 1);
 
-    // Vector of root nodes for parsing
-    Vector* root_nodes = vector_create(1);
-    vector_push(root_nodes, (void*)tree->head);
+    tree->arena = arena_create();
+    tree->pool = pool_create(tree->arena);
+    tree->image = NULL;
+    tree->revision = 0;
+    tree->learned = 0;
+    tree->usage = NULL;
+    tree->usage_capacity = 0;
+    tree->usage_count = 0;
+    tree->flags = NULL;
+    memset(tree->brackets, 0, sizeof(tree->brackets));
+    tree->head = node_create(tree->arena, pool_intern(tree->pool, "", 0), 0);
+    tree->edges = NULL;
+    tree->edge_capacity = 0;
+    tree->edge_count = 0;
+
+    return tree;
+}
+
+/**
+ * Parse config from stream or file descriptor
+ * in one pass, only the current block and
+ * incomplete line are kept in memory
+ *
+ * @param stream - Input stream or NULL for reading descriptor
+ * @param fd - Input file descriptor
+ * @param name - Name of input for error messages
+ *
+ * @return Rules in the form of a tree or NULL with printed error
+ */
+static Tree* tree_read(FILE* stream, int fd, const char* name) {
+    // Create buffer for reading by blocks
+    char* buff = (char*)malloc(sizeof(char) * READ_BLOCK_SIZE);
+    if (buff == NULL) {
+        fprintf(stderr, "[ERROR] Bad buffer memory allocation\n");
+        exit(1);
+    }
+
+    // Initialize tree and tree head
+    Tree* tree = tree_alloc();
+
+    Parser parser;
+    parser_init(&parser, tree);
 
-    // Set file cursor to the start
-    fseek(config, SEEK_SET, 0);
+    int error = 0;       // Flag for error handling
+    size_t total = 0;    // Count of read bytes
 
-    int error = 0;  // Flag for error handling
+    // Parse config in one pass, this works
+    // for pipes and other non-seekable files
+    while (!error) {
+        long count;
 
-    // Start parsing
-    character = fgetc(config);
-    while (character != EOF) {
-        line_counter += 1;
-        space_counter = 0;
-        buff_i = 0;
+        if (stream != NULL) {
+            count = (long)fread(buff, sizeof(char), READ_BLOCK_SIZE, stream);
+            if (count == 0 && ferror(stream)) {
+                count = -1;
+            }
+        }
+        else {
+            do {
+                count = (long)READ_FD(fd, buff, READ_BLOCK_SIZE);
+            } while (count < 0 && errno == EINTR);
+        }
 
-        // Don't use tab character!!!
-        if (character == '\t') {
-            fprintf(stderr, "[ERROR] Tab character detected in line %d, use a sequence of spaces\n", line_counter);
+        if (count < 0) {
+            fprintf(stderr, "[ERROR] Can't read %s\n", name);
             error = 1;
             break;
         }
+        if (count == 0) {
+            break;
+        }
+
+        total += (size_t)count;
+        error = parser_feed(&parser, buff, (size_t)count);
+    }
+    if (!error) {
+        error = parser_finish(&parser);
+    }
+
+    // Remove temporary variables
+    parser_free(&parser);
+    free(buff);
+
+    // Check for empty config file
+    if (!error && total == 0) {
+        fprintf(stderr, "[ERROR] Config from %s is empty\n", name);
+        error = 1;
+    }
+
+    // Free tree if error
+    if (error) {
+        tree_free(tree);
+        return NULL;
+    }
+
+    // Compile tree for predictions
+    tree_finalize(tree);
+
+    // Return tree
+    return tree;
+}
+
+Tree* tree_try_create(const char* filepath) {
+    // Try open file for reading
+    FILE* config = fopen(filepath, "rb");
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return NULL;
+    }
+
+    Tree* tree = tree_read(config, -1, filepath);
+    fclose(config);
+
+    return tree;
+}
+
+Tree* tree_create_from_stream(FILE* stream) {
+    Tree* tree = tree_read(stream, -1, "input stream");
+
+    // Exit if error
+    if (tree == NULL) {
+        exit(1);
+    }
+
+    return tree;
+}
+
+Tree* tree_create_from_fd(int fd) {
+    Tree* tree = tree_read(NULL, fd, "input file descriptor");
+
+    // Exit if error
+    if (tree == NULL) {
+        exit(1);
+    }
+
+    return tree;
+}
+
+Tree* tree_create(const char* filepath) {
+    Tree* tree = tree_try_create(filepath);
+
+    // Exit if error
+    if (tree == NULL) {
+        exit(1);
+    }
+
+    return tree;
+}
+
+Tree* tree_create_from_buffer(const char* data, size_t length) {
+    // Initialize tree and tree head
+    Tree* tree = tree_alloc();
+
+    Parser parser;
+    parser_init(&parser, tree);
+
+    // Parse the whole buffer as one block
+    int error = parser_feed(&parser, data, length);
+    if (!error) {
+        error = parser_finish(&parser);
+    }
+
+    parser_free(&parser);
+
+    // Free tree and exit if error
+    if (error) {
+        tree_free(tree);
+        exit(1);
+    }
+
+    // Compile tree for predictions
+    tree_finalize(tree);
+
+    // Return tree
+    return tree;
+}
+
+/**
+ * Read the whole file to memory by blocks,
+ * this works for non-seekable files too
+ *
+ * @return Allocated data or NULL with printed error
+ */
+static char* tree_read_file(const char* filepath, size_t* length) {
+    FILE* config = fopen(filepath, "rb");
+    if (config == NULL) {
+        fprintf(stderr, "[ERROR] Can't open file %s\n", filepath);
+        return NULL;
+    }
+
+    size_t capacity = READ_BLOCK_SIZE;
+    char* data = (char*)malloc(capacity);
+    *length = 0;
+
+    size_t read;
+    while (data != NULL && (read = fread(data + *length, 1, capacity - *length, config)) > 0) {
+        *length += read;
+
+        // Grow buffer if it is full
+        if (*length == capacity) {
+            capacity *= 2;
+            char* grown = (char*)realloc(data, capacity);
+            if (grown == NULL) {
+                free(data);
+            }
+            data = grown;
+        }
+    }
+    fclose(config);
+
+    if (data == NULL) {
+        fprintf(stderr, "[ERROR] Bad buffer memory allocation\n");
+        exit(1);
+    }
+
+    return data;
+}
 
-        // Get space count
-        while (character == ' ') {
+/**
+ * Get count of spaces in one tabulation
+ * by the first indented line of config
+ */
+static unsigned config_tab_length(const char* data, size_t length) {
+    size_t i = 0;
+
+    while (i < length) {
+        // Count spaces at the start of line
+        unsigned space_counter = 0;
+        while (i < length && data[i] == ' ') {
             space_counter += 1;
-            character = fgetc(config);
+            i += 1;
         }
 
-        // Init correct tab length
-        if (space_counter > tab_length && tab_length == 0) {
-            tab_length = space_counter;
+        // Indented line with token
+        if (space_counter > 0 && i < length && data[i] != '\n' && data[i] != '\r') {
+            return space_counter;
         }
 
-        // Check count of spaces for correctness
-        if (space_counter % MAX_OF(tab_length, 1) != 0) {
-            fprintf(stderr, "[ERROR] Incorrect tab length in line %d\n", line_counter);
-            error = 1;
+        // Go to next line
+        const char* newline = (const char*)memchr(data + i, '\n', length - i);
+        if (newline == NULL) {
             break;
         }
+        i = (size_t)(newline - data) + 1;
+    }
 
-        // Get tabulations count;
-        tab_count = space_counter / MAX_OF(tab_length, 1);
+    return 0;
+}
 
-        // Get token
-        while (character != '\n' && character != '\r' && character != EOF) {
-            // Handle space symbol in token error
-            if (character == ' ' || character == '\t') {
-                error = 1;
-                break;
+/**
+ * Get start of the first line not before position,
+ * which has token without indentation
+ */
+static size_t config_top_line(const char* data, size_t length, size_t position) {
+    // Go to the start of next line
+    const char* newline = (const char*)memchr(data + position, '\n', length - position);
+    if (newline == NULL) {
+        return length;
+    }
+    position = (size_t)(newline - data) + 1;
+
+    // Skip indented and empty lines
+    while (position < length && (data[position] == ' ' || data[position] == '\n' || data[position] == '\r')) {
+        newline = (const char*)memchr(data + position, '\n', length - position);
+        if (newline == NULL) {
+            return length;
+        }
+        position = (size_t)(newline - data) + 1;
+    }
+
+    return position;
+}
+
+/**
+ * Part of config parsed by one thread
+ * into its own tree
+ */
+struct tree_chunk {
+    const char* data;
+    size_t length;
+    unsigned tab_length;
+    Tree* tree;
+    int error;
+};
+typedef struct tree_chunk TreeChunk;
+
+static void tree_chunk_parse(void* arg) {
+    TreeChunk* chunk = (TreeChunk*)arg;
+
+    Parser parser;
+    parser_init(&parser, chunk->tree);
+
+    // Errors are printed by serial parsing
+    // with correct line numbers
+    parser.quiet = 1;
+    parser.tab_length = chunk->tab_length;
+
+    chunk->error = parser_feed(&parser, chunk->data, chunk->length);
+    if (!chunk->error) {
+        chunk->error = parser_finish(&parser);
+    }
+
+    parser_free(&parser);
+}
+
+Tree* tree_create_parallel(const char* filepath, unsigned threads) {
+    size_t length;
+    char* data = tree_read_file(filepath, &length);
+    if (data == NULL) {
+        exit(1);
+    }
+
+    // Check for empty config file
+    if (length == 0) {
+        fprintf(stderr, "[ERROR] Config from %s is empty\n", filepath);
+        free(data);
+        exit(1);
+    }
+
+    threads = MAX_OF(threads, 1);
+
+    TreeChunk* chunks = (TreeChunk*)malloc(sizeof(TreeChunk) * threads);
+    Thread* handles = (Thread*)malloc(sizeof(Thread) * threads);
+    if (chunks == NULL || handles == NULL) {
+        fprintf(stderr, "[ERROR] Bad chunks memory allocation\n");
+        exit(1);
+    }
+
+    // Split config by tokens without indentation,
+    // so each chunk contains independent subtrees
+    unsigned tab_length = config_tab_length(data, length);
+    size_t start = 0;
+    for (unsigned i = 0; i < threads; i++) {
+        size_t end = length;
+        if (i + 1 < threads) {
+            end = config_top_line(data, length, MAX_OF(start, length / threads * (i + 1)));
+        }
+
+        chunks[i].data = data + start;
+        chunks[i].length = end - start;
+        chunks[i].tab_length = tab_length;
+        chunks[i].tree = tree_alloc();
+        chunks[i].error = 0;
+        start = end;
+    }
+
+    // Parse chunks in threads, the first
+    // chunk is parsed by current thread
+    for (unsigned i = 1; i < threads; i++) {
+        if (thread_create(&handles[i], tree_chunk_parse, &chunks[i]) != 0) {
+            fprintf(stderr, "[ERROR] Can't start parsing thread\n");
+            exit(1);
+        }
+    }
+    tree_chunk_parse(&chunks[0]);
+    for (unsigned i = 1; i < threads; i++) {
+        thread_join(handles[i]);
+    }
+
+    int error = 0;
+    for (unsigned i = 0; i < threads; i++) {
+        error |= chunks[i].error;
+    }
+
+    // Parse serially to print error with line number,
+    // it exits on error, so tree is returned only if
+    // config is correct and chunks were split badly
+    if (error) {
+        for (unsigned i = 0; i < threads; i++) {
+            tree_free(chunks[i].tree);
+        }
+        free(chunks);
+        free(handles);
+
+        Tree* tree = tree_create_from_buffer(data, length);
+        free(data);
+
+        return tree;
+    }
+
+    // Stitch subtrees of chunks under the first tree
+    Tree* tree = chunks[0].tree;
+    for (unsigned i = 1; i < threads; i++) {
+        Tree* chunk_tree = chunks[i].tree;
+        Node* head = chunk_tree->head;
+
+        Node** children = node_list_data(&head->children);
+        for (unsigned j = 0; j < head->children.length; j++) {
+            node_list_push(&tree->head->children, tree->arena, children[j]);
+        }
+
+        // Strings of chunk pool stay in merged arena
+        arena_merge(tree->arena, chunk_tree->arena);
+        pool_free(chunk_tree->pool);
+        free(chunk_tree);
+    }
+
+    // Remove temporary variables
+    free(chunks);
+    free(handles);
+    free(data);
+
+    // Compile tree for predictions
+    tree_finalize(tree);
+
+    // Return tree
+    return tree;
+}
+
+/**
+ * Get hash of edge between parent and child by
+ * address of parent and content of child token,
+ * tokens of tree may come from several pools
+ */
+static unsigned tree_edge_hash(const Node* parent, const char* token, unsigned token_length) {
+    uintptr_t hash = (uintptr_t)parent;
+    hash ^= hash >> 17;
+    hash *= 0x9E3779B1u;
+
+    return (unsigned)hash ^ pool_hash(token, token_length);
+}
+
+/**
+ * Add edge to the index of edges
+ * without checking load factor
+ */
+static void tree_edge_put(TreeEdge* edges, unsigned capacity, Node* parent, Node* child, unsigned hash) {
+    unsigned i = hash & (capacity - 1);
+    while (edges[i].parent != NULL) {
+        i = (i + 1) & (capacity - 1);
+    }
+
+    edges[i].parent = parent;
+    edges[i].child = child;
+    edges[i].hash = hash;
+}
+
+/**
+ * Resize index of edges, all edges
+ * of the tree are added on the first call
+ */
+static void tree_edges_grow(Tree* tree) {
+    Vector* queue = NULL;
+    unsigned capacity = MAX_OF(tree->edge_capacity * 2, 1024);
+
+    // Collect nodes of the whole tree
+    // if index is not created yet
+    if (tree->edges == NULL) {
+        queue = vector_create(1);
+        vector_push(queue, tree->head);
+
+        for (unsigned i = 0; i < queue->length; i++) {
+            Node* n = (Node*)vector_get(queue, i);
+            Node** children = node_list_data(&n->children);
+            for (unsigned j = 0; j < n->children.length; j++) {
+                vector_push(queue, children[j]);
             }
+        }
 
-            buff[buff_i++] = (char)character;
-            character = fgetc(config);
+        tree->edge_count = queue->length - 1;
+        while (tree->edge_count * 2 > capacity) {
+            capacity *= 2;
         }
+    }
 
-        // Handle error when getting token
-        if (error) {
-            fprintf(stderr, "[ERROR] Token in config file must not have spaces, line %d\n", line_counter);
-            break;
+    TreeEdge* edges = (TreeEdge*)calloc(capacity, sizeof(TreeEdge));
+    if (edges == NULL) {
+        fprintf(stderr, "[ERROR] Bad tree edges memory allocation\n");
+        exit(1);
+    }
+
+    if (queue != NULL) {
+        // Add edges of all collected nodes
+        for (unsigned i = 0; i < queue->length; i++) {
+            Node* n = (Node*)vector_get(queue, i);
+            Node** children = node_list_data(&n->children);
+            for (unsigned j = 0; j < n->children.length; j++) {
+                Node* child = children[j];
+                tree_edge_put(edges, capacity, n, child, tree_edge_hash(n, child->token, child->token_length));
+            }
         }
+        vector_free(queue);
+    }
+    else {
+        // Move edges to the new table
+        for (unsigned i = 0; i < tree->edge_capacity; i++) {
+            if (tree->edges[i].parent != NULL) {
+                TreeEdge* edge = &tree->edges[i];
+                tree_edge_put(edges, capacity, edge->parent, edge->child, edge->hash);
+            }
+        }
+        free(tree->edges);
+    }
 
-        buff[buff_i] = '\0';
+    tree->edges = edges;
+    tree->edge_capacity = capacity;
+}
 
-        // Create node by token
-        Node* n = node_create(buff, buff_length);
+/**
+ * Find child of node by token
+ *
+ * @return Child node or NULL
+ */
+static Node* tree_edge_find(Tree* tree, Node* parent, const char* token, unsigned token_length, unsigned hash) {
+    unsigned i = hash & (tree->edge_capacity - 1);
+    while (tree->edges[i].parent != NULL) {
+        TreeEdge* edge = &tree->edges[i];
+        if (edge->parent == parent && edge->hash == hash && edge->child->token_length == token_length &&
+            memcmp(edge->child->token, token, token_length) == 0) {
+            return edge->child;
+        }
+        i = (i + 1) & (tree->edge_capacity - 1);
+    }
 
-        // Push node to tree
-        if (tab_count >= root_nodes->length) {
-            fprintf(stderr, "[ERROR] The token on line %d does not belong to any token\n", line_counter);
-            error = 1;
-            break;
+    return NULL;
+}
+
+int tree_add_path(Tree* tree, const char* path) {
+    // Compiled trees can't be changed
+    if (tree->head == NULL) {
+        fprintf(stderr, "[ERROR] Can't add path to the frozen or compiled tree\n");
+        return 1;
+    }
+
+    // Index edges for fast search of children
+    if (tree->edges == NULL) {
+        tree_edges_grow(tree);
+    }
+
+    Node* curr_node = tree->head;
+
+    for (unsigned i = 0; path[i] != '\0';) {
+        // Skip spaces between tokens
+        if (path[i] == ' ' || path[i] == '\t') {
+            i += 1;
+            continue;
         }
-        vector_push(((Node*)vector_get(root_nodes, tab_count))->children, (void*)n);
 
-        // Add token to root tokens vector by index as tab count
-        if (tab_count + 1 < root_nodes->length) {
-            vector_set(root_nodes, tab_count + 1, n);
+        // Get length of current token
+        unsigned token_length = 0;
+        while (path[i + token_length] != '\0' && path[i + token_length] != ' ' && path[i + token_length] != '\t') {
+            token_length += 1;
         }
-        else if (tab_count + 1 == root_nodes->length) {
-            vector_push(root_nodes, (void*)n);
+
+        // Find existing child or create new
+        const char* token = path + i;
+        unsigned hash = tree_edge_hash(curr_node, token, token_length);
+        Node* next_node = tree_edge_find(tree, curr_node, token, token_length, hash);
+
+        if (next_node == NULL) {
+            next_node = node_create(tree->arena, pool_intern(tree->pool, token, token_length), token_length);
+            node_list_push(&curr_node->children, tree->arena, next_node);
+
+            if (++tree->edge_count * 2 > tree->edge_capacity) {
+                tree_edges_grow(tree);
+            }
+            tree_edge_put(tree->edges, tree->edge_capacity, curr_node, next_node, hash);
+
+            // Compiled image is outdated
+            if (tree->image != NULL) {
+                image_free(tree->image);
+                tree->image = NULL;
+            }
         }
 
-        // Go to next line
-        while (character != ' ' && character != EOF) {
-            character = fgetc(config);
+        curr_node = next_node;
+        i += token_length;
+    }
+
+    return 0;
+}
+
+void tree_brackets_mask(const char* brackets, uint32_t* mask) {
+    memset(mask, 0, sizeof(uint32_t) * TREE_BRACKET_WORDS);
+
+    for (unsigned i = 0; brackets[i] != '\0'; i++) {
+        unsigned char byte = (unsigned char)brackets[i];
+        mask[byte / 32] |= 1u << (byte % 32);
+    }
+}
+
+void tree_classify(const Image* image, const uint32_t* mask, uint8_t* flags) {
+    // Tokens are classified once, so predictions
+    // don't scan tokens of children for brackets
+    for (uint32_t i = 0; i < image->header->node_count; i++) {
+        const ImageNode* node = &image->nodes[i];
+        const unsigned char* token = (const unsigned char*)image_token(image, node);
+
+        flags[i] = 0;
+        for (uint32_t j = 0; j < node->token_length; j++) {
+            if (mask[token[j] / 32] & (1u << (token[j] % 32))) {
+                flags[i] = TREE_NODE_OPTIONAL;
+                break;
+            }
         }
     }
+}
 
-    // Remove temporary variables
-    fclose(config);
-    vector_free(root_nodes);
-    free(buff);
+/**
+ * Allocate flags of tree nodes by count
+ * of nodes of its image and classify them
+ *
+ * @param tree - Compiled tree with brackets
+ */
+static void tree_flags_create(Tree* tree) {
+    uint32_t count = tree->image->header->node_count;
 
-    // Free tree and exit if error
-    if (error) {
-        tree_free(tree);
+    tree->flags = (uint8_t*)malloc(count > 0 ? count : 1);
+    if (tree->flags == NULL) {
+        fprintf(stderr, "[ERROR] Bad flags memory allocation\n");
         exit(1);
     }
 
-    // Return tree
+    tree_classify(tree->image, tree->brackets, tree->flags);
+}
+
+void tree_finalize(Tree* tree) {
+    // Compile tree if it was changed
+    if (tree->image == NULL) {
+        tree->image = image_create(tree->head);
+        tree->revision += 1;
+
+        // Usage counts and flags are bound to nodes of image
+        free(tree->usage);
+        tree->usage = NULL;
+        tree->usage_capacity = 0;
+        tree->usage_count = 0;
+
+        // Tokens of new image are classified by the same brackets
+        if (tree->flags != NULL) {
+            free(tree->flags);
+            tree_flags_create(tree);
+        }
+    }
+}
+
+uint64_t tree_path(uint64_t path, uint32_t node) {
+    // Mix hash of parent path with index of child
+    uint64_t hash = path + 0x9E3779B97F4A7C15ull * ((uint64_t)node + 1);
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+
+    return hash != 0 ? hash : TREE_PATH_HEAD;
+}
+
+/**
+ * Get the first entry for probing
+ * path in usage table
+ */
+static unsigned tree_usage_slot(uint64_t path, unsigned capacity) {
+    return (unsigned)(path ^ (path >> 32)) & (capacity - 1);
+}
+
+uint32_t tree_usage_count(const TreeUsage* usage, unsigned capacity, uint64_t path) {
+    if (usage == NULL) {
+        return 0;
+    }
+
+    // Probe entries until path or empty entry is found
+    for (unsigned i = tree_usage_slot(path, capacity); usage[i].path != 0; i = (i + 1) & (capacity - 1)) {
+        if (usage[i].path == path) {
+            return usage[i].count;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Find entry of path in usage table or create
+ * it, table grows twice when it becomes half full
+ *
+ * @param tree - Tree with usage table
+ * @param path - Hash of path to node
+ *
+ * @return Pointer to usage count of path
+ */
+static uint32_t* tree_usage_put(Tree* tree, uint64_t path) {
+    if ((tree->usage_count + 1) * 2 > tree->usage_capacity) {
+        unsigned capacity = tree->usage_capacity > 0 ? tree->usage_capacity * 2 : 64;
+        TreeUsage* usage = (TreeUsage*)calloc(capacity, sizeof(TreeUsage));
+        if (usage == NULL) {
+            fprintf(stderr, "[ERROR] Bad usage memory allocation\n");
+            exit(1);
+        }
+
+        // Move entries to their places in new table
+        for (unsigned i = 0; i < tree->usage_capacity; i++) {
+            if (tree->usage[i].path != 0) {
+                unsigned j = tree_usage_slot(tree->usage[i].path, capacity);
+                while (usage[j].path != 0) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                usage[j] = tree->usage[i];
+            }
+        }
+
+        free(tree->usage);
+        tree->usage = usage;
+        tree->usage_capacity = capacity;
+    }
+
+    unsigned i = tree_usage_slot(path, tree->usage_capacity);
+    while (tree->usage[i].path != 0 && tree->usage[i].path != path) {
+        i = (i + 1) & (tree->usage_capacity - 1);
+    }
+
+    if (tree->usage[i].path == 0) {
+        tree->usage[i].path = path;
+        tree->usage_count += 1;
+    }
+
+    return &tree->usage[i].count;
+}
+
+void tree_learn(Tree* tree, const char* input) {
+    tree_finalize(tree);
+
+    // Ranks of predictions are changed
+    tree->learned += 1;
+
+    Tokenizer tokenizer;
+    tokenizer_init(&tokenizer, input, (unsigned)strlen(input), 0);
+
+    // Count paths of all tokens like predictions
+    // find them, until unknown token is found
+    Query query;
+    query_start(&query, tree);
+
+    char buffer[TOKEN_TEXT_SIZE];
+    int complete = 1;
+    while (complete) {
+        TokenSpan span;
+        complete = tokenizer_next(&tokenizer, &span);
+
+        if (span.length == 0 || !query_descend_span(&query, input, &span, buffer)) {
+            break;
+        }
+
+        uint32_t* count = tree_usage_put(tree, query.path);
+        *count += *count < TREE_MAX_USAGE;
+    }
+}
+
+void tree_set_brackets(Tree* tree, const char* brackets) {
+    tree_finalize(tree);
+
+    uint32_t mask[TREE_BRACKET_WORDS];
+    tree_brackets_mask(brackets, mask);
+
+    // Flags are kept while brackets are the same
+    if (tree->flags != NULL && memcmp(mask, tree->brackets, sizeof(mask)) == 0) {
+        return;
+    }
+
+    memcpy(tree->brackets, mask, sizeof(mask));
+    free(tree->flags);
+    tree_flags_create(tree);
+}
+
+void tree_shrink(Tree* tree) {
+    // Compiled trees have no nodes
+    if (tree->head == NULL) {
+        return;
+    }
+
+    Arena* arena = arena_create();
+    Pool* pool = pool_create(arena);
+    Node* head = node_create(arena, pool_intern(pool, tree->head->token, tree->head->token_length),
+                             tree->head->token_length);
+
+    // Copy nodes in breadth-first order,
+    // pairs of old and new nodes are queued
+    Vector* queue = vector_create(2);
+    vector_push(queue, tree->head);
+    vector_push(queue, head);
+
+    for (unsigned i = 0; i < queue->length; i += 2) {
+        Node* old_node = (Node*)vector_get(queue, i);
+        Node* new_node = (Node*)vector_get(queue, i + 1);
+        Node** children = node_list_data(&old_node->children);
+
+        node_list_reserve(&new_node->children, arena, old_node->children.length);
+        for (unsigned j = 0; j < old_node->children.length; j++) {
+            Node* child = node_create(arena, pool_intern(pool, children[j]->token, children[j]->token_length),
+                                      children[j]->token_length);
+            child->weight = children[j]->weight;
+            node_list_push(&new_node->children, arena, child);
+
+            vector_push(queue, children[j]);
+            vector_push(queue, child);
+        }
+    }
+    vector_free(queue);
+
+    // Replace old memory, index of
+    // edges is rebuilt on demand
+    pool_free(tree->pool);
+    arena_free(tree->arena);
+    free(tree->edges);
+
+    tree->head = head;
+    tree->arena = arena;
+    tree->pool = pool;
+    tree->edges = NULL;
+    tree->edge_capacity = 0;
+    tree->edge_count = 0;
+}
+
+void tree_freeze(Tree* tree) {
+    tree_finalize(tree);
+
+    // Nodes are not needed for predictions
+    if (tree->arena != NULL) {
+        pool_free(tree->pool);
+        arena_free(tree->arena);
+    }
+    free(tree->edges);
+
+    tree->head = NULL;
+    tree->arena = NULL;
+    tree->pool = NULL;
+    tree->edges = NULL;
+    tree->edge_capacity = 0;
+    tree->edge_count = 0;
+}
+
+int tree_compile(const char* text_path, const char* bin_path) {
+    Tree* tree = tree_create(text_path);
+
+    // Compiled image is written as is
+    int error = image_save(tree->image, bin_path);
+
+    tree_free(tree);
+
+    return error;
+}
+
+Tree* tree_load_binary(const char* filepath) {
+    Image* image = image_load(filepath);
+    if (image == NULL) {
+        exit(1);
+    }
+
+    // Initialize tree with image only
+    Tree* tree = (Tree*)malloc(sizeof(Tree));
+    if (tree == NULL) {
+        fprintf(stderr, "[ERROR] Bad tree memory allocation\n");
+        exit(1);
+    }
+    tree->head = NULL;
+    tree->arena = NULL;
+    tree->pool = NULL;
+    tree->image = image;
+    tree->revision = 1;
+    tree->learned = 0;
+    tree->usage = NULL;
+    tree->usage_capacity = 0;
+    tree->usage_count = 0;
+    tree->flags = NULL;
+    memset(tree->brackets, 0, sizeof(tree->brackets));
+    tree->edges = NULL;
+    tree->edge_capacity = 0;
+    tree->edge_count = 0;
+
     return tree;
 }
 
 void tree_free(Tree* t) {
-    // Free all nodes from the head and self
-    node_free(t->head);
+    // Free compiled image
+    if (t->image != NULL) {
+        image_free(t->image);
+    }
+
+    // Free all nodes and tokens at once by
+    // arena blocks, then pool table and self
+    if (t->arena != NULL) {
+        pool_free(t->pool);
+        arena_free(t->arena);
+    }
+    free(t->edges);
+    free(t->usage);
+    free(t->flags);
     free(t);
 }
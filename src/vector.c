@@ -16,7 +16,7 @@ Vector* vector_create(unsigned length) {
     vec->capacity = MAX_OF(length, 1);
 
     // Allocate memory for data field
-    vec->data = (void**)malloc(sizeof(void*) * length);
+    vec->data = (void**)malloc(sizeof(void*) * vec->capacity);
     if (vec->data == NULL) {
         fprintf(stderr, "[ERROR] Bad vector memory allocation\n");
         exit(1);